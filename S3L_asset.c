@@ -0,0 +1,397 @@
+#include "S3L_asset.h"
+#include "small3dlib.h"
+
+#if S3L_ASSET_MMAP
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+int8_t S3L_assetFromMemory(
+  const void *data,
+  uint32_t size,
+  S3L_Asset *asset)
+{
+  asset->data = (const uint8_t *) data;
+  asset->size = size;
+  asset->mapped = 0;
+
+  if (((uintptr_t) data) % S3L_ASSET_ALIGNMENT != 0 ||
+    size < sizeof(S3L_AssetHeader))
+    return S3L_ASSET_ERROR_FORMAT;
+
+  const S3L_AssetHeader *header = (const S3L_AssetHeader *) data;
+
+  if (header->magic != S3L_ASSET_MAGIC)
+    return S3L_ASSET_ERROR_FORMAT;
+
+  if (header->version != S3L_ASSET_VERSION)
+    return S3L_ASSET_ERROR_VERSION;
+
+  if (header->unitSize != sizeof(S3L_Unit) ||
+    header->indexSize != sizeof(S3L_Index) ||
+    header->textureLayout != S3L_TEXTURE_LAYOUT ||
+    header->fractionsPerUnit != S3L_FRACTIONS_PER_UNIT)
+    return S3L_ASSET_ERROR_CONFIG;
+
+  if (sizeof(S3L_AssetHeader) +
+    header->sectionCount * sizeof(S3L_AssetSection) > size)
+    return S3L_ASSET_ERROR_FORMAT;
+
+  const S3L_AssetSection *sections = (const S3L_AssetSection *)
+    (asset->data + sizeof(S3L_AssetHeader));
+
+  /* Check the sections once here so that the data can be used without any
+     checks later. */
+  for (uint16_t i = 0; i < header->sectionCount; ++i)
+    if (sections[i].offset % S3L_ASSET_ALIGNMENT != 0 ||
+      sections[i].offset > size || sections[i].size > size - sections[i].offset)
+      return S3L_ASSET_ERROR_FORMAT;
+
+  asset->header = header;
+  asset->sections = sections;
+
+  return S3L_ASSET_OK;
+}
+
+#if S3L_ASSET_MMAP
+int8_t S3L_assetOpen(const char *fileName, S3L_Asset *asset)
+{
+  int file = open(fileName,O_RDONLY);
+
+  if (file < 0)
+    return S3L_ASSET_ERROR_FILE;
+
+  struct stat status;
+
+  if (fstat(file,&status) != 0 || status.st_size <= 0 ||
+    (uint64_t) status.st_size > 0xffffffff)
+  {
+    close(file);
+    return S3L_ASSET_ERROR_FILE;
+  }
+
+  void *data = mmap(0,status.st_size,PROT_READ,MAP_PRIVATE,file,0);
+
+  close(file); // the mapping stays
+
+  if (data == MAP_FAILED)
+    return S3L_ASSET_ERROR_FILE;
+
+  int8_t result = S3L_assetFromMemory(data,status.st_size,asset);
+
+  if (result != S3L_ASSET_OK)
+  {
+    munmap(data,status.st_size);
+    return result;
+  }
+
+  asset->mapped = 1;
+
+  return S3L_ASSET_OK;
+}
+#endif
+
+void S3L_assetClose(S3L_Asset *asset)
+{
+#if S3L_ASSET_MMAP
+  if (asset->mapped)
+    munmap((void *) asset->data,asset->size);
+#endif
+
+  asset->data = 0;
+  asset->size = 0;
+  asset->header = 0;
+  asset->sections = 0;
+  asset->mapped = 0;
+}
+
+const void *S3L_assetSection(
+  const S3L_Asset *asset,
+  uint16_t type,
+  uint16_t item,
+  uint32_t *size,
+  uint32_t *info)
+{
+  for (uint16_t i = 0; i < asset->header->sectionCount; ++i)
+  {
+    const S3L_AssetSection *s = asset->sections + i;
+
+    if (s->type == type && s->item == item)
+    {
+      if (size != 0)
+        *size = s->size;
+
+      if (info != 0)
+        *info = s->info;
+
+      return asset->data + s->offset;
+    }
+  }
+
+  return 0;
+}
+
+/* Checks that a section of indices (size in bytes) holds at least count of
+   them and that they're all below limit. */
+static int8_t _S3L_assetCheckIndices(
+  const S3L_Index *indices,
+  uint32_t size,
+  uint32_t count,
+  uint32_t limit)
+{
+  if (size / sizeof(S3L_Index) < count)
+    return S3L_ASSET_ERROR_FORMAT;
+
+  for (uint32_t i = 0; i < count; ++i)
+    if (indices[i] >= limit)
+      return S3L_ASSET_ERROR_FORMAT;
+
+  return S3L_ASSET_OK;
+}
+
+int8_t S3L_assetModel(
+  const S3L_Asset *asset,
+  uint16_t item,
+  S3L_Model3D *model,
+  S3L_AttributeStream *uvStream,
+  S3L_ModelMaterials *materials)
+{
+  uint32_t vertexSize = 0, triangleSize = 0;
+
+  const S3L_Unit *vertices = (const S3L_Unit *)
+    S3L_assetSection(asset,S3L_ASSET_VERTICES,item,&vertexSize,0);
+
+  const S3L_Index *triangles = (const S3L_Index *)
+    S3L_assetSection(asset,S3L_ASSET_TRIANGLES,item,&triangleSize,0);
+
+  uint32_t triangleCount = triangleSize / (3 * sizeof(S3L_Index));
+  uint32_t indexCount = 3 * triangleCount; // in triangles and index sections
+
+#if S3L_TRIANGLE_STRIPS
+  uint8_t strip = triangles == 0;
+#endif
+
+  if (triangles == 0)
+  {
+#if S3L_TRIANGLE_STRIPS
+    triangles = (const S3L_Index *)
+      S3L_assetSection(asset,S3L_ASSET_TRIANGLE_STRIP,item,&triangleSize,0);
+
+    if (triangles == 0 || triangleSize < 3 * sizeof(S3L_Index))
+      return S3L_ASSET_ERROR_MISSING;
+
+    indexCount = triangleSize / sizeof(S3L_Index);
+    triangleCount = indexCount - 2;
+#else
+    if (S3L_assetSection(asset,S3L_ASSET_TRIANGLE_STRIP,item,0,0) != 0)
+      return S3L_ASSET_ERROR_CONFIG; // can't use strips
+
+    return S3L_ASSET_ERROR_MISSING;
+#endif
+  }
+
+  if (triangleCount > (S3L_Index) -1)
+    return S3L_ASSET_ERROR_RANGE;
+
+  uint32_t vertexCount;
+
+  if (vertices != 0)
+  {
+    vertexCount = vertexSize / (3 * sizeof(S3L_Unit));
+
+    if (vertexCount > (S3L_Index) -1)
+      return S3L_ASSET_ERROR_RANGE;
+
+    S3L_initModel3D(vertices,vertexCount,triangles,triangleCount,model);
+  }
+  else
+  {
+#if S3L_QUANTIZED_VERTICES
+    const S3L_Unit *quantization = (const S3L_Unit *)
+      S3L_assetSection(asset,S3L_ASSET_QUANTIZED_VERTICES,item,&vertexSize,0);
+
+    if (quantization == 0 || vertexSize < 6 * sizeof(S3L_Unit))
+      return S3L_ASSET_ERROR_MISSING;
+
+    vertexCount = (vertexSize - 6 * sizeof(S3L_Unit)) / (3 * sizeof(int16_t));
+
+    if (vertexCount > (S3L_Index) -1)
+      return S3L_ASSET_ERROR_RANGE;
+
+    S3L_initModel3D(0,vertexCount,triangles,triangleCount,model);
+
+    model->quantizedVertices = (const int16_t *) (quantization + 6);
+
+    S3L_setVec4(&(model->quantizationScale),quantization[0],quantization[1],
+      quantization[2],S3L_FRACTIONS_PER_UNIT);
+
+    S3L_setVec4(&(model->quantizationOffset),quantization[3],quantization[4],
+      quantization[5],0);
+#else
+    return S3L_ASSET_ERROR_CONFIG; // can't use quantized vertices
+#endif
+  }
+
+#if S3L_TRIANGLE_STRIPS
+  model->triangleStrip = strip;
+#endif
+
+  /* All indices are checked here, the library then uses them without any
+     checks. */
+  int8_t result = _S3L_assetCheckIndices(triangles,triangleSize,indexCount,
+    vertexCount);
+
+  if (result != S3L_ASSET_OK)
+    return result;
+
+  uint32_t size = 0, indexSize = 0;
+
+#if S3L_LIGHTING
+  model->normals = (const S3L_Unit *)
+    S3L_assetSection(asset,S3L_ASSET_NORMALS,item,&size,0);
+
+  model->normalIndices = (const S3L_Index *)
+    S3L_assetSection(asset,S3L_ASSET_NORMAL_INDICES,item,&indexSize,0);
+
+  if (model->normals != 0)
+  {
+    uint32_t normalCount = size / (3 * sizeof(S3L_Unit));
+
+    if (model->normalIndices != 0)
+      result = _S3L_assetCheckIndices(model->normalIndices,indexSize,
+        indexCount,normalCount);
+    else if (normalCount < vertexCount) // normals per vertex
+      result = S3L_ASSET_ERROR_FORMAT;
+
+    if (result != S3L_ASSET_OK)
+      return result;
+  }
+#endif
+
+  const S3L_Unit *uvs = (const S3L_Unit *)
+    S3L_assetSection(asset,S3L_ASSET_UVS,item,&size,0);
+
+  const S3L_Index *uvIndices = (const S3L_Index *)
+    S3L_assetSection(asset,S3L_ASSET_UV_INDICES,item,&indexSize,0);
+
+  if (uvs != 0 && uvIndices != 0)
+  {
+    result = _S3L_assetCheckIndices(uvIndices,indexSize,indexCount,
+      size / (2 * sizeof(S3L_Unit)));
+
+    if (result != S3L_ASSET_OK)
+      return result;
+
+    uvStream->values = uvs;
+    uvStream->indices = uvIndices;
+    uvStream->numComponents = 2;
+
+#if S3L_MAX_ATTRIBUTES > 0
+    model->attributes = uvStream;
+    model->attributeCount = 1;
+#endif
+  }
+
+  if (materials != 0)
+  {
+    uint32_t rangeSize = 0;
+
+    materials->ranges = (const S3L_MaterialRange *)
+      S3L_assetSection(asset,S3L_ASSET_MATERIAL_RANGES,item,&rangeSize,0);
+
+    materials->rangeCount = rangeSize / sizeof(S3L_MaterialRange);
+
+    if (materials->rangeCount == 0)
+      return S3L_ASSET_ERROR_MISSING;
+
+    /* S3L_materialIndex searches the ranges by firstTriangle and the port
+       indexes the material table with them. */
+    uint16_t materialCount = S3L_assetMaterialCount(asset);
+
+    for (uint16_t i = 0; i < materials->rangeCount; ++i)
+    {
+      const S3L_MaterialRange *r = materials->ranges + i;
+
+      if (r->material >= materialCount || r->firstTriangle > triangleCount ||
+        (i == 0 && r->firstTriangle != 0) ||
+        (i > 0 && r->firstTriangle < r[-1].firstTriangle))
+        return S3L_ASSET_ERROR_FORMAT;
+    }
+  }
+
+  return S3L_ASSET_OK;
+}
+
+uint16_t S3L_assetMaterialCount(const S3L_Asset *asset)
+{
+  uint32_t size = 0;
+
+  S3L_assetSection(asset,S3L_ASSET_MATERIALS,0,&size,0);
+
+  return size / sizeof(S3L_AssetMaterial);
+}
+
+int8_t S3L_assetMaterial(
+  const S3L_Asset *asset,
+  uint16_t index,
+  S3L_Material *material)
+{
+  uint32_t size = 0, info = 0, paletteSize = 0;
+
+  const S3L_AssetMaterial *m = (const S3L_AssetMaterial *)
+    S3L_assetSection(asset,S3L_ASSET_MATERIALS,0,&size,0);
+
+  if (m == 0 || index >= size / sizeof(S3L_AssetMaterial))
+    return S3L_ASSET_ERROR_MISSING;
+
+  m += index;
+
+  const uint8_t *texels = (const uint8_t *)
+    S3L_assetSection(asset,S3L_ASSET_TEXTURE,m->texture,&size,&info);
+
+  const uint16_t *palette = (const uint16_t *)
+    S3L_assetSection(asset,S3L_ASSET_PALETTE,m->palette,&paletteSize,0);
+
+  if (texels == 0 || palette == 0)
+    return S3L_ASSET_ERROR_MISSING;
+
+  if (paletteSize < 256 * sizeof(uint16_t)) // any texel value is a color
+    return S3L_ASSET_ERROR_FORMAT;
+
+  /* UVs are in S3L_Units over the whole texture, so it can't have more
+     texels than S3L_FRACTIONS_PER_UNIT per side (which also keeps the
+     shifts by the sizes in range). */
+  for (uint8_t i = 0; i < 2; ++i)
+  {
+    uint8_t logSize = (info >> (i * 8)) & 0xff;
+
+    if (logSize > 30 || (1u << logSize) > S3L_FRACTIONS_PER_UNIT)
+      return S3L_ASSET_ERROR_FORMAT;
+  }
+
+  material->texels = texels;
+  material->palette = palette;
+  material->logWidth = info & 0xff;
+  material->logHeight = (info >> 8) & 0xff;
+  material->mipLevels = (info >> 16) & 0xff;
+  material->uvAttribute = m->uvAttribute;
+#if S3L_LIGHTING
+  material->shadedPalettes = 0; // made at runtime, see S3L_buildShadedPalettes
+#endif
+
+  if (material->mipLevels == 0)
+    material->mipLevels = 1;
+
+  // the MIP chain directly follows level 0
+  material->mips = material->mipLevels > 1 ?
+    texels + (1u << (material->logWidth + material->logHeight)) : 0;
+
+  if (size < (1u << (material->logWidth + material->logHeight)) +
+    S3L_mipChainSize(material->logWidth,material->logHeight,
+      material->mipLevels))
+    return S3L_ASSET_ERROR_FORMAT;
+
+  return S3L_ASSET_OK;
+}
@@ -0,0 +1,185 @@
+#ifndef S3L_ASSET_H_
+#define S3L_ASSET_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Binary asset format (meshes, textures, palettes, materials) made to be used
+  in place: a loaded file is never parsed or copied, its sections are arrays
+  of the library's own types which models and materials point straight into.
+  This allows memory mapping the file on Linux, or linking it into flash and
+  using it from there (S3L_assetFromMemory).
+
+  Layout (little endian, everything aligned to S3L_ASSET_ALIGNMENT bytes from
+  the start of the file):
+
+  - S3L_AssetHeader
+  - S3L_AssetSection[header.sectionCount]
+  - section data, each at its section's offset
+
+  Sections belong to items (models, textures, palettes) by their item number,
+  e.g. the model 2 is made of the S3L_ASSET_VERTICES, S3L_ASSET_TRIANGLES,
+  ... sections with item 2. Since the data is used directly, the file has to
+  be made for the same S3L_Unit and S3L_Index sizes, S3L_FRACTIONS_PER_UNIT
+  and S3L_TEXTURE_LAYOUT, which the header records and the loader checks.
+*/
+
+#include "S3L_types.h"
+#include "S3L_texture.h"
+
+#ifndef S3L_ASSET_MMAP
+  /** If on, S3L_assetOpen is available, which memory maps asset files (needs
+  POSIX mmap, so this is on by default only on Unix hosts). */
+
+  #if defined(__unix__)
+    #define S3L_ASSET_MMAP 1
+  #else
+    #define S3L_ASSET_MMAP 0
+  #endif
+#endif
+
+#define S3L_ASSET_MAGIC 0x414c3353  ///< "S3LA" as little endian uint32_t
+#define S3L_ASSET_VERSION 1
+#define S3L_ASSET_ALIGNMENT 4
+
+// section types, data of each section is an array of given type:
+#define S3L_ASSET_VERTICES 1        ///< S3L_Unit, 3 per vertex
+#define S3L_ASSET_TRIANGLES 2       ///< S3L_Index, 3 per triangle
+#define S3L_ASSET_UVS 3             ///< S3L_Unit, 2 per UV
+#define S3L_ASSET_UV_INDICES 4      /**< S3L_Index, 3 per triangle (laid out
+                                         as a strip for strip models) */
+#define S3L_ASSET_MATERIAL_RANGES 5 ///< S3L_MaterialRange
+#define S3L_ASSET_PALETTE 6         ///< uint16_t, 256 colors
+#define S3L_ASSET_TEXTURE 7         /**< uint8_t texels in S3L_TEXTURE_LAYOUT
+                                         followed by the MIP chain, see
+                                         S3L_ASSET_TEXTURE_INFO */
+#define S3L_ASSET_MATERIALS 8       ///< S3L_AssetMaterial
+#define S3L_ASSET_QUANTIZED_VERTICES 9 /**< S3L_Unit[6] quantization scale
+                                         x, y, z and offset x, y, z, then
+                                         int16_t, 3 per vertex (replaces
+                                         S3L_ASSET_VERTICES) */
+#define S3L_ASSET_TRIANGLE_STRIP 10 /**< S3L_Index, triangle count + 2, see
+                                         S3L_TRIANGLE_STRIPS (replaces
+                                         S3L_ASSET_TRIANGLES) */
+#define S3L_ASSET_NORMALS 11        ///< S3L_Unit, 3 per normal
+#define S3L_ASSET_NORMAL_INDICES 12 /**< S3L_Index, laid out like
+                                         S3L_ASSET_UV_INDICES, if missing
+                                         normals are per vertex */
+
+/** Makes the info of a texture section. */
+#define S3L_ASSET_TEXTURE_INFO(logW,logH,mipLevels)\
+  ((logW) | ((logH) << 8) | ((uint32_t) (mipLevels) << 16))
+
+// return values of the loading functions:
+#define S3L_ASSET_OK 0
+#define S3L_ASSET_ERROR_FILE -1      ///< can't open or map the file
+#define S3L_ASSET_ERROR_FORMAT -2    ///< not an asset or a corrupt one
+#define S3L_ASSET_ERROR_VERSION -3   ///< unsupported format version
+#define S3L_ASSET_ERROR_CONFIG -4    ///< made for a different configuration
+#define S3L_ASSET_ERROR_MISSING -5   ///< requested section isn't there
+#define S3L_ASSET_ERROR_RANGE -6     ///< a count doesn't fit S3L_Index
+
+typedef struct
+{
+  uint32_t magic;            ///< S3L_ASSET_MAGIC
+  uint16_t version;          ///< S3L_ASSET_VERSION
+  uint16_t sectionCount;
+  uint8_t unitSize;          ///< sizeof(S3L_Unit)
+  uint8_t indexSize;         ///< sizeof(S3L_Index)
+  uint8_t textureLayout;     ///< S3L_TEXTURE_LAYOUT
+  uint8_t reserved;
+  uint32_t fractionsPerUnit; ///< S3L_FRACTIONS_PER_UNIT
+} S3L_AssetHeader;
+
+typedef struct
+{
+  uint16_t type;             ///< S3L_ASSET_VERTICES, ...
+  uint16_t item;             ///< model/texture/palette number
+  uint32_t offset;           ///< from the start of the file, aligned
+  uint32_t size;             ///< in bytes
+  uint32_t info;             ///< type specific, e.g. texture size
+} S3L_AssetSection;
+
+/** Material as stored in the file, S3L_assetMaterial makes S3L_Material of
+  it. */
+typedef struct
+{
+  uint16_t texture;          ///< item of the texture section
+  uint16_t palette;          ///< item of the palette section
+  uint8_t uvAttribute;
+  uint8_t reserved[3];
+} S3L_AssetMaterial;
+
+typedef struct
+{
+  const uint8_t *data;
+  uint32_t size;
+  const S3L_AssetHeader *header;
+  const S3L_AssetSection *sections;
+  uint8_t mapped;            ///< whether data is memory mapped by S3L_assetOpen
+} S3L_Asset;
+
+/** Makes an asset of data in memory (e.g. linked into flash), without
+  copying it. The data has to be aligned to S3L_ASSET_ALIGNMENT and stay
+  valid while the asset is used. Returns S3L_ASSET_OK or an error. */
+extern int8_t S3L_assetFromMemory(
+  const void *data,
+  uint32_t size,
+  S3L_Asset *asset);
+
+#if S3L_ASSET_MMAP
+/** Memory maps an asset file (read only) and checks it like
+  S3L_assetFromMemory. Release it with S3L_assetClose. */
+extern int8_t S3L_assetOpen(const char *fileName, S3L_Asset *asset);
+#endif
+
+/** Releases the asset (unmaps it if it was mapped), models and materials
+  made from it can't be used after this. */
+extern void S3L_assetClose(S3L_Asset *asset);
+
+/** Returns a pointer to the data of given section or 0 if there is no such
+  section. If size/info are non-zero, section's size and info are written to
+  them. */
+extern const void *S3L_assetSection(
+  const S3L_Asset *asset,
+  uint16_t type,
+  uint16_t item,
+  uint32_t *size,
+  uint32_t *info);
+
+/** Initializes a model from the asset's model item, pointing it into the
+  asset (models with quantized vertices need S3L_QUANTIZED_VERTICES, strip
+  models need S3L_TRIANGLE_STRIPS, normals are used with S3L_LIGHTING). If the
+  model has UVs, they're set as the model's only attribute stream using
+  uvStream (which must stay valid as long as the model), and if the model has
+  material ranges, they're written to materials (if it's non-zero). All the
+  used indices are checked against the vertex, UV and normal counts, the
+  index sections against the triangle count and the material ranges against
+  the triangle and material counts and their order (S3L_ASSET_ERROR_FORMAT),
+  vertex and triangle counts have to fit S3L_Index (S3L_ASSET_ERROR_RANGE). */
+extern int8_t S3L_assetModel(
+  const S3L_Asset *asset,
+  uint16_t item,
+  S3L_Model3D *model,
+  S3L_AttributeStream *uvStream,
+  S3L_ModelMaterials *materials);
+
+/** Returns the number of materials in the asset's material table. */
+extern uint16_t S3L_assetMaterialCount(const S3L_Asset *asset);
+
+/** Initializes a material from the asset's material table, pointing its
+  texture and palette into the asset. Textures with more than
+  S3L_FRACTIONS_PER_UNIT texels per side (UVs can't address them) and
+  palettes of less than 256 colors are rejected (S3L_ASSET_ERROR_FORMAT). */
+extern int8_t S3L_assetMaterial(
+  const S3L_Asset *asset,
+  uint16_t index,
+  S3L_Material *material);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
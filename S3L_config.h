@@ -4,9 +4,41 @@
 #ifdef __cplusplus
 extern "C" {
 #endif
-  
-#define S3L_RESOLUTION_X       120
-#define S3L_RESOLUTION_Y       120
+
+/* Options can be overridden by defining them before this header (e.g. with
+   -D on the command line, like the host benchmarks do), see small3dlib.c for
+   their meaning. */
+
+#ifndef S3L_DYNAMIC_RESOLUTION
+  #define S3L_DYNAMIC_RESOLUTION 0
+#endif
+
+#if S3L_DYNAMIC_RESOLUTION
+  /* The buffers are allocated for the maximum resolution, the rendered one
+     is set at runtime with S3L_setResolution. */
+  #ifndef S3L_MAX_RESOLUTION_X
+    #define S3L_MAX_RESOLUTION_X 120
+  #endif
+  #ifndef S3L_MAX_RESOLUTION_Y
+    #define S3L_MAX_RESOLUTION_Y 120
+  #endif
+
+  #define S3L_RESOLUTION_X S3L_resolutionX
+  #define S3L_RESOLUTION_Y S3L_resolutionY
+#else
+  #ifndef S3L_RESOLUTION_X
+    #define S3L_RESOLUTION_X 120
+  #endif
+  #ifndef S3L_RESOLUTION_Y
+    #define S3L_RESOLUTION_Y 120
+  #endif
+
+  #define S3L_MAX_RESOLUTION_X S3L_RESOLUTION_X
+  #define S3L_MAX_RESOLUTION_Y S3L_RESOLUTION_Y
+#endif
+
+/** Size of the buffers (z-buffer, visibility buffer etc.) in pixels. */
+#define S3L_MAX_PIXELS (S3L_MAX_RESOLUTION_X * S3L_MAX_RESOLUTION_Y)
 
 
 /** How many fractions a spatial unit is split into. This is NOT SUPPOSED TO
@@ -14,24 +46,49 @@ BE REDEFINED, so rather don't do it (otherwise things may overflow etc.). */
 
 #define S3L_FRACTIONS_PER_UNIT 512
 
-#define S3L_NEAR_CROSS_STRATEGY 2
+#ifndef S3L_NEAR_CROSS_STRATEGY
+  #define S3L_NEAR_CROSS_STRATEGY 2
+#endif
+
+#ifndef S3L_FLAT
+  #define S3L_FLAT 0
+#endif
+#ifndef S3L_PERSPECTIVE_CORRECTION
+  #define S3L_PERSPECTIVE_CORRECTION 0
+#endif
+#ifndef S3L_PC_APPROX_LENGTH
+  #define S3L_PC_APPROX_LENGTH 32
+#endif
 
-#define S3L_FLAT 0  
-#define S3L_PERSPECTIVE_CORRECTION 0 
-#define S3L_PC_APPROX_LENGTH 32
+#ifndef S3L_COMPUTE_DEPTH
+  #define S3L_COMPUTE_DEPTH 0
+#endif
 
-#define S3L_COMPUTE_DEPTH 0
+#ifndef S3L_Z_BUFFER
+  #define S3L_Z_BUFFER 1
+#endif
+#ifndef S3L_REDUCED_Z_BUFFER_GRANULARITY
+  #define S3L_REDUCED_Z_BUFFER_GRANULARITY 5
+#endif
 
-#define S3L_Z_BUFFER 1
-#define S3L_REDUCED_Z_BUFFER_GRANULARITY 5
+#ifndef S3L_STENCIL_BUFFER
+  #define S3L_STENCIL_BUFFER 0
+#endif
+#ifndef S3L_SORT
+  #define S3L_SORT 0
+#endif
 
-#define S3L_STENCIL_BUFFER 0
-#define S3L_SORT 0
+#ifndef S3L_VISIBILITY_BUFFER
+  #define S3L_VISIBILITY_BUFFER 0
+#endif
 
-#define S3L_MAX_TRIANGES_DRAWN 128
+#ifndef S3L_MAX_TRIANGES_DRAWN
+  #define S3L_MAX_TRIANGES_DRAWN 128
+#endif
 
-#define S3L_NORMAL_COMPUTE_MAXIMUM_AVERAGE 6
-#define S3L_FAST_LERP_QUALITY 11 
+#ifndef S3L_FAST_LERP_QUALITY
+  #define S3L_FAST_LERP_QUALITY 11
+#endif
 
 
   
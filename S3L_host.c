@@ -0,0 +1,392 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef S3L_HOST_RDTSC
+  #include <x86intrin.h>
+#endif
+
+#include "S3L_host.h"
+#include "S3L_texture.h"
+#include "S3L_port.h"
+#include "small3dlib.h"
+
+uint16_t S3L_hostFramebuffer[S3L_MAX_PIXELS];
+
+void S3L_hostInit(void)
+{
+  S3L_SetFBuffAddr(S3L_hostFramebuffer);
+  S3L_hostClear(0);
+}
+
+void S3L_hostClear(uint16_t color)
+{
+  S3L_FILL_FUNCTION(S3L_hostFramebuffer,color,
+    S3L_RESOLUTION_X * S3L_RESOLUTION_Y);
+}
+
+void S3L_hostColorToRGB(uint16_t color, uint8_t rgb[3])
+{
+  // 4 bit channels, 0x0f * 17 = 0xff
+  rgb[0] = S3L_colorR(color) * 17;
+  rgb[1] = S3L_colorG(color) * 17;
+  rgb[2] = S3L_colorB(color) * 17;
+}
+
+int8_t S3L_hostWritePPM(
+  const char *fileName,
+  const uint16_t *framebuffer)
+{
+  FILE *f = fopen(fileName,"wb");
+
+  if (f == 0)
+    return S3L_HOST_ERROR_FILE;
+
+  fprintf(f,"P6\n%d %d\n255\n",S3L_RESOLUTION_X,S3L_RESOLUTION_Y);
+
+  for (uint32_t i = 0; i < S3L_RESOLUTION_X * S3L_RESOLUTION_Y; ++i)
+  {
+    uint8_t rgb[3];
+
+    S3L_hostColorToRGB(framebuffer[i],rgb);
+    fwrite(rgb,1,3,f);
+  }
+
+  return fclose(f) == 0 ? S3L_HOST_OK : S3L_HOST_ERROR_FILE;
+}
+
+int8_t S3L_hostReadPPM(
+  const char *fileName,
+  uint16_t *framebuffer)
+{
+  FILE *f = fopen(fileName,"rb");
+  int width, height, maxValue;
+
+  if (f == 0)
+    return S3L_HOST_ERROR_FILE;
+
+  // the header is followed by exactly one whitespace character
+  if (fscanf(f,"P6 %d %d %d",&width,&height,&maxValue) != 3 ||
+    fgetc(f) == EOF || width != S3L_RESOLUTION_X ||
+    height != S3L_RESOLUTION_Y || maxValue != 255)
+  {
+    fclose(f);
+    return S3L_HOST_ERROR_FORMAT;
+  }
+
+  for (uint32_t i = 0; i < S3L_RESOLUTION_X * S3L_RESOLUTION_Y; ++i)
+  {
+    uint8_t rgb[3];
+
+    if (fread(rgb,1,3,f) != 3)
+    {
+      fclose(f);
+      return S3L_HOST_ERROR_FILE;
+    }
+
+    framebuffer[i] = S3L_color((rgb[0] + 8) / 17,(rgb[1] + 8) / 17,
+      (rgb[2] + 8) / 17,15);
+  }
+
+  fclose(f);
+
+  return S3L_HOST_OK;
+}
+
+static uint32_t _S3L_crcTable[256];
+
+static uint32_t _S3L_crc(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+  if (_S3L_crcTable[1] == 0)
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t c = i;
+
+      for (uint8_t k = 0; k < 8; ++k)
+        c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+
+      _S3L_crcTable[i] = c;
+    }
+
+  crc = ~crc;
+
+  for (uint32_t i = 0; i < size; ++i)
+    crc = _S3L_crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+static void _S3L_putBigEndian(uint8_t *data, uint32_t value)
+{
+  data[0] = value >> 24;
+  data[1] = (value >> 16) & 0xff;
+  data[2] = (value >> 8) & 0xff;
+  data[3] = value & 0xff;
+}
+
+static void _S3L_writeChunk(FILE *f, const char *type, const uint8_t *data,
+  uint32_t size)
+{
+  uint8_t b[4];
+
+  _S3L_putBigEndian(b,size);
+  fwrite(b,1,4,f);
+  fwrite(type,1,4,f);
+  fwrite(data,1,size,f);
+
+  _S3L_putBigEndian(b,
+    _S3L_crc(_S3L_crc(0,(const uint8_t *) type,4),data,size));
+
+  fwrite(b,1,4,f);
+}
+
+int8_t S3L_hostWritePNG(
+  const char *fileName,
+  const uint16_t *framebuffer)
+{
+  /* Image data are rows of RGB pixels, each starting with a filter byte (0,
+     none), in zlib stored (uncompressed) deflate blocks of at most 65535
+     bytes. */
+
+  #define ROW_SIZE (1 + 3 * S3L_RESOLUTION_X)
+  #define RAW_SIZE ((uint32_t) ROW_SIZE * S3L_RESOLUTION_Y)
+  #define BLOCK_SIZE 65535
+  #define BLOCK_COUNT ((RAW_SIZE + BLOCK_SIZE - 1) / BLOCK_SIZE)
+
+  uint32_t size = 2 + BLOCK_COUNT * 5 + RAW_SIZE + 4;
+  uint8_t *data = (uint8_t *) malloc(size);
+
+  if (data == 0)
+    return S3L_HOST_ERROR_FILE;
+
+  uint8_t *d = data;
+  uint32_t a = 1, b = 0; // Adler-32 of the raw data
+
+  *d++ = 0x78; // deflate, 32K window
+  *d++ = 0x01; // no preset dictionary, fastest, header check bits
+
+  for (uint32_t offset = 0; offset < RAW_SIZE; offset += BLOCK_SIZE)
+  {
+    uint32_t blockSize = RAW_SIZE - offset < BLOCK_SIZE ?
+      RAW_SIZE - offset : BLOCK_SIZE;
+
+    *d++ = offset + blockSize == RAW_SIZE; // last block flag, stored type
+    *d++ = blockSize & 0xff;
+    *d++ = blockSize >> 8;
+    *d++ = ~blockSize & 0xff;
+    *d++ = (~blockSize >> 8) & 0xff;
+
+    for (uint32_t i = offset; i < offset + blockSize; ++i)
+    {
+      uint32_t x = i % ROW_SIZE;
+      uint8_t value = 0;
+
+      if (x != 0)
+      {
+        uint8_t rgb[3];
+
+        S3L_hostColorToRGB(framebuffer[(i / ROW_SIZE) * S3L_RESOLUTION_X +
+          (x - 1) / 3],rgb);
+
+        value = rgb[(x - 1) % 3];
+      }
+
+      *d++ = value;
+      a = (a + value) % 65521;
+      b = (b + a) % 65521;
+    }
+  }
+
+  _S3L_putBigEndian(d,(b << 16) | a);
+
+  #undef ROW_SIZE
+  #undef RAW_SIZE
+  #undef BLOCK_SIZE
+  #undef BLOCK_COUNT
+
+  FILE *f = fopen(fileName,"wb");
+
+  if (f == 0)
+  {
+    free(data);
+    return S3L_HOST_ERROR_FILE;
+  }
+
+  const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  uint8_t header[13];
+
+  _S3L_putBigEndian(header,S3L_RESOLUTION_X);
+  _S3L_putBigEndian(header + 4,S3L_RESOLUTION_Y);
+  header[8] = 8;  // bits per channel
+  header[9] = 2;  // RGB
+  header[10] = 0; // deflate
+  header[11] = 0; // adaptive filtering
+  header[12] = 0; // no interlace
+
+  fwrite(signature,1,8,f);
+  _S3L_writeChunk(f,"IHDR",header,13);
+  _S3L_writeChunk(f,"IDAT",data,size);
+  _S3L_writeChunk(f,"IEND",0,0);
+
+  free(data);
+
+  return fclose(f) == 0 ? S3L_HOST_OK : S3L_HOST_ERROR_FILE;
+}
+
+void S3L_hostHeatmap(const uint8_t *counts, uint16_t *framebuffer)
+{
+  static const uint16_t colors[9] =
+  {
+    S3L_color(0,0,0,15),   S3L_color(0,0,15,15),  S3L_color(0,12,0,15),
+    S3L_color(15,15,0,15), S3L_color(15,8,0,15),  S3L_color(15,0,0,15),
+    S3L_color(15,0,15,15), S3L_color(15,0,15,15), S3L_color(15,15,15,15)
+  };
+
+  for (uint32_t i = 0; i < S3L_RESOLUTION_X * S3L_RESOLUTION_Y; ++i)
+    framebuffer[i] = colors[counts[i] < 8 ? counts[i] : 8];
+}
+
+static uint64_t _S3L_nanoseconds(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC,&t);
+
+  return ((uint64_t) t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
+uint32_t S3L_profileClock(void)
+{
+#ifdef S3L_HOST_RDTSC
+  return (uint32_t) __rdtsc();
+#else
+  return (uint32_t) _S3L_nanoseconds();
+#endif
+}
+
+double S3L_hostClockRate(void)
+{
+#ifdef S3L_HOST_RDTSC
+  static double rate = 0;
+
+  if (rate == 0)
+  {
+    // count the ticks over 10 ms of the monotonic clock
+    uint64_t start = _S3L_nanoseconds(), end;
+    uint64_t ticks = __rdtsc();
+
+    do
+      end = _S3L_nanoseconds();
+    while (end - start < 10000000);
+
+    rate = (__rdtsc() - ticks) / ((end - start) / 1000.0);
+  }
+
+  return rate;
+#else
+  return 1000;
+#endif
+}
+
+#if S3L_PROFILE
+typedef struct
+{
+  uint64_t start;             ///< Ticks since the first frame's start.
+  uint32_t time[S3L_ZONE_COUNT];
+  uint16_t eventCount;
+  S3L_ProfileEvent events[S3L_PROFILE_EVENTS];
+} _S3L_TraceFrame;
+
+static _S3L_TraceFrame *_S3L_trace = 0;
+static uint32_t _S3L_traceLength = 0;
+static uint32_t _S3L_traceCapacity = 0;
+static uint32_t _S3L_traceClock;   ///< frameStart of the last traced frame
+
+static const char *_S3L_zoneNames[S3L_ZONE_COUNT] =
+{
+  "clear", "scene", "matrices", "projection", "sort", "rasterization",
+  "shading", "resolve"
+};
+
+int8_t S3L_hostTraceFrame(void)
+{
+  if (_S3L_traceLength == _S3L_traceCapacity)
+  {
+    uint32_t capacity = _S3L_traceCapacity ? 2 * _S3L_traceCapacity : 256;
+    _S3L_TraceFrame *trace = (_S3L_TraceFrame *)
+      realloc(_S3L_trace,capacity * sizeof(_S3L_TraceFrame));
+
+    if (trace == 0)
+      return S3L_HOST_ERROR_MEMORY;
+
+    _S3L_trace = trace;
+    _S3L_traceCapacity = capacity;
+  }
+
+  _S3L_TraceFrame *frame = &(_S3L_trace[_S3L_traceLength]);
+
+  // the clock overflows, add the (short) differences to the previous frame
+  frame->start = _S3L_traceLength == 0 ? 0 :
+    _S3L_trace[_S3L_traceLength - 1].start +
+    (uint32_t) (S3L_profile.frameStart - _S3L_traceClock);
+
+  _S3L_traceClock = S3L_profile.frameStart;
+
+  for (uint8_t i = 0; i < S3L_ZONE_COUNT; ++i)
+    frame->time[i] = S3L_profile.time[i];
+
+  frame->eventCount = S3L_profile.eventCount;
+
+  for (uint16_t i = 0; i < S3L_profile.eventCount; ++i)
+    frame->events[i] = S3L_profile.events[i];
+
+  _S3L_traceLength++;
+
+  return S3L_HOST_OK;
+}
+
+int8_t S3L_hostWriteTrace(const char *fileName)
+{
+  FILE *f = fopen(fileName,"w");
+
+  if (f == 0)
+    return S3L_HOST_ERROR_FILE;
+
+  double rate = S3L_hostClockRate();
+  const char *separator = "";
+
+  fprintf(f,"{\"traceEvents\":[\n");
+
+  for (uint32_t i = 0; i < _S3L_traceLength; ++i)
+  {
+    const _S3L_TraceFrame *frame = &(_S3L_trace[i]);
+
+    for (uint16_t j = 0; j < frame->eventCount; ++j)
+    {
+      const S3L_ProfileEvent *e = &(frame->events[j]);
+
+      fprintf(f,"%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+        "\"ts\":%.3f,\"dur\":%.3f}",separator,_S3L_zoneNames[e->zone],
+        (frame->start + e->start) / rate,e->duration / rate);
+
+      separator = ",\n";
+    }
+
+    fprintf(f,"%s{\"name\":\"zones (us)\",\"ph\":\"C\",\"pid\":1,"
+      "\"ts\":%.3f,\"args\":{",separator,frame->start / rate);
+
+    for (uint8_t z = 0; z < S3L_ZONE_COUNT; ++z)
+      fprintf(f,"%s\"%s\":%.3f",z ? "," : "",_S3L_zoneNames[z],
+        frame->time[z] / rate);
+
+    fprintf(f,"}}");
+    separator = ",\n";
+  }
+
+  fprintf(f,"\n]}\n");
+
+  return fclose(f) == 0 ? S3L_HOST_OK : S3L_HOST_ERROR_FILE;
+}
+#endif
@@ -0,0 +1,89 @@
+#ifndef S3L_HOST_H_
+#define S3L_HOST_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Headless backend for building and profiling the renderer on a host (e.g.
+  Linux with perf or valgrind) instead of the PicoSystem: a framebuffer in
+  RAM for the port (S3L_pixel_function and S3L_SetFBuffAddr work unchanged)
+  and dumping it to PPM or PNG images. Colors are in the PicoSystem format
+  (see S3L_texture.h), images are written as 8 bit RGB.
+
+  This is a host module, it uses the C standard library.
+*/
+
+#include "S3L_types.h"
+
+#define S3L_HOST_OK 0
+#define S3L_HOST_ERROR_FILE -1    ///< can't open, read or write the file
+#define S3L_HOST_ERROR_FORMAT -2  ///< not a PPM of the framebuffer's size
+#define S3L_HOST_ERROR_MEMORY -3  ///< can't allocate memory
+
+/** Framebuffer the port draws to after S3L_hostInit, in rows of
+  S3L_RESOLUTION_X pixels. */
+extern uint16_t S3L_hostFramebuffer[S3L_MAX_PIXELS];
+
+/** Points the port to S3L_hostFramebuffer and clears it. */
+extern void S3L_hostInit(void);
+
+/** Fills the framebuffer with a color (e.g. the background). */
+extern void S3L_hostClear(uint16_t color);
+
+/** Converts a color to 8 bit RGB. */
+extern void S3L_hostColorToRGB(uint16_t color, uint8_t rgb[3]);
+
+/** Writes a S3L_RESOLUTION_X x S3L_RESOLUTION_Y framebuffer to a binary PPM
+  (P6) image. Returns S3L_HOST_OK or an error. */
+extern int8_t S3L_hostWritePPM(
+  const char *fileName,
+  const uint16_t *framebuffer);
+
+/** Reads a binary PPM (P6) image of S3L_RESOLUTION_X x S3L_RESOLUTION_Y
+  pixels with 8 bit channels (as written by S3L_hostWritePPM) into a
+  framebuffer, rounding the colors to 4 bit channels with full alpha. Returns
+  S3L_HOST_OK or an error. */
+extern int8_t S3L_hostReadPPM(
+  const char *fileName,
+  uint16_t *framebuffer);
+
+/** Writes a S3L_RESOLUTION_X x S3L_RESOLUTION_Y framebuffer to a PNG image
+  (uncompressed, so that no zlib is needed). Returns S3L_HOST_OK or an
+  error. */
+extern int8_t S3L_hostWritePNG(
+  const char *fileName,
+  const uint16_t *framebuffer);
+
+/** Draws per pixel counts (e.g. of S3L_overdraw) to a framebuffer as a
+  heatmap: 0 black, 1 blue, 2 green, 3 yellow, 4 orange, 5 red, 6 and 7
+  magenta, 8 or more white. */
+extern void S3L_hostHeatmap(const uint8_t *counts, uint16_t *framebuffer);
+
+/** S3L_profileClock for the host: nanoseconds of the monotonic clock, or
+  with S3L_HOST_RDTSC defined the x86 time stamp counter, both truncated to
+  32 bits (so they overflow every few seconds, fine for durations). */
+extern uint32_t S3L_profileClock(void);
+
+/** Returns the number of S3L_profileClock ticks per microsecond (measured
+  once for S3L_HOST_RDTSC). */
+extern double S3L_hostClockRate(void);
+
+#if S3L_PROFILE
+/** Appends the current frame's profile (S3L_profile, events and zone times)
+  to a trace kept in memory, call it after the frame is drawn. Returns
+  S3L_HOST_OK or S3L_HOST_ERROR_MEMORY. */
+extern int8_t S3L_hostTraceFrame(void);
+
+/** Writes the trace of the frames passed to S3L_hostTraceFrame as a JSON
+  trace for chrome://tracing or Perfetto: the events as spans and the zone
+  times of each frame as counters. Returns S3L_HOST_OK or an error. */
+extern int8_t S3L_hostWriteTrace(const char *fileName);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
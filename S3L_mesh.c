@@ -0,0 +1,778 @@
+#include "S3L_mesh.h"
+#include "small3dlib.h"
+
+#define _S3L_FORSYTH_CACHE_SIZE 32
+
+/* Forsyth's vertex scores scaled by 1024 (cache decay power 1.5, last
+   triangle score 0.75, valence boost 2 * valence^-0.5). */
+static const int16_t _S3L_forsythCacheScores[_S3L_FORSYTH_CACHE_SIZE] =
+{
+  768, 768, 768, 1024, 971, 920, 869, 820, 771, 723, 677, 631, 586, 543, 501,
+  460, 420, 381, 343, 307, 273, 239, 207, 177, 148, 121, 96, 73, 52, 34, 19, 7
+};
+
+#define _S3L_FORSYTH_MAX_VALENCE 16
+
+static const int16_t _S3L_forsythValenceScores[_S3L_FORSYTH_MAX_VALENCE + 1] =
+{
+  0, 2048, 1448, 1182, 1024, 916, 836, 774, 724, 683, 648, 617, 591, 568, 547,
+  529, 512
+};
+
+static inline int32_t _S3L_forsythScore(int8_t cachePosition,
+  S3L_Index remaining)
+{
+  if (remaining == 0)
+    return -1; // no triangles left to use this vertex
+
+  int32_t result = cachePosition >= 0 ?
+    _S3L_forsythCacheScores[cachePosition] : 0;
+
+  return result + _S3L_forsythValenceScores[
+    S3L_min(remaining,_S3L_FORSYTH_MAX_VALENCE)];
+}
+
+/* Normalizes a vector of any size (keeping the precision for small ones too),
+   a zero vector stays zero. */
+static void _S3L_normalize64(const int64_t v[3], S3L_Vec4 *result)
+{
+  int64_t x = v[0], y = v[1], z = v[2];
+
+  if (x == 0 && y == 0 && z == 0)
+  {
+    S3L_setVec4(result,0,0,0,0);
+    return;
+  }
+
+  #define big(a) ((a) > 0x3fff || (a) < -0x3fff)
+  #define small(a) ((a) < 0x2000 && (a) > -0x2000)
+
+  while (big(x) || big(y) || big(z))
+  {
+    x /= 2;
+    y /= 2;
+    z /= 2;
+  }
+
+  while (small(x) && small(y) && small(z))
+  {
+    x *= 2;
+    y *= 2;
+    z *= 2;
+  }
+
+  #undef big
+  #undef small
+
+  S3L_setVec4(result,x,y,z,0);
+  S3L_normalizeVec3Fast(result);
+}
+
+/* Sorts clusters of triangles (in the order already computed) by how much
+   they face away from the mesh center, which is where they most likely
+   occlude other parts of the mesh (Sander, Nehab, Barczak: Fast Triangle
+   Reordering for Vertex Locality and Reduced Overdraw). */
+static void _S3L_sortClustersForOverdraw(
+  const S3L_Index *triangles,
+  S3L_Index triangleCount,
+  const S3L_Unit *vertices,
+  S3L_Index vertexCount,
+  S3L_Index *order,
+  int32_t *keys,
+  S3L_Index *clusters,
+  S3L_Index *orderCopy)
+{
+  int64_t center[3] = {0, 0, 0};
+
+  for (S3L_Index i = 0; i < vertexCount; ++i)
+    for (uint8_t c = 0; c < 3; ++c)
+      center[c] += vertices[i * 3 + c];
+
+  for (uint8_t c = 0; c < 3; ++c)
+    center[c] /= S3L_nonZero(vertexCount);
+
+  S3L_Index clusterCount = 0;
+
+  for (S3L_Index start = 0; start < triangleCount;
+    start += S3L_OVERDRAW_CLUSTER_SIZE)
+  {
+    S3L_Index end = S3L_min(start + S3L_OVERDRAW_CLUSTER_SIZE,triangleCount);
+
+    int64_t normal[3] = {0, 0, 0}, position[3] = {0, 0, 0};
+
+    for (S3L_Index i = start; i < end; ++i)
+    {
+      const S3L_Unit *v[3];
+
+      for (uint8_t j = 0; j < 3; ++j)
+        v[j] = vertices + triangles[order[i] * 3 + j] * 3;
+
+      // centroid and area weighted outward normal (b x a)
+      int64_t a[3], b[3];
+
+      for (uint8_t c = 0; c < 3; ++c)
+      {
+        a[c] = v[1][c] - v[0][c];
+        b[c] = v[2][c] - v[0][c];
+        position[c] += v[0][c] + v[1][c] + v[2][c];
+      }
+
+      normal[0] += b[1] * a[2] - b[2] * a[1];
+      normal[1] += b[2] * a[0] - b[0] * a[2];
+      normal[2] += b[0] * a[1] - b[1] * a[0];
+    }
+
+    S3L_Vec4 n;
+
+    _S3L_normalize64(normal,&n);
+
+    int64_t key = 0;
+    S3L_Unit *nc = &(n.x);
+
+    for (uint8_t c = 0; c < 3; ++c)
+      key += (position[c] / (3 * (end - start)) - center[c]) * nc[c];
+
+    keys[clusterCount] = key / S3L_FRACTIONS_PER_UNIT;
+    clusters[clusterCount] = start;
+    clusterCount++;
+  }
+
+  // insertion sort, stable, descending
+  for (S3L_Index i = 1; i < clusterCount; ++i)
+  {
+    int32_t key = keys[i];
+    S3L_Index cluster = clusters[i];
+    int32_t j = i - 1;
+
+    while (j >= 0 && keys[j] < key)
+    {
+      keys[j + 1] = keys[j];
+      clusters[j + 1] = clusters[j];
+      j--;
+    }
+
+    keys[j + 1] = key;
+    clusters[j + 1] = cluster;
+  }
+
+  for (S3L_Index i = 0; i < triangleCount; ++i)
+    orderCopy[i] = order[i];
+
+  S3L_Index position = 0;
+
+  for (S3L_Index i = 0; i < clusterCount; ++i)
+  {
+    S3L_Index end =
+      S3L_min(clusters[i] + S3L_OVERDRAW_CLUSTER_SIZE,triangleCount);
+
+    for (S3L_Index j = clusters[i]; j < end; ++j)
+    {
+      order[position] = orderCopy[j];
+      position++;
+    }
+  }
+}
+
+void S3L_optimizeTriangleOrder(
+  const S3L_Index *triangles,
+  S3L_Index triangleCount,
+  const S3L_Unit *vertices,
+  S3L_Index vertexCount,
+  uint8_t mode,
+  S3L_Index *order,
+  void *work)
+{
+  // work memory layout, 4 byte items first:
+  int32_t *vertexScores = (int32_t *) work;
+  uint32_t *adjacencyStart = (uint32_t *) (vertexScores + vertexCount);
+  int32_t *triangleScores = (int32_t *) (adjacencyStart + vertexCount);
+  S3L_Index *adjacency = (S3L_Index *) (triangleScores + triangleCount);
+  S3L_Index *remaining = adjacency + triangleCount * 3;
+  int8_t *cachePositions = (int8_t *) (remaining + vertexCount);
+
+  S3L_Index cache[_S3L_FORSYTH_CACHE_SIZE + 3];
+  uint8_t cacheLength = 0;
+
+  // build the vertex to triangle adjacency (CSR):
+
+  for (S3L_Index i = 0; i < vertexCount; ++i)
+  {
+    remaining[i] = 0;
+    cachePositions[i] = -1;
+  }
+
+  for (uint32_t i = 0; i < triangleCount * 3; ++i)
+    remaining[triangles[i]]++;
+
+  uint32_t sum = 0;
+
+  for (S3L_Index i = 0; i < vertexCount; ++i)
+  {
+    adjacencyStart[i] = sum;
+    sum += remaining[i];
+    remaining[i] = 0;
+  }
+
+  for (uint32_t i = 0; i < triangleCount * 3; ++i)
+  {
+    S3L_Index v = triangles[i];
+
+    adjacency[adjacencyStart[v] + remaining[v]] = i / 3;
+    remaining[v]++;
+  }
+
+  for (S3L_Index i = 0; i < vertexCount; ++i)
+    vertexScores[i] = _S3L_forsythScore(-1,remaining[i]);
+
+  int32_t bestScore = -1;
+  int32_t best = -1;
+
+  for (S3L_Index i = 0; i < triangleCount; ++i)
+  {
+    triangleScores[i] = 0;
+
+    for (uint8_t j = 0; j < 3; ++j)
+      triangleScores[i] += vertexScores[triangles[i * 3 + j]];
+
+    if (triangleScores[i] > bestScore)
+    {
+      bestScore = triangleScores[i];
+      best = i;
+    }
+  }
+
+  S3L_Index fallback = 0; // scans for unused triangles when there's no best
+
+  for (S3L_Index i = 0; i < triangleCount; ++i)
+  {
+    if (best < 0)
+    {
+      while (triangleScores[fallback] < 0)
+        fallback++;
+
+      best = fallback;
+    }
+
+    order[i] = best;
+    triangleScores[best] = -1; // mark as used
+
+    S3L_Index newCache[_S3L_FORSYTH_CACHE_SIZE + 3];
+    uint8_t newCacheLength = 0;
+
+    for (uint8_t j = 0; j < 3; ++j)
+    {
+      S3L_Index v = triangles[best * 3 + j];
+
+      // remove the triangle from the vertex's remaining triangles
+      S3L_Index *list = adjacency + adjacencyStart[v];
+
+      for (S3L_Index k = 0; k < remaining[v]; ++k)
+        if (list[k] == best)
+        {
+          list[k] = list[remaining[v] - 1];
+          remaining[v]--;
+          break;
+        }
+
+      newCache[newCacheLength] = v;
+      newCacheLength++;
+    }
+
+    for (uint8_t j = 0; j < cacheLength; ++j) // the rest of the LRU cache
+      if (cache[j] != newCache[0] && cache[j] != newCache[1] &&
+        cache[j] != newCache[2])
+      {
+        newCache[newCacheLength] = cache[j];
+        newCacheLength++;
+      }
+
+    for (uint8_t j = 0; j < newCacheLength; ++j)
+    {
+      cache[j] = newCache[j];
+      cachePositions[cache[j]] =
+        j < _S3L_FORSYTH_CACHE_SIZE ? (int8_t) j : -1;
+    }
+
+    cacheLength = S3L_min(newCacheLength,_S3L_FORSYTH_CACHE_SIZE);
+
+    // update the scores of vertices in the cache (and just dropped ones)
+    for (uint8_t j = 0; j < newCacheLength; ++j)
+    {
+      S3L_Index v = newCache[j];
+
+      vertexScores[v] = _S3L_forsythScore(cachePositions[v],remaining[v]);
+    }
+
+    // find the best of triangles touching the cache
+    best = -1;
+    bestScore = -1;
+
+    for (uint8_t j = 0; j < newCacheLength; ++j)
+    {
+      S3L_Index v = newCache[j];
+      S3L_Index *list = adjacency + adjacencyStart[v];
+
+      for (S3L_Index k = 0; k < remaining[v]; ++k)
+      {
+        S3L_Index t = list[k];
+
+        triangleScores[t] = vertexScores[triangles[t * 3]] +
+          vertexScores[triangles[t * 3 + 1]] +
+          vertexScores[triangles[t * 3 + 2]];
+
+        if (triangleScores[t] > bestScore)
+        {
+          bestScore = triangleScores[t];
+          best = t;
+        }
+      }
+    }
+  }
+
+  if (mode == S3L_REORDER_OVERDRAW && vertices != 0)
+    _S3L_sortClustersForOverdraw(triangles,triangleCount,vertices,vertexCount,
+      order,triangleScores,adjacency,adjacency + triangleCount);
+}
+
+void S3L_reorderTriangles(
+  const S3L_Index *order,
+  S3L_Index triangleCount,
+  const S3L_Index *triangles,
+  S3L_Index *result)
+{
+  for (S3L_Index i = 0; i < triangleCount; ++i)
+    for (uint8_t j = 0; j < 3; ++j)
+      result[i * 3 + j] = triangles[order[i] * 3 + j];
+}
+
+S3L_Index S3L_optimizeVertexOrder(
+  S3L_Index *triangles,
+  S3L_Index triangleCount,
+  S3L_Index vertexCount,
+  S3L_Index *remap)
+{
+  const S3L_Index unused = (S3L_Index) ~0;
+  S3L_Index next = 0;
+
+  for (S3L_Index i = 0; i < vertexCount; ++i)
+    remap[i] = unused;
+
+  for (uint32_t i = 0; i < triangleCount * 3; ++i)
+  {
+    if (remap[triangles[i]] == unused)
+    {
+      remap[triangles[i]] = next;
+      next++;
+    }
+
+    triangles[i] = remap[triangles[i]];
+  }
+
+  S3L_Index used = next;
+
+  for (S3L_Index i = 0; i < vertexCount; ++i)
+    if (remap[i] == unused)
+    {
+      remap[i] = next;
+      next++;
+    }
+
+  return used;
+}
+
+void S3L_remapVertices(
+  const S3L_Index *remap,
+  S3L_Index vertexCount,
+  const S3L_Unit *vertices,
+  S3L_Unit *result)
+{
+  for (S3L_Index i = 0; i < vertexCount; ++i)
+    for (uint8_t j = 0; j < 3; ++j)
+      result[remap[i] * 3 + j] = vertices[i * 3 + j];
+}
+
+typedef struct
+{
+  const S3L_Index *triangles;
+  const S3L_Index *attributeIndices;
+  const uint32_t *adjacencyStart;
+  const S3L_Index *adjacency;
+  uint8_t *used;
+  S3L_Index begin;          ///< triangles that can be taken (a material range)
+  S3L_Index end;
+} _S3L_StripState;
+
+/* Corners are positions in the triangle array (triangle * 3 + vertex), two
+   corners are the same if both their vertex and attribute indices are. */
+static inline uint8_t _S3L_cornersEqual(const _S3L_StripState *s, uint32_t a,
+  uint32_t b)
+{
+  return s->triangles[a] == s->triangles[b] && (s->attributeIndices == 0 ||
+    s->attributeIndices[a] == s->attributeIndices[b]);
+}
+
+/* Finds an unused triangle that can be the k-th triangle of the strip whose
+   last two corners are a and b, i.e. which has the edge a -> b (b -> a for
+   odd k, as the strip winding alternates). Returns its third corner or -1. */
+static int32_t _S3L_stripContinuation(const _S3L_StripState *s, uint32_t k,
+  uint32_t a, uint32_t b)
+{
+  if (k & 0x01)
+  {
+    uint32_t tmp = a;
+    a = b;
+    b = tmp;
+  }
+
+  S3L_Index v = s->triangles[a];
+
+  for (uint32_t i = s->adjacencyStart[v]; i < s->adjacencyStart[v + 1]; ++i)
+  {
+    S3L_Index t = s->adjacency[i];
+
+    if (s->used[t] || t < s->begin || t >= s->end)
+      continue;
+
+    for (uint8_t j = 0; j < 3; ++j)
+      if (_S3L_cornersEqual(s,t * 3 + j,a) &&
+        _S3L_cornersEqual(s,t * 3 + (j + 1) % 3,b))
+        return t * 3 + (j + 2) % 3;
+  }
+
+  return -1;
+}
+
+uint32_t S3L_makeTriangleStrip(
+  const S3L_Index *triangles,
+  const S3L_Index *attributeIndices,
+  S3L_Index triangleCount,
+  S3L_Index vertexCount,
+  S3L_MaterialRange *ranges,
+  uint16_t rangeCount,
+  S3L_Index *strip,
+  S3L_Index *attributeStrip,
+  void *work)
+{
+  // work memory layout, 4 byte items first:
+  uint32_t *adjacencyStart = (uint32_t *) work;
+  S3L_Index *adjacency = (S3L_Index *) (adjacencyStart + vertexCount + 1);
+  uint8_t *used = (uint8_t *) (adjacency + triangleCount * 3);
+
+  S3L_Model3D model;
+  S3L_VertexAdjacency vertexAdjacency;
+
+  S3L_initModel3D(0,vertexCount,triangles,triangleCount,&model);
+  vertexAdjacency.start = adjacencyStart;
+  vertexAdjacency.triangles = adjacency;
+  S3L_buildVertexAdjacency(&model,&vertexAdjacency);
+
+  _S3L_StripState s;
+
+  s.triangles = triangles;
+  s.attributeIndices = attributeIndices;
+  s.adjacencyStart = adjacencyStart;
+  s.adjacency = adjacency;
+  s.used = used;
+
+  for (S3L_Index i = 0; i < triangleCount; ++i)
+    used[i] = 0;
+
+  uint32_t length = 0;
+  uint16_t range = 0;
+
+  #define emit(corner)\
+    {\
+      strip[length] = triangles[corner];\
+      if (attributeIndices != 0)\
+        attributeStrip[length] = attributeIndices[corner];\
+      length++;\
+    }
+
+  do // for each material range
+  {
+    s.begin = (ranges != 0 && range > 0) ? ranges[range].firstTriangle : 0;
+    s.end = (ranges != 0 && range + 1 < rangeCount) ?
+      ranges[range + 1].firstTriangle : triangleCount;
+
+    if (ranges != 0)
+      ranges[range].firstTriangle = length == 0 ? 0 : length + 2;
+
+    for (S3L_Index t = s.begin; t < s.end; ++t)
+    {
+      if (used[t])
+        continue;
+
+      used[t] = 1;
+
+      // index of the new strip's first triangle, after the joining ones
+      uint32_t k = length == 0 ? 0 : length + 2;
+
+      uint32_t c[3];
+      uint8_t rotation = 0;
+
+      /* Start with the rotation that can be continued. The strip's last two
+         corners will be c[1], c[2] for even k or c[0], c[2] for odd k. */
+      for (uint8_t r = 0; r < 3; ++r)
+        if (_S3L_stripContinuation(&s,k + 1,t * 3 + (r + 1 - (k & 0x01)) % 3,
+          t * 3 + (r + 2) % 3) >= 0)
+        {
+          rotation = r;
+          break;
+        }
+
+      for (uint8_t j = 0; j < 3; ++j)
+        c[j] = t * 3 + (rotation + j) % 3;
+
+      if (length != 0)
+      {
+        // join with degenerate triangles: repeat the last and the next corner
+        strip[length] = strip[length - 1];
+
+        if (attributeIndices != 0)
+          attributeStrip[length] = attributeStrip[length - 1];
+
+        length++;
+
+        emit(c[k & 0x01])
+      }
+
+      emit(c[k & 0x01])     // the first two swapped for odd k
+      emit(c[1 - (k & 0x01)])
+      emit(c[2])
+
+      uint32_t a = c[1 - (k & 0x01)], b = c[2];
+
+      while (1) // continue the strip
+      {
+        k++;
+
+        int32_t next = _S3L_stripContinuation(&s,k,a,b);
+
+        if (next < 0)
+          break;
+
+        used[next / 3] = 1;
+        emit(next)
+        a = b;
+        b = next;
+      }
+    }
+
+    range++;
+  } while (ranges != 0 && range < rangeCount);
+
+  #undef emit
+
+  return length;
+}
+
+void S3L_buildVertexAdjacency(
+  const S3L_Model3D *model,
+  S3L_VertexAdjacency *adjacency)
+{
+  uint32_t *start = adjacency->start;
+  S3L_Index t[3];
+
+  for (uint32_t i = 0; i <= model->vertexCount; ++i)
+    start[i] = 0;
+
+  for (S3L_Index i = 0; i < model->triangleCount; ++i)
+    if (S3L_getModelTriangle(model,i,t))
+      for (uint8_t j = 0; j < 3; ++j)
+        start[t[j] + 1]++;
+
+  for (S3L_Index i = 0; i < model->vertexCount; ++i)
+    start[i + 1] += start[i];
+
+  // fill, which moves each start to the next vertex's start
+
+  for (S3L_Index i = 0; i < model->triangleCount; ++i)
+    if (S3L_getModelTriangle(model,i,t))
+      for (uint8_t j = 0; j < 3; ++j)
+      {
+        adjacency->triangles[start[t[j]]] = i;
+        start[t[j]]++;
+      }
+
+  for (S3L_Index i = model->vertexCount; i > 0; --i) // shift the starts back
+    start[i] = start[i - 1];
+
+  start[0] = 0;
+}
+
+/* Computes the normal of triangle t weighted for its vertex v into result,
+   also gives the normalized triangle normal in normal (if not 0). */
+static void _S3L_weightedTriangleNormal(
+  const S3L_Model3D *model,
+  S3L_Index t,
+  S3L_Index v,
+  uint8_t weighting,
+  int64_t result[3],
+  S3L_Vec4 *normal)
+{
+  S3L_Index indices[3];
+  S3L_Vec4 p[3];
+  uint8_t corner = 0;
+
+  S3L_getModelTriangle(model,t,indices);
+
+  for (uint8_t i = 0; i < 3; ++i)
+  {
+    S3L_getModelVertex(model,indices[i],p + i);
+
+    if (indices[i] == v)
+      corner = i;
+  }
+
+  int64_t a[3], b[3];
+
+  a[0] = p[1].x - p[0].x; a[1] = p[1].y - p[0].y; a[2] = p[1].z - p[0].z;
+  b[0] = p[2].x - p[0].x; b[1] = p[2].y - p[0].y; b[2] = p[2].z - p[0].z;
+
+  // outward normal (opposite to S3L_triangleNormal), twice the area long
+  result[0] = b[1] * a[2] - b[2] * a[1];
+  result[1] = b[2] * a[0] - b[0] * a[2];
+  result[2] = b[0] * a[1] - b[1] * a[0];
+
+  S3L_Vec4 n;
+
+  _S3L_normalize64(result,&n);
+
+  if (normal != 0)
+    *normal = n;
+
+  if (weighting == S3L_NORMALS_AREA)
+    return;
+
+  int64_t weight = S3L_FRACTIONS_PER_UNIT;
+
+  if (weighting == S3L_NORMALS_ANGLE)
+  {
+    // the angle between the two edges at the vertex, from their dot product
+    int64_t e[2][3];
+    S3L_Vec4 d[2];
+
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+      const S3L_Vec4 *q = p + (corner + 1 + i) % 3;
+
+      e[i][0] = q->x - p[corner].x;
+      e[i][1] = q->y - p[corner].y;
+      e[i][2] = q->z - p[corner].z;
+
+      _S3L_normalize64(e[i],d + i);
+    }
+
+    weight = S3L_FRACTIONS_PER_UNIT / 4 -
+      S3L_asin(S3L_dotProductVec3(d[0],d[1]));
+  }
+
+  result[0] = n.x * weight;
+  result[1] = n.y * weight;
+  result[2] = n.z * weight;
+}
+
+void S3L_computeNormals(
+  const S3L_Model3D *model,
+  const S3L_VertexAdjacency *adjacency,
+  uint8_t weighting,
+  S3L_Index firstVertex,
+  S3L_Index vertexCount,
+  S3L_Unit *normals)
+{
+  for (uint32_t v = firstVertex; v < (uint32_t) firstVertex + vertexCount;
+    ++v)
+  {
+    int64_t sum[3] = {0, 0, 0};
+
+    for (uint32_t i = adjacency->start[v]; i < adjacency->start[v + 1]; ++i)
+    {
+      int64_t n[3];
+
+      _S3L_weightedTriangleNormal(model,adjacency->triangles[i],v,weighting,
+        n,0);
+
+      for (uint8_t c = 0; c < 3; ++c)
+        sum[c] += n[c];
+    }
+
+    S3L_Vec4 n;
+
+    _S3L_normalize64(sum,&n);
+
+    if (n.x == 0 && n.y == 0 && n.z == 0)
+      n.x = S3L_FRACTIONS_PER_UNIT;
+
+    normals[v * 3] = n.x;
+    normals[v * 3 + 1] = n.y;
+    normals[v * 3 + 2] = n.z;
+  }
+}
+
+S3L_Index S3L_computeSplitNormals(
+  const S3L_Model3D *model,
+  const S3L_VertexAdjacency *adjacency,
+  uint8_t weighting,
+  S3L_Unit smoothLimit,
+  S3L_Unit *normals,
+  S3L_Index *normalIndices)
+{
+  S3L_Index count = 0;
+
+  for (S3L_Index v = 0; v < model->vertexCount; ++v)
+  {
+    S3L_Index first = count; // normals of this vertex start here
+
+    for (uint32_t i = adjacency->start[v]; i < adjacency->start[v + 1]; ++i)
+    {
+      S3L_Index t = adjacency->triangles[i];
+      S3L_Vec4 tNormal, uNormal;
+      int64_t sum[3] = {0, 0, 0}, n[3];
+
+      _S3L_weightedTriangleNormal(model,t,v,weighting,n,&tNormal);
+
+      /* Sum the triangles smoothly connected to t (this is quadratic in the
+         vertex's triangle count, which is small). */
+      for (uint32_t j = adjacency->start[v]; j < adjacency->start[v + 1];
+        ++j)
+      {
+        _S3L_weightedTriangleNormal(model,adjacency->triangles[j],v,
+          weighting,n,&uNormal);
+
+        if (S3L_dotProductVec3(tNormal,uNormal) >= smoothLimit)
+          for (uint8_t c = 0; c < 3; ++c)
+            sum[c] += n[c];
+      }
+
+      S3L_Vec4 normal;
+
+      _S3L_normalize64(sum,&normal);
+
+      if (normal.x == 0 && normal.y == 0 && normal.z == 0)
+        normal.x = S3L_FRACTIONS_PER_UNIT;
+
+      // triangles of the same smooth group get the same normal, share it
+
+      S3L_Index index = first;
+
+      while (index < count && (normals[index * 3] != normal.x ||
+        normals[index * 3 + 1] != normal.y ||
+        normals[index * 3 + 2] != normal.z))
+        index++;
+
+      if (index == count)
+      {
+        normals[count * 3] = normal.x;
+        normals[count * 3 + 1] = normal.y;
+        normals[count * 3 + 2] = normal.z;
+        count++;
+      }
+
+      for (uint8_t j = 0; j < 3; ++j)
+        if (model->triangles[t * 3 + j] == v)
+          normalIndices[t * 3 + j] = index;
+    }
+  }
+
+  return count;
+}
@@ -0,0 +1,173 @@
+#ifndef S3L_MESH_H_
+#define S3L_MESH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Mesh processing meant to be run at asset build time or at model init (not
+  per frame): reordering triangles and vertices for the vertex cache (see
+  S3L_VERTEX_CACHE_SIZE), memory locality and less overdraw, making triangle
+  strips (see S3L_TRIANGLE_STRIPS) and computing normals. Computing normals
+  of moved vertices is fast enough to be done after deformations though.
+
+  Reordering triangles only computes a new order, which then has to be
+  applied (S3L_reorderTriangles) to the triangle indices and to all other
+  per triangle arrays (e.g. UV indices of attribute streams). To keep
+  material ranges, reorder each range separately.
+*/
+
+#include "S3L_types.h"
+#include "S3L_texture.h"
+
+#define S3L_REORDER_VERTEX_CACHE 0 ///< only optimize for the vertex cache
+#define S3L_REORDER_OVERDRAW 1     /**< also sort clusters of triangles so that
+                                        the ones likely to occlude others are
+                                        drawn first, from any view */
+
+#ifndef S3L_OVERDRAW_CLUSTER_SIZE
+  /** Number of triangles in a cluster for S3L_REORDER_OVERDRAW. Bigger
+  clusters keep more of the vertex cache locality, smaller ones give a finer
+  front to back ordering. */
+
+  #define S3L_OVERDRAW_CLUSTER_SIZE 16
+#endif
+
+/** Size of work memory in bytes needed by S3L_optimizeTriangleOrder. */
+#define S3L_TRIANGLE_ORDER_WORK_SIZE(vertexCount,triangleCount)\
+  ((vertexCount) * (8 + sizeof(S3L_Index) + 1) +\
+   (triangleCount) * (4 + 3 * sizeof(S3L_Index)) + 4)
+
+/** Computes a triangle order with good vertex cache locality (Forsyth's
+  linear speed vertex cache optimization) and, with S3L_REORDER_OVERDRAW,
+  little overdraw from any view. The order is written to order (order[i] is
+  the index of the triangle to be drawn i-th). Vertices are needed only for
+  S3L_REORDER_OVERDRAW (can be 0 otherwise). work has to have
+  S3L_TRIANGLE_ORDER_WORK_SIZE bytes, aligned to 4. */
+extern void S3L_optimizeTriangleOrder(
+  const S3L_Index *triangles,
+  S3L_Index triangleCount,
+  const S3L_Unit *vertices,
+  S3L_Index vertexCount,
+  uint8_t mode,
+  S3L_Index *order,
+  void *work);
+
+/** Applies a triangle order to an array with three indices per triangle
+  (triangle indices, attribute indices, ...), result must not be the same
+  array as triangles. */
+extern void S3L_reorderTriangles(
+  const S3L_Index *order,
+  S3L_Index triangleCount,
+  const S3L_Index *triangles,
+  S3L_Index *result);
+
+/** Renumbers vertices in the order of their first use by the triangles (which
+  is updated in place) for memory locality of vertex fetches. remap gets the
+  new index of each vertex, unused vertices go after the used ones. Returns
+  the number of used vertices. Apply the remap to vertex data with
+  S3L_remapVertices. */
+extern S3L_Index S3L_optimizeVertexOrder(
+  S3L_Index *triangles,
+  S3L_Index triangleCount,
+  S3L_Index vertexCount,
+  S3L_Index *remap);
+
+/** Moves vertices (three S3L_Units each) to their positions given by remap,
+  result must not be the same array as vertices. */
+extern void S3L_remapVertices(
+  const S3L_Index *remap,
+  S3L_Index vertexCount,
+  const S3L_Unit *vertices,
+  S3L_Unit *result);
+
+/** Size of work memory in bytes needed by S3L_makeTriangleStrip. */
+#define S3L_TRIANGLE_STRIP_WORK_SIZE(vertexCount,triangleCount)\
+  (((vertexCount) + 1) * 4 + (triangleCount) * (3 * sizeof(S3L_Index) + 1))
+
+/** Maximum number of indices S3L_makeTriangleStrip can output. */
+#define S3L_TRIANGLE_STRIP_MAX_SIZE(triangleCount) ((triangleCount) * 5)
+
+/** Converts triangles to a single strip (see S3L_TRIANGLE_STRIPS). Triangles
+  are taken greedily in the given order (so order them for the vertex cache
+  first), two triangles continue a strip if they share an edge with the same
+  vertices and, if attributeIndices is not 0, the same attribute indices
+  (which are then converted to attributeStrip, laid out the same). Strips
+  don't cross material ranges (if ranges is not 0), whose firstTriangle is
+  rewritten to the triangle index in the strip. The strips have
+  S3L_TRIANGLE_STRIP_MAX_SIZE indices at most, work has to have
+  S3L_TRIANGLE_STRIP_WORK_SIZE bytes, aligned to 4. Returns the number of
+  indices written (i.e. the strip's triangle count + 2), which is 0 (no strip
+  at all) if triangleCount is 0, so check it before subtracting 2. */
+extern uint32_t S3L_makeTriangleStrip(
+  const S3L_Index *triangles,
+  const S3L_Index *attributeIndices,
+  S3L_Index triangleCount,
+  S3L_Index vertexCount,
+  S3L_MaterialRange *ranges,
+  uint16_t rangeCount,
+  S3L_Index *strip,
+  S3L_Index *attributeStrip,
+  void *work);
+
+// weightings of triangle normals in vertex normals:
+#define S3L_NORMALS_UNIFORM 0 ///< all triangles count the same
+#define S3L_NORMALS_AREA 1    ///< triangles count by their area
+#define S3L_NORMALS_ANGLE 2   /**< triangles count by their angle at the
+                                   vertex, which doesn't depend on how the
+                                   surface is triangulated, slowest */
+
+/** Triangles of each vertex of a model, triangles of vertex i are
+  triangles[start[i]] up to triangles[start[i + 1] - 1]. */
+typedef struct
+{
+  uint32_t *start;      ///< vertexCount + 1 items
+  S3L_Index *triangles; ///< triangleCount * 3 items
+} S3L_VertexAdjacency;
+
+/** Builds the vertex adjacency of a model (strip models are fine), the arrays
+  have to be allocated by the caller. It only has to be rebuilt when the
+  triangles change, not when vertices move. */
+extern void S3L_buildVertexAdjacency(
+  const S3L_Model3D *model,
+  S3L_VertexAdjacency *adjacency);
+
+/** Computes normalized normals (pointing out of the front faces as lighting
+  expects, i.e. opposite to S3L_triangleNormal) of the model's vertices
+  firstVertex up to firstVertex + vertexCount - 1, in time linear in the
+  number of their triangles, and writes them to normals (3 S3L_Units per
+  vertex, at the vertices' positions). Computing all normals is linear in the
+  number of vertices and triangles. After moving some vertices (e.g. by a
+  deformation), only normals of the moved vertices and their neighbors have
+  to be recomputed, which is cheap if the vertices are ordered for locality
+  (see S3L_optimizeVertexOrder). Vertices without triangles get (1, 0, 0). */
+extern void S3L_computeNormals(
+  const S3L_Model3D *model,
+  const S3L_VertexAdjacency *adjacency,
+  uint8_t weighting,
+  S3L_Index firstVertex,
+  S3L_Index vertexCount,
+  S3L_Unit *normals);
+
+/** Computes normals with hard edges: a vertex's normal for a triangle only
+  averages the triangles whose normals differ from that triangle's normal
+  less than given by smoothLimit (the minimum cosine of the angle between
+  them, e.g. S3L_FRACTIONS_PER_UNIT / 2 for 60 degrees), so one vertex can
+  have several normals. Normals are written to normals (3 S3L_Units each, at
+  most triangleCount * 3 of them) and their indices to normalIndices (three
+  per triangle), which makes an attribute stream with indices (this doesn't
+  work with strip models). Returns the number of normals. */
+extern S3L_Index S3L_computeSplitNormals(
+  const S3L_Model3D *model,
+  const S3L_VertexAdjacency *adjacency,
+  uint8_t weighting,
+  S3L_Unit smoothLimit,
+  S3L_Unit *normals,
+  S3L_Index *normalIndices);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
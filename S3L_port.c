@@ -1,52 +1,400 @@
-
 #include "S3L_types.h"
-#include "texture_model.h"
+#include "S3L_texture.h"
 #include "small3dlib.h"
-inline uint8_t sampleTexture(int32_t u, int32_t v);
+
+/* log2 of S3L_FRACTIONS_PER_UNIT: UVs span the whole texture in S3L_Units, so
+   they're shifted by this minus the texture's log size to get texels. */
+#define S3L_PORT_UNIT_LOG 9
+
+#if (1 << S3L_PORT_UNIT_LOG) != S3L_FRACTIONS_PER_UNIT
+  #error S3L_PORT_UNIT_LOG does not match S3L_FRACTIONS_PER_UNIT.
+#endif
+
+static inline uint8_t sampleTexture(int32_t u, int32_t v);
 static uint16_t *pFBuff;
-static uint32_t previousTriangle = -1;
-static S3L_Vec4 uv0, uv1, uv2;
+
+static const S3L_Material *materials;
+static const S3L_ModelMaterials *modelMaterials;
+
+/* State of the current triangle, resolved from its material. */
+static const uint8_t *texture;
+static const uint16_t *palette;
+static uint8_t textureLogW, textureLogH;
+static uint8_t uvAttribute;
+
+#if S3L_LIGHTING == 2
+/* Gouraud lit triangles pick a level of the shaded palettes per pixel by the
+   intensity, which is the last attribute. 0 if the material is unlit. */
+static const uint16_t *shadedPalettes;
+static uint8_t intensityAttribute;
+#endif
 
 void S3L_SetFBuffAddr(uint16_t *buff){
     pFBuff = buff;
 }
-void S3L_pixel_function(S3L_PixelInfo *pixel){
- if (pixel->triangleID != previousTriangle)
+void S3L_ClearFBuff(uint16_t color){
+  S3L_FILL_FUNCTION(pFBuff,color,S3L_RESOLUTION_X * S3L_RESOLUTION_Y);
+}
+void S3L_ScaleFBuff(uint16_t width, uint16_t height){
+  if (width == S3L_RESOLUTION_X && height == S3L_RESOLUTION_Y)
+    return;
+
+  // 16.16 steps, from the end so that no pixel is overwritten before read
+  uint32_t stepX = (((uint32_t) S3L_RESOLUTION_X) << 16) / width;
+  uint32_t stepY = (((uint32_t) S3L_RESOLUTION_Y) << 16) / height;
+  uint16_t *dst = pFBuff + width * height;
+
+  for (int32_t y = height - 1; y >= 0; --y)
+  {
+    const uint16_t *row = pFBuff + ((y * stepY) >> 16) * S3L_RESOLUTION_X;
+
+    for (int32_t x = width - 1; x >= 0; --x)
+      *--dst = row[(x * stepX) >> 16];
+  }
+}
+void S3L_SetMaterials(const S3L_Material *materialTable,
+  const S3L_ModelMaterials *modelMaterialTable){
+  materials = materialTable;
+  modelMaterials = modelMaterialTable;
+}
+void S3L_triangle_function(const S3L_TriangleInfo *triangle){
+  const S3L_Material *material = materials + S3L_materialIndex(
+    modelMaterials + triangle->modelIndex,triangle->triangleIndex);
+
+  uint8_t level = 0;
+
+#if S3L_MIP_LEVELS > 1
+  if (material->mipLevels > 1)
   {
-    const S3L_Index *uvIndices;
-    const S3L_Unit *uvs;
+    S3L_Unit extent[2];
 
-    if (pixel->modelIndex == 0)
+    for (uint8_t i = 0; i < 2; ++i)
     {
-      uvIndices = cityUVIndices;
-      uvs = cityUVs;
+      const uint8_t a = material->uvAttribute + i;
+
+      extent[i] =
+        S3L_max(S3L_triangleAttributes[0][a],
+          S3L_max(S3L_triangleAttributes[1][a],S3L_triangleAttributes[2][a])) -
+        S3L_min(S3L_triangleAttributes[0][a],
+          S3L_min(S3L_triangleAttributes[1][a],S3L_triangleAttributes[2][a]));
     }
-    else
+
+    level = S3L_selectMipLevel(extent[0],extent[1],triangle->triangleSize,
+      material->logWidth,material->logHeight,material->mipLevels);
+  }
+#endif
+
+  texture = S3L_mipLevel(material->texels,material->mips,material->logWidth,
+    material->logHeight,level);
+  palette = material->palette;
+
+#if S3L_LIGHTING == 1
+  if (material->shadedPalettes != 0) // the whole triangle has one shade
+    palette = material->shadedPalettes +
+      (S3L_shadeLevel(triangle->intensity) << 8);
+#elif S3L_LIGHTING == 2
+  shadedPalettes = material->shadedPalettes;
+  intensityAttribute = S3L_triangleAttributeCount - 1;
+#endif
+
+  textureLogW = material->logWidth - level;
+  textureLogH = material->logHeight - level;
+  uvAttribute = material->uvAttribute;
+}
+void S3L_pixel_function(S3L_PixelInfo *pixel){
+  /* UVs come interpolated from the models' attribute streams. */
+  uint16_t *buf=pFBuff;
+
+  buf += pixel->y * S3L_RESOLUTION_X;
+  buf += pixel->x;
+
+#if S3L_LIGHTING == 2
+  if (shadedPalettes != 0)
+  {
+    *buf = shadedPalettes[
+      (S3L_shadeLevel(pixel->attributes[intensityAttribute]) << 8) |
+      sampleTexture(
+        pixel->attributes[uvAttribute] >>
+          (S3L_PORT_UNIT_LOG - textureLogW),
+        pixel->attributes[uvAttribute + 1] >>
+          (S3L_PORT_UNIT_LOG - textureLogH))];
+    return;
+  }
+#endif
+
+  *buf = palette[sampleTexture(
+    pixel->attributes[uvAttribute] >> (S3L_PORT_UNIT_LOG - textureLogW),
+    pixel->attributes[uvAttribute + 1] >> (S3L_PORT_UNIT_LOG - textureLogH))];
+
+}
+
+#if S3L_PORT_SPANS
+/* Draws an affine textured span with a paletted texture of 2^logW x 2^logH
+   8 bit texels. UVs are attributes uv and uv + 1, in S3L_Units over the whole
+   texture (S3L_FRACTIONS_PER_UNIT == 2^S3L_PORT_UNIT_LOG), they're stepped
+   in the span's fixed point format and only shifted to get the texel. If lit
+   (Gouraud lighting), palette are the shaded palettes and the interpolated
+   intensity picks one per pixel. This is meant to be inlined with constant
+   sizes, see TEXTURED_SPAN_VARIANT. */
+static inline void texturedSpan(const S3L_SpanInfo *span,
+  const uint8_t *texture, const uint16_t *palette, uint8_t logW, uint8_t logH,
+  uint8_t uv, uint8_t lit)
+{
+#ifndef S3L_TEXTURE_ADDRESS_START
+  const uint8_t shiftU = S3L_FAST_LERP_QUALITY + S3L_PORT_UNIT_LOG - logW;
+  const uint8_t shiftV = S3L_FAST_LERP_QUALITY + S3L_PORT_UNIT_LOG - logH;
+  const uint32_t maskU = (1 << logW) - 1;
+  const uint32_t maskV = (1 << logH) - 1;
+#endif
+
+  S3L_Unit u = span->attributesScaled[uv],
+    du = span->attributeStepsScaled[uv];
+  S3L_Unit v = span->attributesScaled[uv + 1],
+    dv = span->attributeStepsScaled[uv + 1];
+
+#if S3L_LIGHTING == 2
+  S3L_Unit light = lit ? span->attributesScaled[intensityAttribute] : 0,
+    dLight = lit ? span->attributeStepsScaled[intensityAttribute] : 0;
+#else
+  (void) lit;
+#endif
+
+  uint16_t *buf = pFBuff + span->y * S3L_RESOLUTION_X + span->x0;
+  uint16_t *bufEnd = buf + (span->x1 - span->x0);
+
+#if S3L_Z_BUFFER
+  S3L_Unit depth = span->depthScaled, dDepth = span->depthStepScaled;
+  S3L_Unit *z = S3L_zBuffer + span->y * S3L_RESOLUTION_X + span->x0;
+#endif
+
+#ifdef S3L_TEXTURE_ADDRESS_START
+  S3L_TEXTURE_ADDRESS_START(texture,logW,logH,u,du,v,dv);
+#endif
+
+  while (buf < bufEnd)
+  {
+#ifdef S3L_TEXTURE_ADDRESS_START
+    const uint8_t *texelAddress = S3L_TEXTURE_ADDRESS_NEXT(); // steps too
+#endif
+
+#if S3L_Z_BUFFER
+    S3L_Unit d = depth >> S3L_FAST_LERP_QUALITY;
+
+    if (d < *z)
     {
-      uvIndices = carUVIndices;
-      uvs = carUVs;
+      *z = d;
+#endif
+#ifdef S3L_TEXTURE_ADDRESS_START
+      uint32_t texel = *texelAddress;
+#else
+      uint32_t texel = texture[S3L_texelIndex(
+        ((uint32_t) u >> shiftU) & maskU,((uint32_t) v >> shiftV) & maskV,
+        logW,logH)];
+#endif
+
+#if S3L_LIGHTING == 2
+      if (lit)
+        texel |= S3L_shadeLevel(light >> S3L_FAST_LERP_QUALITY) << 8;
+#endif
+
+      *buf = palette[texel];
+#if S3L_Z_BUFFER
     }
 
-    S3L_getIndexedTriangleValues(pixel->triangleIndex,uvIndices,uvs,2,&uv0,&uv1,&uv2);
+    z++;
+    depth += dDepth;
+#endif
 
-    previousTriangle = pixel->triangleID;
+    buf++;
+#ifndef S3L_TEXTURE_ADDRESS_START
+    u += du;
+    v += dv;
+#endif
+#if S3L_LIGHTING == 2
+    light += dLight;
+#endif
   }
+}
 
-  S3L_Unit uv[2];
+#define TEXTURED_SPAN_VARIANT(logSize)\
+  static void texturedSpan##logSize(const S3L_SpanInfo *span,\
+    const uint8_t *texture, const uint16_t *palette, uint8_t uv)\
+  {\
+    texturedSpan(span,texture,palette,logSize,logSize,uv,0);\
+  }
 
-  uv[0] = S3L_interpolateBarycentric(uv0.x,uv1.x,uv2.x,pixel->barycentric);
-  uv[1] = S3L_interpolateBarycentric(uv0.y,uv1.y,uv2.y,pixel->barycentric);
-  uint16_t *buf=pFBuff;
+TEXTURED_SPAN_VARIANT(4) // 16x16
+TEXTURED_SPAN_VARIANT(5) // 32x32
+TEXTURED_SPAN_VARIANT(6) // 64x64
+TEXTURED_SPAN_VARIANT(7) // 128x128
+TEXTURED_SPAN_VARIANT(8) // 256x256
 
-  buf += pixel->y * 120;
-  buf += pixel->x;
-  *buf = cityPalette[sampleTexture(uv[0] >> 2,uv[1] >> 2)];
+#undef TEXTURED_SPAN_VARIANT
+
+typedef void (*TexturedSpanFunction)(const S3L_SpanInfo *span,
+  const uint8_t *texture, const uint16_t *palette, uint8_t uv);
+
+#define TEXTURED_SPAN_MIN_LOG_SIZE 4
+#define TEXTURED_SPAN_MAX_LOG_SIZE 8
 
+/* Square texture span functions indexed by log2 of size minus
+   TEXTURED_SPAN_MIN_LOG_SIZE. */
+static const TexturedSpanFunction texturedSpanFunctions[] =
+{
+  texturedSpan4, texturedSpan5, texturedSpan6, texturedSpan7, texturedSpan8
+};
+
+void S3L_span_function(const S3L_SpanInfo *span){
+#if S3L_LIGHTING == 2
+  if (shadedPalettes != 0) // lit spans only go through the generic version
+  {
+    texturedSpan(span,texture,shadedPalettes,textureLogW,textureLogH,
+      uvAttribute,1);
+    return;
+  }
+#endif
+
+  if (textureLogW == textureLogH && textureLogW >= TEXTURED_SPAN_MIN_LOG_SIZE &&
+    textureLogW <= TEXTURED_SPAN_MAX_LOG_SIZE)
+    texturedSpanFunctions[textureLogW - TEXTURED_SPAN_MIN_LOG_SIZE]
+      (span,texture,palette,uvAttribute);
+  else // other sizes go through the slower generic version
+    texturedSpan(span,texture,palette,textureLogW,textureLogH,uvAttribute,0);
 }
+#endif
 
-inline uint8_t sampleTexture(int32_t u, int32_t v)
+static inline uint8_t sampleTexture(int32_t u, int32_t v)
 {
-  uint32_t index = v * CITY_TEXTURE_WIDTH + u;
+  /* Stepped interpolation can overshoot the texture by a texel at triangle
+     edges, so wrap. */
+  return texture[S3L_texelIndex(u & ((1 << textureLogW) - 1),
+    v & ((1 << textureLogH) - 1),textureLogW,textureLogH)];
+}
+
+/* Software versions of the accelerator hooks, see S3L_port.h. */
+
+void S3L_clear_function(uint32_t *buffer, uint32_t value, uint32_t count){
+  uint32_t *end = buffer + count;
+
+  while (buffer < end)
+    *buffer++ = value;
+}
+
+void S3L_fill_function(uint16_t *pixels, uint16_t color, uint32_t count){
+  uint16_t *end = pixels + count;
+
+  while (pixels < end)
+    *pixels++ = color;
+}
+
+S3L_Unit S3L_divide_function(S3L_Unit n, S3L_Unit d){
+  return n / d;
+}
+
+static const uint8_t *addressTexture;
+static uint8_t addressLogW, addressLogH;
+static uint32_t addressU, addressDU, addressV, addressDV;
+
+void S3L_texture_address_start(const uint8_t *texture, uint8_t logW,
+  uint8_t logH, S3L_Unit u, S3L_Unit du, S3L_Unit v, S3L_Unit dv){
+  addressTexture = texture;
+  addressLogW = logW;
+  addressLogH = logH;
+  addressU = u;
+  addressDU = du;
+  addressV = v;
+  addressDV = dv;
+}
+
+const uint8_t *S3L_texture_address_next(void){
+  const uint8_t *result = addressTexture + S3L_texelIndex(
+    (addressU >> (S3L_FAST_LERP_QUALITY + S3L_PORT_UNIT_LOG - addressLogW)) &
+      ((1 << addressLogW) - 1),
+    (addressV >> (S3L_FAST_LERP_QUALITY + S3L_PORT_UNIT_LOG - addressLogH)) &
+      ((1 << addressLogH) - 1),addressLogW,addressLogH);
+
+  addressU += addressDU;
+  addressV += addressDV;
+
+  return result;
+}
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "hardware/timer.h"
+#include "hardware/dma.h"
+#include "hardware/divider.h"
+#include "hardware/interp.h"
+
+uint32_t S3L_profileClock(void){
+  return time_us_32(); // 1 MHz, the timer the SDK runs on
+}
+
+/* Fills count transfers of given size at buffer with value by DMA and waits
+   for it. */
+static void dmaFill(void *buffer, uint32_t value, uint32_t count,
+  enum dma_channel_transfer_size size){
+  static int channel = -1;
+  static uint32_t source; // read by the DMA, lowest bytes first
+
+  if (channel < 0)
+    channel = dma_claim_unused_channel(true);
+
+  source = value;
+
+  dma_channel_config config = dma_channel_get_default_config(channel);
+  channel_config_set_transfer_data_size(&config,size);
+  channel_config_set_read_increment(&config,false);
+  channel_config_set_write_increment(&config,true);
+
+  dma_channel_configure(channel,&config,buffer,&source,count,true);
+  dma_channel_wait_for_finish_blocking(channel);
+}
+
+void S3L_pico_clear(uint32_t *buffer, uint32_t value, uint32_t count){
+  dmaFill(buffer,value,count,DMA_SIZE_32);
+}
+
+void S3L_pico_fill(uint16_t *pixels, uint16_t color, uint32_t count){
+  dmaFill(pixels,color,count,DMA_SIZE_16);
+}
+
+/* The SIO divider, without saving its state, so interrupt handlers mustn't
+   divide with it (the SDK's '/' does save it, but takes a call). */
+S3L_Unit S3L_pico_divide(S3L_Unit n, S3L_Unit d){
+  return hw_divider_s32_quotient_inlined(n,d);
+}
+
+#if S3L_TEXTURE_LAYOUT == S3L_TEXTURE_LAYOUT_ROWS
+/* Interpolator 0 of the core: lane 0 steps U and extracts the texel column,
+   lane 1 steps V and extracts the row already shifted above the column, the
+   full result adds both to the texture address. Lanes of 1 texel wide or
+   high textures stay at 0. The shift of lane 1 needs logW + logH <=
+   S3L_PORT_UNIT_LOG + S3L_FAST_LERP_QUALITY, i.e. up to 2^20 texels. */
+void S3L_pico_texture_address_start(const uint8_t *texture, uint8_t logW,
+  uint8_t logH, S3L_Unit u, S3L_Unit du, S3L_Unit v, S3L_Unit dv){
+  interp_config config = interp_default_config();
+  interp_config_set_add_raw(&config,true); // lanes step by the bases
+  interp_config_set_shift(&config,
+    S3L_FAST_LERP_QUALITY + S3L_PORT_UNIT_LOG - logW);
+  interp_config_set_mask(&config,0,logW ? logW - 1 : 0);
+  interp_set_config(interp0,0,&config);
+
+  config = interp_default_config();
+  interp_config_set_add_raw(&config,true);
+  interp_config_set_shift(&config,
+    S3L_FAST_LERP_QUALITY + S3L_PORT_UNIT_LOG - logH - logW);
+  interp_config_set_mask(&config,logW,logH ? logW + logH - 1 : logW);
+  interp_set_config(interp0,1,&config);
+
+  interp0->accum[0] = logW ? u : 0;
+  interp0->base[0] = logW ? du : 0;
+  interp0->accum[1] = logH ? v : 0;
+  interp0->base[1] = logH ? dv : 0;
+  interp0->base[2] = (uint32_t) texture;
+}
 
-  return cityTexture[index];
+const uint8_t *S3L_pico_texture_address_next(void){
+  return (const uint8_t *) interp0->pop[2];
 }
+#endif
+#endif
@@ -6,12 +6,127 @@
 extern "C" {
 #endif
 #include "S3L_types.h"
+#include "S3L_texture.h"
 
+/* The port textures every triangle, its UVs being the first two
+   attributes. */
+#if S3L_MAX_ATTRIBUTES < 2
+  #error The port needs S3L_MAX_ATTRIBUTES >= 2 (for UVs).
+#endif
+
+/* The hooks below can be predefined to other functions that call the port's
+   ones, e.g. to count pixels and triangles in the host benchmarks. Both the
+   port's functions and the hooks are declared here. */
 
-#define S3L_PIXEL_FUNCTION S3L_pixel_function
+#ifndef S3L_PIXEL_FUNCTION
+  #define S3L_PIXEL_FUNCTION S3L_pixel_function
+#endif
 
 extern void S3L_pixel_function(S3L_PixelInfo *pixel); 
+extern void S3L_PIXEL_FUNCTION(S3L_PixelInfo *pixel);
+
+/* Materials (and MIP levels) are resolved once per triangle. */
+#ifndef S3L_TRIANGLE_FUNCTION
+  #define S3L_TRIANGLE_FUNCTION S3L_triangle_function
+#endif
+
+extern void S3L_triangle_function(const S3L_TriangleInfo *triangle);
+extern void S3L_TRIANGLE_FUNCTION(const S3L_TriangleInfo *triangle);
+
+/* Spans are drawn by specialized textured span functions whenever the
+   configuration allows it (see S3L_SPAN_FUNCTION), a span hook can only be
+   defined then. Spans are z-tested by the port, so they're off with
+   S3L_OVERDRAW and S3L_STATS, which count the library's per pixel tests. */
+#if !S3L_PERSPECTIVE_CORRECTION && !S3L_FLAT && !S3L_VISIBILITY_BUFFER &&\
+  !S3L_STENCIL_BUFFER && S3L_Z_BUFFER != 2 && !S3L_OVERDRAW && !S3L_STATS
+  #define S3L_PORT_SPANS 1
+
+  #ifndef S3L_SPAN_FUNCTION
+    #define S3L_SPAN_FUNCTION S3L_span_function
+  #endif
+
+extern void S3L_span_function(const S3L_SpanInfo *span);
+extern void S3L_SPAN_FUNCTION(const S3L_SpanInfo *span);
+#else
+  #define S3L_PORT_SPANS 0
+
+  #ifdef S3L_SPAN_FUNCTION
+    #error S3L_SPAN_FUNCTION is defined but the port has no spans in this\
+           configuration (see S3L_PORT_SPANS)!
+  #endif
+#endif
+
+/* Accelerators. Clearing and filling always go through the hooks below,
+   which default to the port's software functions. Texture addressing and
+   division are per pixel and per vertex, so unless the port defines those
+   hooks (e.g. in the build) the library and the port inline their own code.
+   The port's software versions of them (S3L_divide_function etc.) compute
+   the same, the host build routes the hooks to them to test the hooked
+   paths; device builds route them to the hardware (S3L_pico_* in
+   S3L_port.c). */
+
+/* Fills count 32 bit words at buffer with value, e.g. by DMA. Clears the
+   z-buffer (with S3L_Z_BUFFER 1). */
+#ifndef S3L_CLEAR_FUNCTION
+  #define S3L_CLEAR_FUNCTION S3L_clear_function
+#endif
+
+extern void S3L_clear_function(uint32_t *buffer, uint32_t value,
+  uint32_t count);
+extern void S3L_CLEAR_FUNCTION(uint32_t *buffer, uint32_t value,
+  uint32_t count);
+
+/* Fills count pixels with color, e.g. by DMA. Clears the framebuffer (see
+   S3L_ClearFBuff). */
+#ifndef S3L_FILL_FUNCTION
+  #define S3L_FILL_FUNCTION S3L_fill_function
+#endif
+
+extern void S3L_fill_function(uint16_t *pixels, uint16_t color,
+  uint32_t count);
+extern void S3L_FILL_FUNCTION(uint16_t *pixels, uint16_t color,
+  uint32_t count);
+
+/* Returns n / d like C's division (d is never 0), e.g. by a hardware
+   divider. Divides by depth, see S3L_RECIPROCAL_DIVISION. */
+extern S3L_Unit S3L_divide_function(S3L_Unit n, S3L_Unit d);
+
+#ifdef S3L_DIVIDE_FUNCTION
+extern S3L_Unit S3L_DIVIDE_FUNCTION(S3L_Unit n, S3L_Unit d);
+#endif
+
+/* Texel addresses of the port's spans, e.g. by the RP2040's interpolator.
+   S3L_TEXTURE_ADDRESS_START is called once per span with the texture, its
+   size and the UVs and their steps in the span's fixed point format (see
+   S3L_SpanInfo), S3L_TEXTURE_ADDRESS_NEXT then once per pixel returns the
+   address of the pixel's texel (wrapped to the texture) and steps to the
+   next one. */
+extern void S3L_texture_address_start(const uint8_t *texture, uint8_t logW,
+  uint8_t logH, S3L_Unit u, S3L_Unit du, S3L_Unit v, S3L_Unit dv);
+extern const uint8_t *S3L_texture_address_next(void);
+
+#if defined(S3L_TEXTURE_ADDRESS_START) != defined(S3L_TEXTURE_ADDRESS_NEXT)
+  #error S3L_TEXTURE_ADDRESS_START and S3L_TEXTURE_ADDRESS_NEXT go together.
+#endif
+
+#ifdef S3L_TEXTURE_ADDRESS_START
+extern void S3L_TEXTURE_ADDRESS_START(const uint8_t *texture, uint8_t logW,
+  uint8_t logH, S3L_Unit u, S3L_Unit du, S3L_Unit v, S3L_Unit dv);
+extern const uint8_t *S3L_TEXTURE_ADDRESS_NEXT(void);
+#endif
+
 extern void S3L_SetFBuffAddr(uint16_t *buff);
+/* Fills the whole framebuffer with color. */
+extern void S3L_ClearFBuff(uint16_t color);
+/* Scales the rendered image (S3L_RESOLUTION_X x S3L_RESOLUTION_Y pixels)
+   up to width x height in place (nearest neighbour), for
+   S3L_DYNAMIC_RESOLUTION. The framebuffer has to hold width x height
+   pixels, which can't be less than the rendered ones. */
+extern void S3L_ScaleFBuff(uint16_t width, uint16_t height);
+/* Sets the material table and the material ranges of the scene's models
+   (indexed by model index), see S3L_texture.h. */
+extern void S3L_SetMaterials(const S3L_Material *materials,
+  const S3L_ModelMaterials *modelMaterials);
 
   
 #ifdef __cplusplus
@@ -0,0 +1,171 @@
+#include "S3L_texture.h"
+
+static uint8_t S3L_closestPaletteColor(const uint16_t *palette, uint8_t r,
+  uint8_t g, uint8_t b)
+{
+  uint8_t result = 0;
+  int32_t bestDistance = 0x7fffffff;
+
+  for (uint16_t i = 0; i < 256; ++i)
+  {
+    int32_t dr = S3L_colorR(palette[i]) - r;
+    int32_t dg = S3L_colorG(palette[i]) - g;
+    int32_t db = S3L_colorB(palette[i]) - b;
+
+    int32_t distance = dr * dr + dg * dg + db * db;
+
+    if (distance < bestDistance)
+    {
+      bestDistance = distance;
+      result = i;
+
+      if (distance == 0)
+        break;
+    }
+  }
+
+  return result;
+}
+
+uint8_t S3L_materialIndex(
+  const S3L_ModelMaterials *materials,
+  S3L_Index triangleIndex)
+{
+  uint16_t a = 0, b = materials->rangeCount;
+
+  while (b - a > 1) // find the last range starting at or before the triangle
+  {
+    uint16_t middle = (a + b) / 2;
+
+    if (materials->ranges[middle].firstTriangle <= triangleIndex)
+      a = middle;
+    else
+      b = middle;
+  }
+
+  return materials->ranges[a].material;
+}
+
+void S3L_swizzleTexture(
+  const uint8_t *rows,
+  uint8_t logW,
+  uint8_t logH,
+  uint8_t *result)
+{
+  for (uint32_t v = 0; v < (1u << logH); ++v)
+    for (uint32_t u = 0; u < (1u << logW); ++u)
+      result[S3L_texelIndex(u,v,logW,logH)] = *rows++;
+}
+
+uint32_t S3L_mipChainSize(uint8_t logW, uint8_t logH, uint8_t levels)
+{
+  uint32_t result = 0;
+
+  for (uint8_t level = 1; level < levels && level <= logW && level <= logH;
+    ++level)
+    result += 1u << (logW - level + logH - level);
+
+  return result;
+}
+
+void S3L_buildMipChain(
+  const uint8_t *texture,
+  uint8_t logW,
+  uint8_t logH,
+  const uint16_t *palette,
+  uint8_t levels,
+  uint8_t *mips)
+{
+  const uint8_t *src = texture;
+
+  for (uint8_t level = 1; level < levels && level <= logW && level <= logH;
+    ++level)
+  {
+    uint8_t srcLogW = logW - level + 1, srcLogH = logH - level + 1;
+    uint16_t w = 1 << (logW - level), h = 1 << (logH - level);
+
+    for (uint16_t y = 0; y < h; ++y)
+      for (uint16_t x = 0; x < w; ++x)
+      {
+        #define texel(dx,dy)\
+          palette[src[S3L_texelIndex(2 * x + dx,2 * y + dy,srcLogW,srcLogH)]]
+
+        uint16_t c0 = texel(0,0),
+                 c1 = texel(1,0),
+                 c2 = texel(0,1),
+                 c3 = texel(1,1);
+
+        #undef texel
+
+        #define average(channel)\
+          ((S3L_color##channel(c0) + S3L_color##channel(c1) +\
+            S3L_color##channel(c2) + S3L_color##channel(c3) + 2) / 4)
+
+        mips[S3L_texelIndex(x,y,logW - level,logH - level)] =
+          S3L_closestPaletteColor(palette,average(R),average(G),average(B));
+
+        #undef average
+      }
+
+    src = mips;
+    mips += w * h;
+  }
+}
+
+const uint8_t *S3L_mipLevel(
+  const uint8_t *texture,
+  const uint8_t *mips,
+  uint8_t logW,
+  uint8_t logH,
+  uint8_t level)
+{
+  if (level == 0)
+    return texture;
+
+  return mips + S3L_mipChainSize(logW,logH,level);
+}
+
+uint8_t S3L_selectMipLevel(
+  S3L_Unit uExtent,
+  S3L_Unit vExtent,
+  const S3L_ScreenCoord triangleSize[2],
+  uint8_t logW,
+  uint8_t logH,
+  uint8_t levels)
+{
+  if (triangleSize[0] <= 0 || triangleSize[1] <= 0)
+    return 0; // unknown size (e.g. visibility buffer resolve)
+
+  // extents in texels of level 0:
+  uint32_t texelsU = ((uint32_t) uExtent << logW) / S3L_FRACTIONS_PER_UNIT;
+  uint32_t texelsV = ((uint32_t) vExtent << logH) / S3L_FRACTIONS_PER_UNIT;
+
+  uint8_t level = 0;
+
+  while (level + 1 < levels && level < logW && level < logH &&
+    ((texelsU >> (level + 1)) >= (uint32_t) triangleSize[0] ||
+     (texelsV >> (level + 1)) >= (uint32_t) triangleSize[1]))
+    level++;
+
+  return level;
+}
+
+void S3L_buildShadedPalettes(
+  const uint16_t *palette,
+  uint16_t *result)
+{
+  for (uint16_t level = 0; level < S3L_SHADE_LEVELS; ++level)
+    for (uint16_t i = 0; i < 256; ++i)
+    {
+      uint16_t c = palette[i];
+
+      #define shade(channel)\
+        ((S3L_color##channel(c) * level + (S3L_SHADE_LEVELS - 1) / 2) /\
+          (S3L_SHADE_LEVELS - 1))
+
+      *result = S3L_color(shade(R),shade(G),shade(B),S3L_colorA(c));
+      result++;
+
+      #undef shade
+    }
+}
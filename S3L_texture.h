@@ -0,0 +1,228 @@
+#ifndef S3L_TEXTURE_H_
+#define S3L_TEXTURE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Helpers for 8 bit paletted textures: memory layout, MIP map generation and
+  selection, shading for S3L_LIGHTING. Texture sizes are powers of two, given
+  by their base 2 logarithms, texels are stored in the layout given by
+  S3L_TEXTURE_LAYOUT (always use S3L_texelIndex to address them). Palette
+  colors are in the PicoSystem 16 bit format, i.e. 4 bits per channel, from
+  the lowest bits: red, alpha, blue, green.
+*/
+
+#include "S3L_types.h"
+
+#define S3L_TEXTURE_LAYOUT_ROWS 0
+#define S3L_TEXTURE_LAYOUT_TILED 1
+#define S3L_TEXTURE_LAYOUT_MORTON 2
+
+#ifndef S3L_TEXTURE_LAYOUT
+  /** Memory layout of texels, which decides how well texture fetches hit
+  the (flash/XIP) cache:
+
+  - S3L_TEXTURE_LAYOUT_ROWS: Rows one after another. Simplest and fastest to
+    address, but walking a texture vertically touches a new cache line every
+    texel.
+  - S3L_TEXTURE_LAYOUT_TILED: Square tiles of 2^S3L_TEXTURE_TILE_LOG_SIZE
+    texels stored one after another, rows inside tiles. Makes cache hits
+    mostly independent of the direction of walking the texture at the cost
+    of a few more operations per fetch.
+  - S3L_TEXTURE_LAYOUT_MORTON: Morton (Z) order, i.e. the bits of u and v
+    interleaved. Keeps locality at all scales (good with MIP mapping), but
+    is the most expensive to address.
+
+  Textures have to be converted to the layout with S3L_swizzleTexture, at
+  init or (better) offline by the asset converter. */
+
+  #define S3L_TEXTURE_LAYOUT S3L_TEXTURE_LAYOUT_ROWS
+#endif
+
+#ifndef S3L_TEXTURE_TILE_LOG_SIZE
+  /** Base 2 logarithm of the tile width and height for
+  S3L_TEXTURE_LAYOUT_TILED, e.g. 2 means 4x4 tiles of 16 bytes. Textures
+  (and MIP levels) smaller than a tile use tiles of their size. */
+
+  #define S3L_TEXTURE_TILE_LOG_SIZE 2
+#endif
+
+#ifndef S3L_MIP_LEVELS
+  /** Number of MIP levels of textures including the base one (level 0), each
+  level has half the width and height of the previous one. 1 means no MIP
+  mapping. */
+
+  #define S3L_MIP_LEVELS 1
+#endif
+
+#ifndef S3L_SHADE_LEVELS
+  /** Number of light levels of shaded palettes (S3L_buildShadedPalettes),
+  including black and the unchanged palette. With 4 bits per channel more
+  than 16 levels don't add any colors. */
+
+  #define S3L_SHADE_LEVELS 16
+#endif
+
+#define S3L_colorR(c) ((c) & 0x000f)
+#define S3L_colorA(c) (((c) >> 4) & 0x000f)
+#define S3L_colorB(c) (((c) >> 8) & 0x000f)
+#define S3L_colorG(c) (((c) >> 12) & 0x000f)
+
+#define S3L_color(r,g,b,a)\
+  ((uint16_t) (((r) & 0x0f) | (((a) & 0x0f) << 4) | (((b) & 0x0f) << 8) |\
+  (((g) & 0x0f) << 12)))
+
+/** Surface description: texture, its palette and where its UVs are. */
+typedef struct
+{
+  const uint8_t *texels;   ///< level 0 texels, in S3L_TEXTURE_LAYOUT
+  const uint8_t *mips;     ///< levels from S3L_buildMipChain, 0 if none
+  const uint16_t *palette;
+  uint8_t logWidth;
+  uint8_t logHeight;
+  uint8_t mipLevels;       ///< number of MIP levels including level 0
+  uint8_t uvAttribute;     /**< index of the U attribute (model attribute
+                                streams' components are numbered one after
+                                another), V is the next one */
+#if S3L_LIGHTING
+  const uint16_t *shadedPalettes; /**< palette shaded by
+                                S3L_buildShadedPalettes, 0 for unlit */
+#endif
+} S3L_Material;
+
+/** Assigns a material to the model's triangles from firstTriangle up to the
+  start of the next range. */
+typedef struct
+{
+  S3L_Index firstTriangle;
+  uint8_t material;        ///< index to the material table
+} S3L_MaterialRange;
+
+/** Materials of one model: ranges sorted by firstTriangle, the first one
+  starting at 0. A model with a single material has a single range. Sorting
+  triangles by material (e.g. in the converter) keeps the ranges few. */
+typedef struct
+{
+  const S3L_MaterialRange *ranges;
+  uint16_t rangeCount;
+} S3L_ModelMaterials;
+
+/** Returns the material index of given triangle (binary search in the
+  ranges), meant to be called once per triangle. */
+extern uint8_t S3L_materialIndex(
+  const S3L_ModelMaterials *materials,
+  S3L_Index triangleIndex);
+
+#if S3L_TEXTURE_LAYOUT == S3L_TEXTURE_LAYOUT_MORTON
+/** Spreads the lower 16 bits of x to even bit positions. */
+static inline uint32_t S3L_spreadBits(uint32_t x)
+{
+  x = (x | (x << 8)) & 0x00ff00ff;
+  x = (x | (x << 4)) & 0x0f0f0f0f;
+  x = (x | (x << 2)) & 0x33333333;
+  return (x | (x << 1)) & 0x55555555;
+}
+#endif
+
+/** Returns the index of texel [u,v] (which have to be inside the texture)
+  of a 2^logW x 2^logH texture in S3L_TEXTURE_LAYOUT. This is meant to be
+  inlined with constant sizes in the sampling code. */
+static inline uint32_t S3L_texelIndex(uint32_t u, uint32_t v, uint8_t logW,
+  uint8_t logH)
+{
+#if S3L_TEXTURE_LAYOUT == S3L_TEXTURE_LAYOUT_TILED
+  uint8_t t = logW < logH ? logW : logH;
+
+  if (t > S3L_TEXTURE_TILE_LOG_SIZE)
+    t = S3L_TEXTURE_TILE_LOG_SIZE;
+
+
+  uint32_t tileMask = (1 << t) - 1;
+
+  return (((((v >> t) << (logW - t)) | (u >> t)) << (2 * t)) |
+    ((v & tileMask) << t) | (u & tileMask));
+#elif S3L_TEXTURE_LAYOUT == S3L_TEXTURE_LAYOUT_MORTON
+  // square part interleaved, the rest of the longer side on top
+  uint8_t m = logW < logH ? logW : logH;
+  uint32_t mask = (1 << m) - 1;
+
+  return (((u >> m) | (v >> m)) << (2 * m)) |
+    S3L_spreadBits(u & mask) | (S3L_spreadBits(v & mask) << 1);
+#else
+  (void) logH;
+  return (v << logW) | u;
+#endif
+}
+
+/** Converts a texture with texels in rows to S3L_TEXTURE_LAYOUT, result
+  has to have 2^(logW + logH) bytes and must not be the same as rows. */
+extern void S3L_swizzleTexture(
+  const uint8_t *rows,
+  uint8_t logW,
+  uint8_t logH,
+  uint8_t *result);
+
+/** Returns the number of bytes needed to store MIP levels 1 to levels - 1 of
+  a texture (level 0 is the texture itself). */
+extern uint32_t S3L_mipChainSize(uint8_t logW, uint8_t logH, uint8_t levels);
+
+/** Builds MIP levels 1 to levels - 1 of a paletted texture into mips (which
+  has to have S3L_mipChainSize bytes), one after another. Each texel is the
+  palette color closest to the average of the 2x2 texels of the previous
+  level. Both texture and mips are in S3L_TEXTURE_LAYOUT. This is slow
+  (searches the palette for each texel), so do it at init or offline. */
+extern void S3L_buildMipChain(
+  const uint8_t *texture,
+  uint8_t logW,
+  uint8_t logH,
+  const uint16_t *palette,
+  uint8_t levels,
+  uint8_t *mips);
+
+/** Returns a pointer to the texels of given MIP level, level 0 is texture
+  itself and the other ones are in mips built by S3L_buildMipChain. */
+extern const uint8_t *S3L_mipLevel(
+  const uint8_t *texture,
+  const uint8_t *mips,
+  uint8_t logW,
+  uint8_t logH,
+  uint8_t level);
+
+/** Selects a MIP level for a triangle so that one screen pixel covers at
+  most about one texel: uExtent and vExtent are the triangle's UV extents in
+  S3L_Units (S3L_FRACTIONS_PER_UNIT is the whole texture), triangleSize is
+  the rasterized size from S3L_TriangleInfo. This is meant to be called per
+  triangle, e.g. from the triangle function. */
+extern uint8_t S3L_selectMipLevel(
+  S3L_Unit uExtent,
+  S3L_Unit vExtent,
+  const S3L_ScreenCoord triangleSize[2],
+  uint8_t logW,
+  uint8_t logH,
+  uint8_t levels);
+
+/** Returns the level of shaded palettes (S3L_buildShadedPalettes) for a
+  light intensity from 0 to S3L_FRACTIONS_PER_UNIT. */
+static inline uint8_t S3L_shadeLevel(S3L_Unit intensity)
+{
+  return (intensity * (S3L_SHADE_LEVELS - 1) + S3L_FRACTIONS_PER_UNIT / 2) /
+    S3L_FRACTIONS_PER_UNIT;
+}
+
+/** Builds a shade table of a palette for lighting: S3L_SHADE_LEVELS copies of
+  the palette (256 colors each, i.e. result has S3L_SHADE_LEVELS * 256 items)
+  with colors darkened by level / (S3L_SHADE_LEVELS - 1). A lit texel is then
+  a single lookup, result[(level << 8) | texel], and a triangle with one
+  intensity (flat lighting) can just use palette result + (level << 8). The
+  table is exact, unlike remapping to the closest colors of the palette. */
+extern void S3L_buildShadedPalettes(
+  const uint16_t *palette,
+  uint16_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,6 +7,150 @@ extern "C" {
 #endif
 
 #include <stdint.h> 
+#include "S3L_config.h"
+
+#ifndef S3L_MAX_ATTRIBUTES
+  /** Maximum number of per-vertex attribute components (e.g. 2 for UV
+  coordinates, 3 for a normal) a model can declare with attribute streams
+  (S3L_AttributeStream). The rasterizer interpolates these and passes the
+  ready values to the pixel function in S3L_PixelInfo. 0 turns this off, the
+  port's texturing needs at least 2 (UVs). The values have to fit into 20
+  bits (with S3L_FAST_LERP_QUALITY 11) so that the stepped interpolation
+  doesn't overflow. */
+
+  #define S3L_MAX_ATTRIBUTES 2
+#endif
+
+#ifndef S3L_QUANTIZED_VERTICES
+  /** If on, models can store vertices as int16_t triplets (quantizedVertices)
+  instead of S3L_Units, which halves their memory and bandwidth (good for
+  meshes in flash). The stored values are dequantized as offset + value *
+  scale / S3L_FRACTIONS_PER_UNIT, which is folded into the model's world
+  matrix, so it costs nothing per vertex. See S3L_quantizeVertices. */
+
+  #define S3L_QUANTIZED_VERTICES 0
+#endif
+
+#ifndef S3L_TRIANGLE_STRIPS
+  /** If on, models can store triangles as one strip (triangleStrip), which
+  takes about a third of the index memory (and of flash reads). Triangle k of
+  a strip is made of the indices k, k + 1 and k + 2, with the first two
+  swapped for odd k (to keep the winding), so any triangle can still be
+  accessed directly by its index. Separate strips are joined by repeating
+  indices, and the triangles this makes (with repeated vertices) are skipped.
+  Attribute indices of such model have the same layout. See
+  S3L_makeTriangleStrip in S3L_mesh.h. */
+
+  #define S3L_TRIANGLE_STRIPS 0
+#endif
+
+#ifndef S3L_LIGHTING
+  /** Lighting by the scene's lights (S3L_Light), computed in the geometry
+  pass from the models' precomputed normals (see S3L_computeNormals in
+  S3L_mesh.h), so pixels only get a ready light intensity (0 to
+  S3L_FRACTIONS_PER_UNIT). Possible values:
+
+  - 0: No lighting.
+  - 1: Flat, one intensity per triangle (intensity in S3L_TriangleInfo,
+    S3L_SpanInfo and S3L_PixelInfo). This costs nothing per pixel, e.g. a
+    shaded palette can be chosen once per triangle.
+  - 2: Gouraud, intensities computed per vertex and interpolated by the
+    rasterizer as the last attribute (after the model's attribute streams,
+    which get one component less of S3L_MAX_ATTRIBUTES).
+
+  Models without normals get the normal of each triangle (computed per
+  triangle, which is slower). */
+
+  #define S3L_LIGHTING 0
+#endif
+
+#ifndef S3L_MAX_LIGHTS
+  /** Maximum number of lights used by S3L_LIGHTING, further lights of the
+  scene are ignored. Each light adds a dot product (and a square root for
+  point lights) per lit vertex. */
+
+  #define S3L_MAX_LIGHTS 4
+#endif
+
+#ifndef S3L_RECIPROCAL_DIVISION
+  /** If on, the divisions by depth (the perspective divide of vertices and
+  the depth reciprocals of S3L_PERSPECTIVE_CORRECTION) multiply by a
+  reciprocal from a small table refined by a Newton step instead of
+  dividing, for CPUs without a (fast) hardware divider, such as Cortex-M0+
+  cores. The quotients are corrected to be exactly those of the division, so
+  the output doesn't change. Ignored if the port has a divider (see
+  S3L_DIVIDE_FUNCTION). */
+
+  #define S3L_RECIPROCAL_DIVISION 0
+#endif
+
+#ifndef S3L_STATS
+  /** If on, S3L_newFrame, S3L_drawScene and S3L_drawTriangle count culled,
+  split and rasterized triangles, rasterized and rejected pixels etc. of the
+  frame in S3L_stats (see S3L_Stats), which can be read at any time. If off,
+  the counting compiles to nothing. */
+
+  #define S3L_STATS 0
+#endif
+
+#ifndef S3L_STATS_CLOCK
+  /** Function-like macro returning the current time as uint32_t, in any
+  units (e.g. a cycle counter), for the times in S3L_stats. By default there
+  is no clock and the times stay 0. */
+
+  #define S3L_STATS_CLOCK() 0
+#endif
+
+#ifndef S3L_PROFILE
+  /** Timing of the library's phases (zones, S3L_ZONE_*) with
+  S3L_PROFILE_CLOCK, in S3L_profile: time of each zone in the frame, events
+  of the zones entered once per frame and, after S3L_profileEndFrame,
+  histograms of the zones' frame times. Possible values:
+
+  - 0: No profiling.
+  - 1: Zones entered once per frame or model (clear, scene, matrices, sort,
+    resolve), a few clock reads per model. On the host benchmark this costs
+    about 5 % in the scene of many small models (many_models, p50 92 to
+    97 us) and nothing measurable elsewhere.
+  - 2: Also the per triangle zones (projection, rasterization), four clock
+    reads per triangle, which about doubles the time of many_models.
+  - 3: All zones, which also reads the clock around each call of the pixel,
+    span and triangle functions, so it slows down all rendering noticeably
+    (about 2.2 times in the city_drive scene). */
+
+  #define S3L_PROFILE 0
+#endif
+
+#ifndef S3L_PROFILE_CLOCK
+  /** Function-like macro returning the current time as uint32_t for
+  S3L_PROFILE, by default S3L_profileClock implemented by the port (e.g.
+  the RP2040 timer) or the host backend. Durations are differences of two
+  readings, so the clock may overflow. */
+
+  #define S3L_PROFILE_CLOCK() S3L_profileClock()
+#endif
+
+#ifndef S3L_PROFILE_EVENTS
+  /** Maximum number of recorded zone events (see S3L_ProfileEvent) per
+  frame, further ones are only counted. */
+
+  #define S3L_PROFILE_EVENTS 16
+#endif
+
+#ifndef S3L_OVERDRAW
+  /** Debug mode counting in S3L_overdraw, for each pixel of the frame, the
+  fragments rasterized to it, those that passed the z-buffer and stencil
+  tests and those that were shaded (passed to the pixel function, with
+  S3L_VISIBILITY_BUFFER only once in S3L_resolveVisibilityBuffer). The image
+  is rendered as usual, but the port draws pixels instead of spans so that
+  they can be counted. Takes 3 bytes per pixel. */
+
+  #define S3L_OVERDRAW 0
+#endif
+
+#if S3L_LIGHTING == 2 && S3L_MAX_ATTRIBUTES == 0
+  #error Gouraud lighting (S3L_LIGHTING 2) needs S3L_MAX_ATTRIBUTES.
+#endif
 
 /** Units of measurement in 3D space. There is S3L_FRACTIONS_PER_UNIT in one
 spatial unit. By dividing the unit into fractions we effectively achieve a
@@ -46,6 +190,22 @@ typedef struct
 
 typedef S3L_Unit S3L_Mat4[4][4]; 
 
+typedef struct
+{
+  const S3L_Unit *values;   /**< Attribute values, numComponents for each
+                                 item. */
+  const S3L_Index *indices; /**< If not 0, contains three indices into values
+                                 for each triangle (e.g. UV indices), which
+                                 allows the values to differ for the same
+                                 vertex (seams). These are laid out the same
+                                 as the model's triangles (i.e. as a strip if
+                                 the model is one). If 0, the values are
+                                 per-vertex and are indexed by the model's
+                                 triangle indices. */
+  uint8_t numComponents;    ///< Number of components of one value.
+} S3L_AttributeStream;      /**< Per-vertex values (UVs, normals, colors,
+                                 ...) to be interpolated by the rasterizer. */
+
 typedef struct
 {
   S3L_Unit focalLength;       ///< Defines the field of view (FOV).
@@ -74,16 +234,164 @@ typedef struct
                                      transform matrix, which is more
                                      general. */
   S3L_DrawConfig config;
+#if S3L_MAX_ATTRIBUTES > 0
+  const S3L_AttributeStream *attributes; /**< Attribute streams whose values
+                                     are interpolated and passed to the pixel
+                                     function, in this order. */
+  uint8_t attributeCount;
+#endif
+#if S3L_QUANTIZED_VERTICES
+  const int16_t *quantizedVertices; /**< If != 0, used instead of vertices
+                                     and dequantized with the following. */
+  S3L_Vec4 quantizationScale;   ///< size of one quantization step
+  S3L_Vec4 quantizationOffset;  ///< position of the quantized zero
+#endif
+#if S3L_TRIANGLE_STRIPS
+  uint8_t triangleStrip;        /**< If not 0, triangles (and attribute
+                                     indices) are a strip of triangleCount + 2
+                                     indices. */
+#endif
+#if S3L_LIGHTING
+  const S3L_Unit *normals;      /**< Normalized normals for lighting, 3
+                                     S3L_Units each, pointing out of the front
+                                     faces (see S3L_computeNormals), 0 means
+                                     using normals of triangles. */
+  const S3L_Index *normalIndices; /**< If not 0, three indices into normals
+                                     for each triangle (for hard edges), laid
+                                     out like attribute indices. If 0, normals
+                                     are per-vertex. */
+#endif
 } S3L_Model3D;                ///< Represents a 3D model.
 
+#define S3L_LIGHT_DIRECTIONAL 0
+#define S3L_LIGHT_POINT 1
+
+typedef struct
+{
+  uint8_t type;               ///< S3L_LIGHT_DIRECTIONAL or S3L_LIGHT_POINT.
+  S3L_Vec4 vector;            /**< Direction in which a directional light
+                                   shines (normalized), position of a point
+                                   light, in world space. */
+  S3L_Unit intensity;         ///< S3L_FRACTIONS_PER_UNIT is full intensity.
+  S3L_Unit range;             /**< Distance at which a point light's intensity
+                                   falls (linearly) to zero. */
+} S3L_Light;                  ///< Light for S3L_LIGHTING.
 
 typedef struct
 {
   S3L_Model3D *models;
   S3L_Index modelCount;
   S3L_Camera camera;
+#if S3L_LIGHTING
+  const S3L_Light *lights;
+  uint8_t lightCount;
+  S3L_Unit ambientLight;      ///< Intensity added to all lights.
+#endif
 } S3L_Scene;                  ///< Represent the 3D scene to be rendered.
 
+#if S3L_STATS
+typedef struct
+{
+  uint32_t triangles;         /**< Triangles of visible models that were
+                                   projected (degenerate strip triangles are
+                                   skipped before). */
+  uint32_t culledFrustum;     ///< Triangles outside the screen.
+  uint32_t culledNear;        /**< Triangles in front of the near plane, or
+                                   crossing it with S3L_NEAR_CROSS_STRATEGY
+                                   0. */
+  uint32_t culledBackface;    ///< Triangles removed by backface culling.
+  uint32_t split;             /**< Triangles split in two at the near plane
+                                   (S3L_NEAR_CROSS_STRATEGY 2). */
+  uint32_t dropped;           /**< Triangles not processed because the sort
+                                   array (S3L_MAX_TRIANGES_DRAWN) or the
+                                   visibility buffer's triangle table
+                                   (S3L_VISIBILITY_TRIANGLES) was full. */
+  uint32_t rasterized;        /**< Triangles rasterized (S3L_drawTriangle
+                                   calls, which includes the halves of split
+                                   triangles). */
+  uint32_t pixels;            ///< Pixels (fragments) rasterized.
+  uint32_t zRejected;         ///< Pixels that failed the z-buffer test.
+  uint32_t stencilRejected;   ///< Pixels that failed the stencil test.
+  uint32_t pixelsDrawn;       /**< Pixels passed to the pixel function. With
+                                   S3L_SPAN_FUNCTION, pixels of spans are
+                                   tested and drawn by the span function, so
+                                   they're only in pixels. */
+  uint32_t sortTime;          /**< Time of sorting triangles (S3L_SORT), in
+                                   S3L_STATS_CLOCK units. */
+} S3L_Stats;                  ///< Statistics of a frame for S3L_STATS.
+#endif
+
+#if S3L_PROFILE
+// profiling zones, the time of a zone includes the zones nested in it:
+#define S3L_ZONE_CLEAR 0          ///< clearing buffers in S3L_newFrame
+#define S3L_ZONE_SCENE 1          ///< whole S3L_drawScene
+#define S3L_ZONE_MATRICES 2       ///< model and camera matrices, lights
+#define S3L_ZONE_PROJECTION 3     /**< projecting and culling triangles,
+                                       fetching and lighting attributes
+                                       (S3L_PROFILE 2) */
+#define S3L_ZONE_SORT 4           ///< sorting triangles (S3L_SORT)
+#define S3L_ZONE_RASTERIZATION 5  ///< S3L_drawTriangle (S3L_PROFILE 2)
+#define S3L_ZONE_SHADING 6        /**< pixel, span and triangle functions
+                                       (S3L_PROFILE 3) */
+#define S3L_ZONE_RESOLVE 7        ///< S3L_resolveVisibilityBuffer
+#define S3L_ZONE_COUNT 8
+
+#define S3L_PROFILE_HISTOGRAM_BUCKETS 32
+
+typedef struct
+{
+  uint8_t zone;               ///< S3L_ZONE_*
+  uint32_t start;             ///< Clock ticks since the start of the frame.
+  uint32_t duration;          ///< In clock ticks.
+} S3L_ProfileEvent;           /**< One run of a zone entered once per frame
+                                   (clear, scene, sort and resolve). */
+
+typedef struct
+{
+  uint32_t frameStart;        ///< Clock at S3L_newFrame.
+  uint32_t time[S3L_ZONE_COUNT];  ///< Clock ticks of each zone in the frame.
+  uint32_t count[S3L_ZONE_COUNT]; ///< Times each zone was entered.
+  S3L_ProfileEvent events[S3L_PROFILE_EVENTS]; ///< In the order they ended.
+  uint16_t eventCount;
+  uint16_t eventsDropped;     ///< Events that didn't fit in events.
+  uint32_t frames;            ///< Frames in the histograms.
+  uint32_t histogram[S3L_ZONE_COUNT][S3L_PROFILE_HISTOGRAM_BUCKETS]; /**<
+                                   Number of frames by the zone's time in
+                                   them, bucket i counts times of 2^(i - 1)
+                                   up to 2^i - 1 ticks (bucket 0 counts 0
+                                   ticks). */
+} S3L_Profile;                ///< Profiling data for S3L_PROFILE.
+#endif
+
+#if S3L_OVERDRAW
+typedef struct
+{
+  uint8_t fragments[S3L_MAX_PIXELS]; /**< Rasterized fragments (depth
+                                   complexity), the counts saturate at
+                                   255. */
+  uint8_t passed[S3L_MAX_PIXELS];    ///< Fragments that passed the tests.
+  uint8_t shaded[S3L_MAX_PIXELS];    ///< Pixel function calls (overdraw).
+} S3L_Overdraw;               ///< Per pixel counters for S3L_OVERDRAW.
+#endif
+
+#if S3L_DYNAMIC_RESOLUTION
+#define S3L_RESOLUTION_STEPS 16 ///< resolution steps of the controller
+
+typedef struct
+{
+  uint32_t budget;            /**< Frame time to keep under, in any units
+                                   (the same as the measured times). */
+  uint32_t average;           ///< Smoothed frame time.
+  uint8_t scale;              /**< Resolution in S3L_RESOLUTION_STEPS of the
+                                   maximum one. */
+  uint8_t minScale;           ///< Lowest scale, S3L_RESOLUTION_STEPS / 2.
+  uint8_t settle;             /**< Frames since the last change, they're
+                                   not averaged until the resolution shows in
+                                   the times. */
+} S3L_ResolutionController;   /**< Adapts the resolution to the frame time
+                                   for S3L_DYNAMIC_RESOLUTION. */
+#endif
+
 typedef struct
 {
   S3L_ScreenCoord x;          ///< Screen X coordinate.
@@ -112,9 +420,56 @@ typedef struct
                                back, e.g. for transparency. */
   S3L_ScreenCoord triangleSize[2]; /**< Rasterized triangle width and height,
                               can be used e.g. for MIP mapping. */
+#if S3L_LIGHTING == 1
+  S3L_Unit intensity;      ///< Light intensity of the triangle.
+#endif
+#if S3L_MAX_ATTRIBUTES > 0
+  S3L_Unit attributes[S3L_MAX_ATTRIBUTES]; /**< Interpolated components of the
+                              model's attribute streams, in the order of the
+                              streams. */
+#endif
 }S3L_PixelInfo;         /**< Used to pass the info about a rasterized pixel
                               (fragment) to the user-defined drawing func. */
 
+typedef struct
+{
+  S3L_Index modelIndex;    ///< Model index within the scene.
+  S3L_Index triangleIndex; ///< Triangle index within the model.
+  uint32_t triangleID;     ///< Same as triangleID in S3L_PixelInfo.
+  S3L_Vec4 points[3];      /**< Triangle vertices in screen space (x and y in
+                               pixels, z is depth), in the same order as the
+                               barycentric coordinates of its pixels. */
+  S3L_ScreenCoord triangleSize[2]; ///< Same as triangleSize in S3L_PixelInfo.
+#if S3L_LIGHTING == 1
+  S3L_Unit intensity;      ///< Same as intensity in S3L_PixelInfo.
+#endif
+} S3L_TriangleInfo;      /**< Passed to the user-defined triangle function
+                              before the triangle's pixels are drawn. */
+
+typedef struct
+{
+  S3L_ScreenCoord y;       ///< Screen Y coordinate of the span.
+  S3L_ScreenCoord x0;      ///< First screen X coordinate of the span.
+  S3L_ScreenCoord x1;      ///< Screen X coordinate right after the span.
+  S3L_Index modelIndex;    ///< Model index within the scene.
+  S3L_Index triangleIndex; ///< Triangle index within the model.
+  uint32_t triangleID;     ///< Same as triangleID in S3L_PixelInfo.
+  S3L_Unit depthScaled;    /**< Depth at x0, shifted left by
+                                S3L_FAST_LERP_QUALITY. */
+  S3L_Unit depthStepScaled; ///< Depth change per pixel, also shifted.
+#if S3L_LIGHTING == 1
+  S3L_Unit intensity;      ///< Same as intensity in S3L_PixelInfo.
+#endif
+#if S3L_MAX_ATTRIBUTES > 0
+  S3L_Unit attributesScaled[S3L_MAX_ATTRIBUTES]; /**< Attribute values at x0,
+                                shifted left by S3L_FAST_LERP_QUALITY. */
+  S3L_Unit attributeStepsScaled[S3L_MAX_ATTRIBUTES]; /**< Attribute changes
+                                per pixel, also shifted. */
+#endif
+} S3L_SpanInfo;          /**< Passed to the user-defined span function, which
+                              draws a whole horizontal line of a triangle
+                              (already clipped to the screen). */
+
 
 
 #ifdef __cplusplus
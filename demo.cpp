@@ -10,10 +10,12 @@
 #define ACCELERATION 600
 #define TURN_SPEED 200
 #define FRICTION 600
+#define RENDER_BUDGET 20000 // us, leaves 5 ms of a 40 FPS frame to the rest
 
 using namespace picosystem;
 
 S3L_Model3D models[2];
+S3L_ModelMaterials modelMaterials[2]; // indexed like models
 const uint8_t collisionMap[8 * 10] =
 {
   1,1,1,1,1,1,1,1,
@@ -29,6 +31,10 @@ const uint8_t collisionMap[8 * 10] =
 };
 S3L_Scene scene;
 
+#if S3L_DYNAMIC_RESOLUTION
+S3L_ResolutionController resolution;
+#endif
+
 int16_t velocity = 7;
 
 uint32_t previousTime = 0;
@@ -65,12 +71,20 @@ void handleCollision(S3L_Vec4 *pos, S3L_Vec4 previousPos)
 // initialise the world
 void init() {
   S3L_SetFBuffAddr(SCREEN->data);
+  cityMaterialsInit();
   cityModelInit();
   carModelInit();
+  modelMaterials[0] = cityModelMaterials;
+  modelMaterials[1] = carModelMaterials;
+  S3L_SetMaterials(cityMaterials,modelMaterials);
   models[0] = cityModel;
   models[1] = carModel;
   S3L_initScene(models,2,&scene);
 
+#if S3L_DYNAMIC_RESOLUTION
+  S3L_initResolutionController(&resolution,RENDER_BUDGET);
+#endif
+
   S3L_setTransform3D(1909,16,-3317,0,-510,0,512,512,512,&(models[1].transform));
 
 
@@ -89,11 +103,19 @@ void update(uint32_t tick) {
 
 // draw the world
 void draw(uint32_t tick) {
-  pen(0,0,150);
-  clear();
+#if S3L_DYNAMIC_RESOLUTION
+  uint32_t renderStart = S3L_profileClock();
+#endif
+  S3L_ClearFBuff(S3L_color(0,0,6,15)); // what pen(0,0,150) gave
       models[1].transform.rotation.y += models[1].transform.rotation.z; // overturn the car for the rendering
     S3L_newFrame();
   S3L_drawScene(scene);
+  S3L_resolveVisibilityBuffer(scene);
+
+#if S3L_DYNAMIC_RESOLUTION
+  S3L_ScaleFBuff(SCREEN->w,SCREEN->h);
+  S3L_updateResolution(&resolution,S3L_profileClock() - renderStart);
+#endif
 
 
       models[1].transform.rotation.y -= models[1].transform.rotation.z; // turn the car back for the physics
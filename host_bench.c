@@ -0,0 +1,410 @@
+/*
+  Deterministic benchmark for the host build: renders the scripted scenes of
+  host_scenes.h (a drive through the city, an overview of it and synthetic
+  stress scenes) and reports frame time percentiles and triangle and pixel
+  throughput. Runs are repeatable and comparable across configurations. The
+  S3L_* options are compile time, so the host build makes one s3l_bench_NAME
+  per tested combination (see CMakeLists.txt), run them all with:
+
+    cmake --build build --target benchmark
+
+  Built with S3L_STATS, the library's statistics (see S3L_Stats) are printed
+  too, averaged per frame, and checked: each scene must rasterize and draw
+  pixels, and every rasterized pixel must be either drawn or rejected (the
+  benchmark fails otherwise). Built with S3L_PROFILE, so are the times of the
+  library's zones (see S3L_Profile), as average microseconds per frame and
+  the 90th percentile from the histogram (an upper bound, the buckets are
+  powers of two), and the measured frames can be written as a trace. Built
+  with S3L_DYNAMIC_RESOLUTION, a frame time budget can be given, which the
+  resolution controller (see S3L_updateResolution) then keeps the frames
+  under.
+
+  Triangles are those passed to the rasterizer (S3L_TRIANGLE_FUNCTION, i.e.
+  after culling and near plane splitting), pixels are those passed to the
+  port (S3L_PIXEL_FUNCTION, or whole spans with S3L_SPAN_FUNCTION, in which
+  case they're counted before the z-buffer test). Times only include the
+  library (S3L_newFrame, S3L_drawScene and S3L_resolveVisibilityBuffer), not
+  clearing the framebuffer.
+
+  usage: s3l_bench [-f FRAMES] [-w FRAMES] [-s SCENE] [-p FILE] [-t FILE]
+                   [-b BUDGET] [-csv]
+    -f FRAMES  measured frames per scene (default 512)
+    -w FRAMES  warm-up frames per scene, not measured (default 32)
+    -s SCENE   run only the scene of given name
+    -p FILE    drive the car along a recorded path instead of the scripted
+               one: a text file of "x z" positions in S3L_Units, one per line
+    -t FILE    write a trace of the measured frames for chrome://tracing or
+               Perfetto (only with S3L_PROFILE)
+    -b BUDGET  adapt the resolution to keep frames under BUDGET microseconds
+               (only with S3L_DYNAMIC_RESOLUTION)
+    -csv       print CSV instead of a table
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "small3dlib.h"
+#include "host_scenes.h"
+#include "S3L_host.h"
+
+static uint64_t benchTriangles;
+static uint64_t benchPixels;
+
+// hooks routed here by the build (S3L_PIXEL_FUNCTION=S3L_benchPixel etc.)
+
+void S3L_benchPixel(S3L_PixelInfo *pixel)
+{
+  benchPixels++;
+  S3L_pixel_function(pixel);
+}
+
+void S3L_benchTriangle(const S3L_TriangleInfo *triangle)
+{
+  benchTriangles++;
+  S3L_triangle_function(triangle);
+}
+
+#if S3L_PORT_SPANS
+void S3L_benchSpan(const S3L_SpanInfo *span)
+{
+  benchPixels += span->x1 - span->x0;
+  S3L_span_function(span);
+}
+#endif
+
+static double now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC,&t);
+
+  return t.tv_sec * 1000000.0 + t.tv_nsec / 1000.0;
+}
+
+static int compareTimes(const void *a, const void *b)
+{
+  double d = *((const double *) a) - *((const double *) b);
+  return d < 0 ? -1 : (d > 0);
+}
+
+static double percentile(const double *sorted, int count, int p)
+{
+  return sorted[((count - 1) * p) / 100];
+}
+
+#if S3L_STATS
+static S3L_Stats statsSum; // of the measured frames
+
+static void addStats(void)
+{
+  #define add(counter) statsSum.counter += S3L_stats.counter;
+  add(triangles) add(culledFrustum) add(culledNear) add(culledBackface)
+  add(split) add(dropped) add(rasterized) add(pixels) add(zRejected)
+  add(stencilRejected) add(pixelsDrawn) add(sortTime)
+  #undef add
+}
+
+static void printStats(int frames)
+{
+  #define avg(counter) (((double) statsSum.counter) / frames)
+  printf("  per frame: %.1f triangles, culled %.1f frustum, %.1f near, "
+    "%.1f backface, %.1f split, %.1f dropped, %.1f rasterized\n"
+    "  per frame: %.0f pixels, %.0f z-rejected, %.0f stencil-rejected, "
+    "%.0f drawn, %.0f sort time\n",
+    avg(triangles),avg(culledFrustum),avg(culledNear),avg(culledBackface),
+    avg(split),avg(dropped),avg(rasterized),avg(pixels),avg(zRejected),
+    avg(stencilRejected),avg(pixelsDrawn),avg(sortTime));
+  #undef avg
+}
+
+static int checkStats(const char *scene)
+{
+  if (statsSum.pixels == 0 || statsSum.pixelsDrawn == 0)
+  {
+    fprintf(stderr,"%s: no pixels counted\n",scene);
+    return 0;
+  }
+
+#if !S3L_VISIBILITY_BUFFER && !S3L_STENCIL_BUFFER
+  /* Drawn pixels are counted by the resolve with the visibility buffer, and
+     the stencil and z-buffer both reject some pixels. */
+  if (statsSum.pixels !=
+    statsSum.pixelsDrawn + statsSum.zRejected + statsSum.stencilRejected)
+  {
+    fprintf(stderr,"%s: %u pixels aren't %u drawn + %u rejected\n",scene,
+      statsSum.pixels,statsSum.pixelsDrawn,
+      statsSum.zRejected + statsSum.stencilRejected);
+    return 0;
+  }
+#endif
+
+  return 1;
+}
+#endif
+
+#if S3L_PROFILE
+static const char *zoneNames[S3L_ZONE_COUNT] =
+{
+  "clear", "scene", "matrices", "projection", "sort", "rasterization",
+  "shading", "resolve"
+};
+
+static uint64_t zoneSum[S3L_ZONE_COUNT]; // of the measured frames
+
+static void addProfile(void)
+{
+  for (uint8_t i = 0; i < S3L_ZONE_COUNT; ++i)
+    zoneSum[i] += S3L_profile.time[i];
+}
+
+static void printProfile(int frames)
+{
+  double rate = S3L_hostClockRate();
+
+  for (uint8_t i = 0; i < S3L_ZONE_COUNT; ++i)
+  {
+    if (S3L_profile.histogram[i][0] == S3L_profile.frames)
+      continue; // zone not entered (or not profiled)
+
+    uint32_t count = 0;
+    uint8_t bucket = 0;
+
+    while (bucket < S3L_PROFILE_HISTOGRAM_BUCKETS - 1 &&
+      (count += S3L_profile.histogram[i][bucket]) * 10 <
+      S3L_profile.frames * 9)
+      bucket++;
+
+    printf("  %-14s %8.1f us/frame, p90 < %.1f us\n",zoneNames[i],
+      zoneSum[i] / rate / frames,((((uint64_t) 1) << bucket) - 1) / rate);
+  }
+}
+#endif
+
+#if S3L_DYNAMIC_RESOLUTION
+static S3L_ResolutionController resolution;
+static uint64_t pixelSum; // of the measured frames
+static int resolutionChanges;
+
+static void printResolution(int budget, int frames)
+{
+  printf("  budget %d us: %.1f %% of the pixels on average, %d changes, "
+    "last %dx%d\n",budget,(100.0 * pixelSum) / frames / S3L_MAX_PIXELS,
+    resolutionChanges,S3L_RESOLUTION_X,S3L_RESOLUTION_Y);
+}
+#endif
+
+static void render(void)
+{
+  S3L_newFrame();
+  S3L_drawScene(hostScene);
+  S3L_resolveVisibilityBuffer(hostScene);
+}
+
+int main(int argc, char **argv)
+{
+  int frames = 512, warmUp = 32, budget = 0, csv = 0;
+  const char *sceneName = 0, *pathFile = 0, *traceFile = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i],"-f") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-w") == 0 && i + 1 < argc)
+      warmUp = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-s") == 0 && i + 1 < argc)
+      sceneName = argv[++i];
+    else if (strcmp(argv[i],"-p") == 0 && i + 1 < argc)
+      pathFile = argv[++i];
+    else if (strcmp(argv[i],"-t") == 0 && i + 1 < argc)
+      traceFile = argv[++i];
+    else if (strcmp(argv[i],"-b") == 0 && i + 1 < argc)
+      budget = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-csv") == 0)
+      csv = 1;
+    else
+    {
+      fprintf(stderr,"usage: s3l_bench [-f FRAMES] [-w FRAMES] [-s SCENE] "
+        "[-p FILE] [-t FILE] [-b BUDGET] [-csv]\n");
+      return 1;
+    }
+  }
+
+#if !S3L_PROFILE
+  if (traceFile != 0)
+  {
+    fprintf(stderr,"-t needs a build with S3L_PROFILE\n");
+    return 1;
+  }
+#endif
+
+#if !S3L_DYNAMIC_RESOLUTION
+  if (budget != 0)
+  {
+    fprintf(stderr,"-b needs a build with S3L_DYNAMIC_RESOLUTION\n");
+    return 1;
+  }
+#endif
+
+  if (frames < 1)
+    frames = 1;
+
+  double *times = (double *) malloc(frames * sizeof(double));
+
+  if (times == 0)
+    return 1;
+
+  hostScenesInit();
+
+  if (pathFile != 0 && !hostLoadPath(pathFile))
+  {
+    fprintf(stderr,"can't load path from %s\n",pathFile);
+    return 1;
+  }
+
+  if (csv)
+    printf("z_buffer,sort,perspective_correction,near_cross_strategy,scene,"
+      "frames,p50_us,p90_us,p99_us,max_us,tris_per_frame,mtris_per_s,"
+      "mpixels_per_s\n");
+  else
+    printf("# Z_BUFFER %d, SORT %d, PERSPECTIVE_CORRECTION %d, "
+      "NEAR_CROSS_STRATEGY %d, %dx%d\n"
+      "%-16s %6s %8s %8s %8s %8s %10s %8s %8s\n",
+      S3L_Z_BUFFER,S3L_SORT,S3L_PERSPECTIVE_CORRECTION,
+      S3L_NEAR_CROSS_STRATEGY,S3L_RESOLUTION_X,S3L_RESOLUTION_Y,
+      "scene","frames","p50 us","p90 us","p99 us","max us","tris/frame",
+      "Mtris/s","Mpix/s");
+
+  for (uint8_t s = 0; s < HOST_SCENE_COUNT; ++s)
+  {
+    const HostScene *benchScene = &hostScenes[s];
+
+    if (sceneName != 0 && strcmp(sceneName,benchScene->name) != 0)
+      continue;
+
+    benchScene->setup();
+
+#if S3L_DYNAMIC_RESOLUTION
+    S3L_initResolutionController(&resolution,budget);
+#endif
+
+    for (int frame = 0; frame < warmUp; ++frame)
+    {
+      hostSceneFrame(benchScene,frame);
+
+#if S3L_DYNAMIC_RESOLUTION
+      double start = now();
+      render();
+
+      if (budget != 0)
+        S3L_updateResolution(&resolution,now() - start);
+#else
+      render();
+#endif
+    }
+
+    double total = 0;
+
+    benchTriangles = 0;
+    benchPixels = 0;
+
+#if S3L_STATS
+    S3L_Stats empty = { 0 };
+    statsSum = empty;
+#endif
+
+#if S3L_PROFILE
+    S3L_profileReset();
+
+    for (uint8_t i = 0; i < S3L_ZONE_COUNT; ++i)
+      zoneSum[i] = 0;
+#endif
+
+#if S3L_DYNAMIC_RESOLUTION
+    pixelSum = 0;
+    resolutionChanges = 0;
+#endif
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+      hostSceneFrame(benchScene,frame);
+
+      double start = now();
+      render();
+      times[frame] = now() - start;
+      total += times[frame];
+
+#if S3L_DYNAMIC_RESOLUTION
+      pixelSum += S3L_RESOLUTION_X * S3L_RESOLUTION_Y;
+
+      if (budget != 0)
+        resolutionChanges += S3L_updateResolution(&resolution,times[frame]);
+#endif
+
+#if S3L_STATS
+      addStats();
+#endif
+
+#if S3L_PROFILE
+      S3L_profileEndFrame();
+      addProfile();
+
+      if (traceFile != 0 && S3L_hostTraceFrame() != S3L_HOST_OK)
+      {
+        fprintf(stderr,"out of memory for the trace\n");
+        return 1;
+      }
+#endif
+    }
+
+    qsort(times,frames,sizeof(double),compareTimes);
+
+    double p50 = percentile(times,frames,50), p90 = percentile(times,frames,90),
+      p99 = percentile(times,frames,99), trisPerFrame =
+      ((double) benchTriangles) / frames;
+
+    if (csv)
+      printf("%d,%d,%d,%d,%s,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f,%.3f\n",
+        S3L_Z_BUFFER,S3L_SORT,S3L_PERSPECTIVE_CORRECTION,
+        S3L_NEAR_CROSS_STRATEGY,benchScene->name,frames,p50,p90,p99,
+        times[frames - 1],trisPerFrame,benchTriangles / total,
+        benchPixels / total);
+    else
+      printf("%-16s %6d %8.1f %8.1f %8.1f %8.1f %10.1f %8.3f %8.3f\n",
+        benchScene->name,frames,p50,p90,p99,times[frames - 1],trisPerFrame,
+        benchTriangles / total,benchPixels / total);
+
+#if S3L_STATS
+    if (!csv)
+      printStats(frames);
+
+    if (!checkStats(benchScene->name))
+      return 1;
+#endif
+
+#if S3L_PROFILE
+    if (!csv)
+      printProfile(frames);
+#endif
+
+#if S3L_DYNAMIC_RESOLUTION
+    if (!csv && budget != 0)
+      printResolution(budget,frames);
+#endif
+  }
+
+#if S3L_PROFILE
+  if (traceFile != 0 && S3L_hostWriteTrace(traceFile) != S3L_HOST_OK)
+  {
+    fprintf(stderr,"can't write %s\n",traceFile);
+    return 1;
+  }
+#endif
+
+  free(times);
+
+  return 0;
+}
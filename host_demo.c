@@ -0,0 +1,103 @@
+/*
+  Headless version of the demo for the host build: renders the city scene
+  with the camera circling around the car at its start position, optionally
+  writing the frames as images. Meant for profiling, e.g.:
+
+    perf record ./s3l_headless -f 1000
+    valgrind --tool=callgrind ./s3l_headless -f 50
+
+  usage: s3l_headless [-f FRAMES] [-o PREFIX] [-ppm]
+    -f FRAMES  number of frames to render (default 100)
+    -o PREFIX  write each frame to PREFIX0000.png, PREFIX0001.png, ...
+    -ppm       write PPM instead of PNG
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "small3dlib.h"
+#include "texture_model.h"
+#include "S3L_host.h"
+
+S3L_Model3D models[2];
+S3L_ModelMaterials modelMaterials[2]; // indexed like models
+S3L_Scene scene;
+
+int main(int argc, char **argv)
+{
+  int frames = 100, ppm = 0;
+  const char *prefix = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i],"-f") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-o") == 0 && i + 1 < argc)
+      prefix = argv[++i];
+    else if (strcmp(argv[i],"-ppm") == 0)
+      ppm = 1;
+    else
+    {
+      fprintf(stderr,"usage: s3l_headless [-f FRAMES] [-o PREFIX] [-ppm]\n");
+      return 1;
+    }
+  }
+
+  S3L_hostInit();
+
+  // the same scene as in the demo
+  cityMaterialsInit();
+  cityModelInit();
+  carModelInit();
+  modelMaterials[0] = cityModelMaterials;
+  modelMaterials[1] = carModelMaterials;
+  S3L_SetMaterials(cityMaterials,modelMaterials);
+  models[0] = cityModel;
+  models[1] = carModel;
+  S3L_initScene(models,2,&scene);
+
+  S3L_setTransform3D(1909,16,-3317,0,-510,0,512,512,512,&(models[1].transform));
+
+  scene.camera.transform.translation.y = S3L_FRACTIONS_PER_UNIT / 2;
+  scene.camera.transform.rotation.x = -S3L_FRACTIONS_PER_UNIT / 16;
+
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    S3L_Vec4 forward;
+
+    // one turn in 256 frames, looking at the car from behind like the demo
+    scene.camera.transform.rotation.y =
+      (frame * S3L_FRACTIONS_PER_UNIT / 256) % S3L_FRACTIONS_PER_UNIT;
+
+    S3L_rotationToDirections(scene.camera.transform.rotation,
+      S3L_FRACTIONS_PER_UNIT,&forward,0,0);
+
+    scene.camera.transform.translation.x = models[1].transform.translation.x -
+      (forward.x * 3) / 4;
+    scene.camera.transform.translation.z = models[1].transform.translation.z -
+      (forward.z * 3) / 4;
+
+    S3L_hostClear(S3L_color(0,0,9,15));
+    S3L_newFrame();
+    S3L_drawScene(scene);
+    S3L_resolveVisibilityBuffer(scene);
+
+    if (prefix != 0)
+    {
+      char fileName[1024];
+
+      snprintf(fileName,sizeof(fileName),"%s%04d.%s",prefix,frame,
+        ppm ? "ppm" : "png");
+
+      if ((ppm ? S3L_hostWritePPM(fileName,S3L_hostFramebuffer) :
+        S3L_hostWritePNG(fileName,S3L_hostFramebuffer)) != S3L_HOST_OK)
+      {
+        fprintf(stderr,"can't write %s\n",fileName);
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
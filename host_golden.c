@@ -0,0 +1,190 @@
+/*
+  Golden image test for the host build: renders a fixed frame of each scene
+  of host_scenes.h and compares it to a stored reference image, so that
+  changes of the rasterization (fill rules, interpolation, fast paths, ...)
+  can be proven not to change the output. Like with the benchmark, each
+  tested combination of the S3L_* options is a separate s3l_golden_NAME with
+  references in golden/NAME (see CMakeLists.txt), check all of them with:
+
+    cmake --build build --target golden
+
+  and after an intended change of the output, rewrite the references with
+  the golden_update target (and look at them before committing).
+
+  Colors are compared per 4 bit channel. A pixel differs if a channel
+  differs by more than the tolerance, an image fails if more pixels than
+  allowed differ. Failing images are reported with the number of differing
+  pixels, the biggest channel difference and the differing area, and a diff
+  image is written next to the actual render: differing pixels red, pixels
+  within the tolerance yellow and the rest the darkened reference.
+
+  usage: s3l_golden -d DIR [-u] [-t LEVELS] [-n PIXELS] [-o PREFIX]
+    -d DIR     directory of the references, SCENE.ppm for each scene
+    -u         write the references instead of comparing
+    -t LEVELS  channel difference still considered equal (default 0)
+    -n PIXELS  number of differing pixels still considered equal (default 0)
+    -o PREFIX  write renders and diffs of failing scenes to PREFIXSCENE.ppm
+               and PREFIXSCENE_diff.ppm (default: no files)
+
+  Returns the number of failing scenes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "small3dlib.h"
+#include "host_scenes.h"
+#include "S3L_host.h"
+
+#define GOLDEN_FRAME 100 ///< frame of each scene that's compared
+
+#define PIXELS (S3L_RESOLUTION_X * S3L_RESOLUTION_Y)
+
+static uint16_t reference[S3L_MAX_PIXELS];
+static uint16_t diff[S3L_MAX_PIXELS];
+
+static uint8_t channelDifference(uint16_t a, uint16_t b)
+{
+  uint8_t result = 0;
+  int8_t d;
+
+  d = S3L_colorR(a) - S3L_colorR(b);
+  result = S3L_max(result,S3L_abs(d));
+  d = S3L_colorG(a) - S3L_colorG(b);
+  result = S3L_max(result,S3L_abs(d));
+  d = S3L_colorB(a) - S3L_colorB(b);
+  result = S3L_max(result,S3L_abs(d));
+
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  int tolerance = 0, allowedPixels = 0, update = 0, failed = 0, usage = 0;
+  const char *directory = 0, *prefix = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i],"-d") == 0 && i + 1 < argc)
+      directory = argv[++i];
+    else if (strcmp(argv[i],"-u") == 0)
+      update = 1;
+    else if (strcmp(argv[i],"-t") == 0 && i + 1 < argc)
+      tolerance = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-n") == 0 && i + 1 < argc)
+      allowedPixels = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-o") == 0 && i + 1 < argc)
+      prefix = argv[++i];
+    else
+      usage = 1;
+  }
+
+  if (usage || directory == 0)
+  {
+    fprintf(stderr,"usage: s3l_golden -d DIR [-u] [-t LEVELS] [-n PIXELS] "
+      "[-o PREFIX]\n");
+    return 1;
+  }
+
+  hostScenesInit();
+
+  for (uint8_t s = 0; s < HOST_SCENE_COUNT; ++s)
+  {
+    const HostScene *goldenScene = &hostScenes[s];
+    char fileName[1024];
+
+    goldenScene->setup();
+    hostSceneFrame(goldenScene,GOLDEN_FRAME);
+    S3L_newFrame();
+    S3L_drawScene(hostScene);
+    S3L_resolveVisibilityBuffer(hostScene);
+
+    snprintf(fileName,sizeof(fileName),"%s/%s.ppm",directory,
+      goldenScene->name);
+
+    if (update)
+    {
+      if (S3L_hostWritePPM(fileName,S3L_hostFramebuffer) != S3L_HOST_OK)
+      {
+        fprintf(stderr,"can't write %s\n",fileName);
+        return 1;
+      }
+
+      printf("%-16s written to %s\n",goldenScene->name,fileName);
+      continue;
+    }
+
+    int8_t error = S3L_hostReadPPM(fileName,reference);
+
+    if (error != S3L_HOST_OK)
+    {
+      printf("%-16s FAILED, can't read %s%s\n",goldenScene->name,fileName,
+        error == S3L_HOST_ERROR_FORMAT ? " (not a PPM of this resolution)" :
+        "");
+
+      failed++;
+      continue;
+    }
+
+    int differing = 0, maxDifference = 0;
+    int x0 = S3L_RESOLUTION_X, y0 = S3L_RESOLUTION_Y, x1 = -1, y1 = -1;
+
+    for (int i = 0; i < PIXELS; ++i)
+    {
+      uint16_t r = reference[i];
+      int d = channelDifference(S3L_hostFramebuffer[i],r);
+
+      if (d > maxDifference)
+        maxDifference = d;
+
+      if (d > tolerance)
+      {
+        int x = i % S3L_RESOLUTION_X, y = i / S3L_RESOLUTION_X;
+
+        differing++;
+        x0 = S3L_min(x0,x);
+        y0 = S3L_min(y0,y);
+        x1 = S3L_max(x1,x);
+        y1 = S3L_max(y1,y);
+
+        diff[i] = S3L_color(15,0,0,15);
+      }
+      else
+        diff[i] = d != 0 ? S3L_color(15,15,0,15) :
+          S3L_color(S3L_colorR(r) / 4,S3L_colorG(r) / 4,S3L_colorB(r) / 4,15);
+    }
+
+    if (differing <= allowedPixels)
+    {
+      if (maxDifference == 0)
+        printf("%-16s OK\n",goldenScene->name);
+      else
+        printf("%-16s OK within tolerance, max %d levels, %d pixels over\n",
+          goldenScene->name,maxDifference,differing);
+
+      continue;
+    }
+
+    failed++;
+
+    printf("%-16s FAILED, %d pixels differ (max %d levels) in [%d,%d]-[%d,%d]"
+      "\n",goldenScene->name,differing,maxDifference,x0,y0,x1,y1);
+
+    if (prefix != 0)
+    {
+      snprintf(fileName,sizeof(fileName),"%s%s.ppm",prefix,goldenScene->name);
+
+      if (S3L_hostWritePPM(fileName,S3L_hostFramebuffer) == S3L_HOST_OK)
+        printf("%-16s render written to %s\n","",fileName);
+
+      snprintf(fileName,sizeof(fileName),"%s%s_diff.ppm",prefix,
+        goldenScene->name);
+
+      if (S3L_hostWritePPM(fileName,diff) == S3L_HOST_OK)
+        printf("%-16s diff written to %s\n","",fileName);
+    }
+  }
+
+  return failed;
+}
@@ -0,0 +1,412 @@
+/*
+  Microbenchmark of the library's fixed point math for the host build: time
+  per call of the trigonometric, square root and vector functions on fixed
+  pseudo random inputs, and their error against the C library in double
+  precision (in S3L_Units, i.e. 1/S3L_FRACTIONS_PER_UNIT, for vectors the
+  biggest component error). The errors are measured over all inputs where
+  that's cheap (all angles, all sines), otherwise over samples. Part of the
+  benchmark target, or run alone:
+
+    cmake --build build --target s3l_mathbench && build/s3l_mathbench
+
+  The bit by bit square root the library used before is timed too, for
+  comparison.
+
+  Then the reciprocal division (S3L_RECIPROCAL_DIVISION) is checked against
+  the C division on edge case operands (divisors 0, 1, around powers of two,
+  dividends near +-2^31) and random pairs, any mismatch is printed and makes
+  the exit status non-zero. The library is compiled into this file to reach
+  its static division functions.
+
+  usage: s3l_mathbench [-r ROUNDS] [-csv]
+    -r ROUNDS  times each function runs over the inputs (default 2000)
+    -csv       print CSV instead of a table
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "small3dlib.c"
+
+#if !S3L_RECIPROCAL_DIVISION || defined(S3L_DIVIDE_FUNCTION)
+  #error s3l_mathbench checks the reciprocal division, build it with\
+         S3L_RECIPROCAL_DIVISION and without S3L_DIVIDE_FUNCTION.
+#endif
+
+#define INPUTS 4096
+#define SAMPLES 1000000
+#define PI 3.14159265358979
+#define F ((double) S3L_FRACTIONS_PER_UNIT)
+
+static S3L_Unit angles[INPUTS];   // any angle
+static S3L_Unit sines[INPUTS];    // -F to F
+static S3L_Unit squares[INPUTS];  // 0 to 2^31 - 1
+static S3L_Vec4 vectors[INPUTS];  // components below 2^14, any direction
+
+static volatile S3L_Unit sink; // keeps the calls from being optimized out
+
+static uint32_t randomState = 1;
+
+static uint32_t randomNumber(void)
+{
+  randomState = randomState * 1103515245 + 12345;
+  return randomState >> 1;
+}
+
+static S3L_Unit randomComponent(void)
+{
+  // magnitudes spread over all bit lengths, as vectors in the scenes are
+  S3L_Unit c = randomNumber() % (2 << (randomNumber() % 13));
+  return randomNumber() % 2 ? c : -1 * c;
+}
+
+static S3L_Vec4 randomVector(void)
+{
+  S3L_Vec4 v;
+
+  do
+    S3L_setVec4(&v,randomComponent(),randomComponent(),randomComponent(),0);
+  while (v.x == 0 && v.y == 0 && v.z == 0);
+
+  return v;
+}
+
+static double now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC,&t);
+
+  return t.tv_sec * 1000000000.0 + t.tv_nsec;
+}
+
+static S3L_Unit bitwiseSqrt(S3L_Unit value) // previous S3L_sqrt
+{
+  uint32_t result = 0, a = value, b = 1u << 30;
+
+  while (b > a)
+    b >>= 2;
+
+  while (b != 0)
+  {
+    if (a >= result + b)
+    {
+      a -= result + b;
+      result = result + 2 * b;
+    }
+
+    b >>= 2;
+    result >>= 1;
+  }
+
+  return result;
+}
+
+static void runSin(void)
+{
+  for (int i = 0; i < INPUTS; ++i)
+    sink = S3L_sin(angles[i]);
+}
+
+static void runCos(void)
+{
+  for (int i = 0; i < INPUTS; ++i)
+    sink = S3L_cos(angles[i]);
+}
+
+static void runAsin(void)
+{
+  for (int i = 0; i < INPUTS; ++i)
+    sink = S3L_asin(sines[i]);
+}
+
+static void runSqrt(void)
+{
+  for (int i = 0; i < INPUTS; ++i)
+    sink = S3L_sqrt(squares[i]);
+}
+
+static void runBitwiseSqrt(void)
+{
+  for (int i = 0; i < INPUTS; ++i)
+    sink = bitwiseSqrt(squares[i]);
+}
+
+static void runVec3Length(void)
+{
+  for (int i = 0; i < INPUTS; ++i)
+    sink = S3L_vec3Length(vectors[i]);
+}
+
+static void runNormalizeFast(void)
+{
+  for (int i = 0; i < INPUTS; ++i)
+  {
+    S3L_Vec4 v = vectors[i];
+    S3L_normalizeVec3Fast(&v);
+    sink = v.x;
+  }
+}
+
+static void runNormalize(void)
+{
+  for (int i = 0; i < INPUTS; ++i)
+  {
+    S3L_Vec4 v = vectors[i];
+    S3L_normalizeVec3(&v);
+    sink = v.x;
+  }
+}
+
+static double maxError, errorSum;
+static long errorCount;
+
+static void addError(double result, double exact)
+{
+  double e = fabs(result - exact);
+
+  if (e > maxError)
+    maxError = e;
+
+  errorSum += e;
+  errorCount++;
+}
+
+static void errorSin(void)
+{
+  for (S3L_Unit x = 0; x < S3L_FRACTIONS_PER_UNIT; ++x)
+    addError(S3L_sin(x),sin(2 * PI * x / F) * F);
+}
+
+static void errorCos(void)
+{
+  for (S3L_Unit x = 0; x < S3L_FRACTIONS_PER_UNIT; ++x)
+    addError(S3L_cos(x),cos(2 * PI * x / F) * F);
+}
+
+static void errorAsin(void)
+{
+  for (S3L_Unit x = -S3L_FRACTIONS_PER_UNIT; x <= S3L_FRACTIONS_PER_UNIT;
+    ++x)
+    addError(S3L_asin(x),asin(x / F) / (2 * PI) * F);
+}
+
+static void errorSqrt(void)
+{
+  for (long i = 0; i < SAMPLES; ++i)
+  {
+    S3L_Unit x = i < SAMPLES / 2 ? i : (S3L_Unit) randomNumber();
+    addError(S3L_sqrt(x),sqrt(x));
+  }
+}
+
+static void errorVec3Length(void)
+{
+  for (long i = 0; i < SAMPLES; ++i)
+  {
+    S3L_Vec4 v = randomVector();
+    addError(S3L_vec3Length(v),sqrt(((double) v.x) * v.x +
+      ((double) v.y) * v.y + ((double) v.z) * v.z));
+  }
+}
+
+static void errorNormalize(void (*normalize)(S3L_Vec4 *))
+{
+  for (long i = 0; i < SAMPLES; ++i)
+  {
+    S3L_Vec4 v = randomVector(), n = v;
+    double l = sqrt(((double) v.x) * v.x + ((double) v.y) * v.y +
+      ((double) v.z) * v.z);
+
+    normalize(&n);
+
+    double e[3] = { fabs(n.x - v.x / l * F), fabs(n.y - v.y / l * F),
+      fabs(n.z - v.z / l * F) };
+
+    addError(0,e[0] > e[1] ? (e[0] > e[2] ? e[0] : e[2]) :
+      (e[1] > e[2] ? e[1] : e[2]));
+  }
+}
+
+static void errorNormalizeFast(void)
+{
+  errorNormalize(S3L_normalizeVec3Fast);
+}
+
+static void errorNormalizeAccurate(void)
+{
+  errorNormalize(S3L_normalizeVec3);
+}
+
+static long divisionMismatches;
+
+static void checkDivision(S3L_Unit n, S3L_Unit d)
+{
+  S3L_Unit result =
+    _S3L_divideByReciprocal(n,d,_S3L_reciprocal(d != 0 ? S3L_abs(d) : 1));
+  S3L_Unit exact = n / (d != 0 ? d : 1); // zero d is treated as 1
+
+  if (result != exact)
+  {
+    if (divisionMismatches < 10)
+      fprintf(stderr,"reciprocal division: %d / %d = %d, should be %d\n",
+        n,d,result,exact);
+
+    divisionMismatches++;
+  }
+}
+
+/* Returns the number of checked operand pairs. Dividends are above -2^31 and
+   divisors above -2^31 and nonzero except for 0 itself, as their magnitudes
+   (and the quotient of -2^31 / -1) overflow S3L_Unit. */
+static long checkDivisions(void)
+{
+  S3L_Unit edges[2 * (3 + 3 * 30)];
+  int edgeCount = 0;
+  long count = 0;
+
+  edges[edgeCount++] = 0;
+  edges[edgeCount++] = 0x7fffffff;
+  edges[edgeCount++] = 0x7ffffffe;
+
+  for (int k = 1; k < 31; ++k) // 1 is 2^1 - 1
+  {
+    edges[edgeCount++] = (1 << k) - 1;
+    edges[edgeCount++] = 1 << k;
+    edges[edgeCount++] = (1 << k) + 1;
+  }
+
+  for (int i = edgeCount - 1; i > 0; --i) // add the negative ones
+    edges[edgeCount++] = -1 * edges[i];
+
+  for (int i = 0; i < edgeCount; ++i)
+    for (int j = 0; j < edgeCount; ++j)
+    {
+      checkDivision(edges[i],edges[j]);
+      count++;
+    }
+
+  for (long i = 0; i < SAMPLES; ++i)
+  {
+    // magnitudes spread over all bit lengths, for both operands
+    S3L_Unit n = randomNumber() >> (randomNumber() % 31);
+    S3L_Unit d = randomNumber() >> (randomNumber() % 31);
+
+    checkDivision(randomNumber() % 2 ? n : -1 * n,
+      randomNumber() % 2 ? d : -1 * d);
+
+    count++;
+  }
+
+  return count;
+}
+
+typedef struct
+{
+  const char *name;
+  void (*run)(void);
+  void (*error)(void); // 0 if not measured
+} MathBench;
+
+static const MathBench benches[] =
+{
+  {"S3L_sin", runSin, errorSin},
+  {"S3L_cos", runCos, errorCos},
+  {"S3L_asin", runAsin, errorAsin},
+  {"S3L_sqrt", runSqrt, errorSqrt},
+  {"bitwise sqrt", runBitwiseSqrt, 0},
+  {"S3L_vec3Length", runVec3Length, errorVec3Length},
+  {"S3L_normalizeVec3Fast", runNormalizeFast, errorNormalizeFast},
+  {"S3L_normalizeVec3", runNormalize, errorNormalizeAccurate}
+};
+
+#define BENCH_COUNT ((int) (sizeof(benches) / sizeof(MathBench)))
+
+int main(int argc, char **argv)
+{
+  int rounds = 2000, csv = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i],"-r") == 0 && i + 1 < argc)
+      rounds = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-csv") == 0)
+      csv = 1;
+    else
+    {
+      fprintf(stderr,"usage: s3l_mathbench [-r ROUNDS] [-csv]\n");
+      return 1;
+    }
+  }
+
+  if (rounds < 1)
+    rounds = 1;
+
+  for (int i = 0; i < INPUTS; ++i)
+  {
+    angles[i] = (S3L_Unit) (randomNumber() % (8 * S3L_FRACTIONS_PER_UNIT)) -
+      4 * S3L_FRACTIONS_PER_UNIT;
+    sines[i] = (S3L_Unit) (randomNumber() % (2 * S3L_FRACTIONS_PER_UNIT + 1))
+      - S3L_FRACTIONS_PER_UNIT;
+    squares[i] = randomNumber() >> (randomNumber() % 31);
+    vectors[i] = randomVector();
+  }
+
+  if (csv)
+    printf("function,ns_per_call,max_error,mean_error\n");
+  else
+    printf("# S3L_FRACTIONS_PER_UNIT %d, errors in units\n"
+      "%-22s %10s %10s %10s\n",S3L_FRACTIONS_PER_UNIT,"function","ns/call",
+      "max error","mean error");
+
+  for (int b = 0; b < BENCH_COUNT; ++b)
+  {
+    const MathBench *bench = benches + b;
+
+    bench->run(); // warm up
+
+    double start = now();
+
+    for (int r = 0; r < rounds; ++r)
+      bench->run();
+
+    double time = (now() - start) / (((double) rounds) * INPUTS);
+
+    maxError = 0;
+    errorSum = 0;
+    errorCount = 0;
+
+    if (bench->error != 0)
+      bench->error();
+
+    if (csv)
+    {
+      if (bench->error != 0)
+        printf("%s,%.3f,%.3f,%.4f\n",bench->name,time,maxError,
+          errorSum / errorCount);
+      else
+        printf("%s,%.3f,,\n",bench->name,time);
+    }
+    else
+    {
+      if (bench->error != 0)
+        printf("%-22s %10.2f %10.3f %10.4f\n",bench->name,time,maxError,
+          errorSum / errorCount);
+      else
+        printf("%-22s %10.2f %10s %10s\n",bench->name,time,"-","-");
+    }
+  }
+
+  long divisions = checkDivisions();
+
+  if (!csv)
+    printf("reciprocal division: %ld operand pairs, %ld mismatches\n",
+      divisions,divisionMismatches);
+
+  return divisionMismatches != 0;
+}
@@ -0,0 +1,175 @@
+/*
+  Overdraw tool for the host build, needs S3L_OVERDRAW: renders the scenes of
+  host_scenes.h and reports per pixel counts of S3L_overdraw, i.e. how much
+  work the rasterizer and the pixel function do per pixel that ends up on
+  the screen. As with the benchmark each tested combination of the S3L_*
+  options (sorting, z-buffer, visibility buffer, ...) is a separate
+  s3l_overdraw_NAME (see CMakeLists.txt), run all of them with:
+
+    cmake --build build --target overdraw
+
+  The metrics are summed over the frames of the scene's script:
+
+    coverage   covered pixels (with at least one fragment), % of the screen
+    depth      depth complexity, fragments per covered pixel
+    pass %     fragments that passed the z-buffer and stencil tests
+    overdraw   shaded fragments per covered pixel, 1.0 means each pixel was
+               shaded once, more is wasted work on hidden surfaces
+    max        the most fragments and shades of any pixel of any frame
+
+  Heatmaps of one frame (see S3L_hostHeatmap for the colors) are written
+  with -o as PREFIXSCENE.png (the image), PREFIXSCENE_fragments.png,
+  PREFIXSCENE_passed.png and PREFIXSCENE_shaded.png.
+
+  usage: s3l_overdraw [-f FRAMES] [-i FRAME] [-s SCENE] [-o PREFIX] [-csv]
+    -f FRAMES  frames per scene for the metrics (default 256)
+    -i FRAME   frame of the heatmaps (default 100)
+    -s SCENE   run only the scene of given name
+    -o PREFIX  write the heatmaps
+    -csv       print CSV instead of a table
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "small3dlib.h"
+#include "host_scenes.h"
+#include "S3L_host.h"
+
+#if !S3L_OVERDRAW
+  #error The overdraw tool needs S3L_OVERDRAW.
+#endif
+
+#define PIXELS (S3L_RESOLUTION_X * S3L_RESOLUTION_Y)
+
+static uint16_t heatmap[S3L_MAX_PIXELS];
+
+static void render(const HostScene *scene, int frame)
+{
+  hostSceneFrame(scene,frame);
+  S3L_newFrame();
+  S3L_drawScene(hostScene);
+  S3L_resolveVisibilityBuffer(hostScene);
+}
+
+static int writeHeatmap(const char *prefix, const char *sceneName,
+  const char *counter, const uint8_t *counts)
+{
+  char fileName[1024];
+
+  snprintf(fileName,sizeof(fileName),"%s%s%s%s.png",prefix,sceneName,
+    counter ? "_" : "",counter ? counter : "");
+
+  if (counts != 0)
+    S3L_hostHeatmap(counts,heatmap);
+
+  if (S3L_hostWritePNG(fileName,counts != 0 ? heatmap : S3L_hostFramebuffer)
+    != S3L_HOST_OK)
+  {
+    fprintf(stderr,"can't write %s\n",fileName);
+    return 0;
+  }
+
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  int frames = 256, imageFrame = 100, csv = 0;
+  const char *sceneName = 0, *prefix = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i],"-f") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-i") == 0 && i + 1 < argc)
+      imageFrame = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-s") == 0 && i + 1 < argc)
+      sceneName = argv[++i];
+    else if (strcmp(argv[i],"-o") == 0 && i + 1 < argc)
+      prefix = argv[++i];
+    else if (strcmp(argv[i],"-csv") == 0)
+      csv = 1;
+    else
+    {
+      fprintf(stderr,"usage: s3l_overdraw [-f FRAMES] [-i FRAME] [-s SCENE] "
+        "[-o PREFIX] [-csv]\n");
+      return 1;
+    }
+  }
+
+  if (frames < 1)
+    frames = 1;
+
+  S3L_hostInit();
+  hostScenesInit();
+
+  if (csv)
+    printf("z_buffer,sort,visibility_buffer,scene,frames,coverage,depth,"
+      "pass_ratio,overdraw,max_fragments,max_shaded\n");
+  else
+    printf("# Z_BUFFER %d, SORT %d, VISIBILITY_BUFFER %d, %dx%d\n"
+      "%-16s %6s %9s %7s %7s %9s %6s %6s\n",
+      S3L_Z_BUFFER,S3L_SORT,S3L_VISIBILITY_BUFFER,S3L_RESOLUTION_X,
+      S3L_RESOLUTION_Y,"scene","frames","coverage","depth","pass %",
+      "overdraw","max f","max s");
+
+  for (uint8_t s = 0; s < HOST_SCENE_COUNT; ++s)
+  {
+    const HostScene *overdrawScene = &hostScenes[s];
+
+    if (sceneName != 0 && strcmp(sceneName,overdrawScene->name) != 0)
+      continue;
+
+    overdrawScene->setup();
+
+    uint64_t covered = 0, fragments = 0, passed = 0, shaded = 0;
+    int maxFragments = 0, maxShaded = 0;
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+      render(overdrawScene,frame);
+
+      for (int i = 0; i < PIXELS; ++i)
+      {
+        covered += S3L_overdraw.fragments[i] != 0;
+        fragments += S3L_overdraw.fragments[i];
+        passed += S3L_overdraw.passed[i];
+        shaded += S3L_overdraw.shaded[i];
+        maxFragments = S3L_max(maxFragments,S3L_overdraw.fragments[i]);
+        maxShaded = S3L_max(maxShaded,S3L_overdraw.shaded[i]);
+      }
+    }
+
+    double coverage = (100.0 * covered) / (((uint64_t) PIXELS) * frames),
+      depth = covered ? ((double) fragments) / covered : 0,
+      passRatio = fragments ? (100.0 * passed) / fragments : 0,
+      overdraw = covered ? ((double) shaded) / covered : 0;
+
+    if (csv)
+      printf("%d,%d,%d,%s,%d,%.2f,%.3f,%.2f,%.3f,%d,%d\n",S3L_Z_BUFFER,
+        S3L_SORT,S3L_VISIBILITY_BUFFER,overdrawScene->name,frames,coverage,
+        depth,passRatio,overdraw,maxFragments,maxShaded);
+    else
+      printf("%-16s %6d %8.1f%% %7.2f %6.1f%% %9.2f %6d %6d\n",
+        overdrawScene->name,frames,coverage,depth,passRatio,overdraw,
+        maxFragments,maxShaded);
+
+    if (prefix != 0)
+    {
+      render(overdrawScene,imageFrame);
+
+      if (!writeHeatmap(prefix,overdrawScene->name,0,0) ||
+        !writeHeatmap(prefix,overdrawScene->name,"fragments",
+          S3L_overdraw.fragments) ||
+        !writeHeatmap(prefix,overdrawScene->name,"passed",
+          S3L_overdraw.passed) ||
+        !writeHeatmap(prefix,overdrawScene->name,"shaded",
+          S3L_overdraw.shaded))
+        return 1;
+    }
+  }
+
+  return 0;
+}
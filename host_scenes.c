@@ -0,0 +1,399 @@
+/*
+  Scripted scenes of the host build shared by the benchmark and the golden
+  image test: a car driving a loop through the city followed by the camera
+  like in the demo, an overview of the city and synthetic stress scenes
+  (many models, huge triangles, overdraw). Each frame depends only on its
+  number, so any frame can be rendered alone and the results are repeatable.
+*/
+
+#include <stdio.h>
+#include <math.h>
+
+#include "host_scenes.h"
+#include "texture_model.h"
+#include "S3L_host.h"
+#include "S3L_mesh.h"
+
+#define MAX_MODELS 64
+#define MAX_PATH_POINTS 1024
+
+#define CAR_SPEED (S3L_FRACTIONS_PER_UNIT / 32) ///< per frame, along the path
+
+static S3L_Model3D models[MAX_MODELS];
+static S3L_ModelMaterials modelMaterials[MAX_MODELS]; // indexed like models
+S3L_Scene hostScene;
+
+// a unit square in the XZ plane, textured with the whole city texture
+
+static const S3L_Unit quadVertices[] =
+{
+  -S3L_FRACTIONS_PER_UNIT / 2, 0, -S3L_FRACTIONS_PER_UNIT / 2,
+   S3L_FRACTIONS_PER_UNIT / 2, 0, -S3L_FRACTIONS_PER_UNIT / 2,
+   S3L_FRACTIONS_PER_UNIT / 2, 0,  S3L_FRACTIONS_PER_UNIT / 2,
+  -S3L_FRACTIONS_PER_UNIT / 2, 0,  S3L_FRACTIONS_PER_UNIT / 2
+};
+
+static const S3L_Index quadTriangles[] = { 0, 1, 2,  0, 2, 3 };
+
+static const S3L_Unit quadUVs[] =
+{
+  0,                      0,
+  S3L_FRACTIONS_PER_UNIT, 0,
+  S3L_FRACTIONS_PER_UNIT, S3L_FRACTIONS_PER_UNIT,
+  0,                      S3L_FRACTIONS_PER_UNIT
+};
+
+static const S3L_AttributeStream quadAttributes[] = { { quadUVs, 0, 2 } };
+
+static const S3L_MaterialRange quadMaterialRanges[] = { { 0, 0 } };
+
+static const S3L_ModelMaterials quadModelMaterials =
+  { quadMaterialRanges, 1 };
+
+// car path, a loop through the city streets (in map squares, see demo.cpp)
+
+static const int8_t scriptedPath[] =
+{
+  7, 13,  7, 7,  13, 7,  13, 3,  9, 3,  9, 7,  7, 7,  7, 11,  3, 11,
+  3, 15,  7, 15
+};
+
+static S3L_Unit path[MAX_PATH_POINTS * 2];
+static double pathDistance[MAX_PATH_POINTS + 1]; // from the start, closed
+static uint16_t pathLength;
+
+static void setPath(const S3L_Unit *points, uint16_t count)
+{
+  pathLength = count;
+  pathDistance[0] = 0;
+
+  for (uint16_t i = 0; i < count; ++i)
+  {
+    uint16_t next = (i + 1) % count;
+
+    path[2 * i] = points[2 * i];
+    path[2 * i + 1] = points[2 * i + 1];
+
+    pathDistance[i + 1] = pathDistance[i] + hypot(
+      points[2 * next] - points[2 * i],
+      points[2 * next + 1] - points[2 * i + 1]);
+  }
+}
+
+int hostLoadPath(const char *fileName)
+{
+  FILE *f = fopen(fileName,"r");
+  S3L_Unit points[MAX_PATH_POINTS * 2];
+  uint16_t count = 0;
+  long x, z;
+
+  if (f == 0)
+    return 0;
+
+  while (count < MAX_PATH_POINTS && fscanf(f,"%ld %ld",&x,&z) == 2)
+  {
+    points[2 * count] = x;
+    points[2 * count + 1] = z;
+    count++;
+  }
+
+  fclose(f);
+
+  if (count < 2)
+    return 0;
+
+  setPath(points,count);
+  return 1;
+}
+
+static void pathPoint(double distance, double *x, double *z)
+{
+  distance = fmod(distance,pathDistance[pathLength]);
+
+  uint16_t i = 0;
+
+  while (pathDistance[i + 1] < distance)
+    i++;
+
+  uint16_t next = (i + 1) % pathLength;
+  double t = (distance - pathDistance[i]) /
+    (pathDistance[i + 1] - pathDistance[i]);
+
+  *x = path[2 * i] + t * (path[2 * next] - path[2 * i]);
+  *z = path[2 * i + 1] + t * (path[2 * next + 1] - path[2 * i + 1]);
+}
+
+/** Rotation around Y that makes S3L_rotationToDirections' forward point in
+  given direction. */
+static S3L_Unit yawTo(double dx, double dz)
+{
+  return lround(atan2(-dx,dz) * S3L_FRACTIONS_PER_UNIT /
+    (2 * 3.14159265358979));
+}
+
+#if S3L_LIGHTING
+// sun from above and a point light at the start of the path
+static const S3L_Light lights[] =
+{
+  { S3L_LIGHT_DIRECTIONAL, { -256, -416, 128, 0 }, S3L_FRACTIONS_PER_UNIT, 0 },
+  { S3L_LIGHT_POINT, { 1909, 256, -3317, 0 }, S3L_FRACTIONS_PER_UNIT,
+    4 * S3L_FRACTIONS_PER_UNIT }
+};
+
+// hard edged normals, so that Gouraud lighting differs from flat
+static S3L_Unit cityNormals[CITY_TRIANGLE_COUNT * 9];
+static S3L_Index cityNormalIndices[CITY_TRIANGLE_COUNT * 3];
+static S3L_Unit carNormals[CAR_TRIANGLE_COUNT * 9];
+static S3L_Index carNormalIndices[CAR_TRIANGLE_COUNT * 3];
+
+static void computeNormals(S3L_Model3D *model, S3L_Unit *normals,
+  S3L_Index *normalIndices)
+{
+  // the city is the biggest model
+  uint32_t start[CITY_VERTEX_COUNT + 1];
+  S3L_Index triangles[CITY_TRIANGLE_COUNT * 3];
+  S3L_VertexAdjacency adjacency = { start, triangles };
+
+  S3L_buildVertexAdjacency(model,&adjacency);
+  S3L_computeSplitNormals(model,&adjacency,S3L_NORMALS_ANGLE,
+    S3L_FRACTIONS_PER_UNIT / 2,normals,normalIndices);
+
+  model->normals = normals;
+  model->normalIndices = normalIndices;
+}
+#endif
+
+static void initScene(uint8_t modelCount)
+{
+  S3L_initScene(models,modelCount,&hostScene);
+
+#if S3L_LIGHTING
+  hostScene.lights = lights;
+  hostScene.lightCount = 2;
+  hostScene.ambientLight = S3L_FRACTIONS_PER_UNIT / 4;
+#endif
+}
+
+static void cityScene(uint8_t withCar)
+{
+  models[0] = cityModel;
+  models[1] = carModel;
+  modelMaterials[0] = cityModelMaterials;
+  modelMaterials[1] = carModelMaterials;
+  initScene(withCar ? 2 : 1);
+}
+
+// the car follows the path, the camera follows the car like in the demo
+
+static void cityDriveSetup(void)
+{
+  cityScene(1);
+  hostScene.camera.transform.translation.y = S3L_FRACTIONS_PER_UNIT / 2;
+  hostScene.camera.transform.rotation.x = -S3L_FRACTIONS_PER_UNIT / 16;
+}
+
+static void cityDriveFrame(int frame)
+{
+  double x, z, aheadX, aheadZ, distance = frame * CAR_SPEED;
+  S3L_Vec4 forward;
+
+  pathPoint(distance,&x,&z);
+
+  // looking a bit ahead smooths the turns
+  pathPoint(distance + S3L_FRACTIONS_PER_UNIT / 2,&aheadX,&aheadZ);
+
+  S3L_setTransform3D(lround(x),16,lround(z),0,yawTo(aheadX - x,aheadZ - z),
+    0,512,512,512,&(models[1].transform));
+
+  hostScene.camera.transform.rotation.y = models[1].transform.rotation.y;
+
+  S3L_rotationToDirections(hostScene.camera.transform.rotation,
+    S3L_FRACTIONS_PER_UNIT,&forward,0,0);
+
+  hostScene.camera.transform.translation.x = models[1].transform.translation.x -
+    (forward.x * 3) / 4;
+  hostScene.camera.transform.translation.z = models[1].transform.translation.z -
+    (forward.z * 3) / 4;
+}
+
+// the whole city from above, many small triangles
+
+static void cityOverviewSetup(void)
+{
+  cityScene(0);
+  hostScene.camera.transform.rotation.x = -S3L_FRACTIONS_PER_UNIT / 8;
+}
+
+static void cityOverviewFrame(int frame)
+{
+  S3L_Vec4 forward;
+
+  hostScene.camera.transform.rotation.y =
+    (frame * S3L_FRACTIONS_PER_UNIT / 512) % S3L_FRACTIONS_PER_UNIT;
+
+  S3L_rotationToDirections(hostScene.camera.transform.rotation,
+    S3L_FRACTIONS_PER_UNIT,&forward,0,0);
+
+  // around the center of the map
+  hostScene.camera.transform.translation.x = 4 * S3L_FRACTIONS_PER_UNIT -
+    forward.x * 8;
+  hostScene.camera.transform.translation.y = 6 * S3L_FRACTIONS_PER_UNIT;
+  hostScene.camera.transform.translation.z = -5 * S3L_FRACTIONS_PER_UNIT -
+    forward.z * 8;
+}
+
+// a grid of spinning cars, many models of a few triangles
+
+#define GRID_SIZE 8
+
+static void manyModelsSetup(void)
+{
+  for (uint8_t i = 0; i < GRID_SIZE * GRID_SIZE; ++i)
+  {
+    models[i] = carModel;
+    modelMaterials[i] = carModelMaterials;
+  }
+
+  initScene(GRID_SIZE * GRID_SIZE);
+
+  hostScene.camera.transform.translation.y = 3 * S3L_FRACTIONS_PER_UNIT;
+  hostScene.camera.transform.rotation.x = -S3L_FRACTIONS_PER_UNIT / 12;
+}
+
+static void manyModelsFrame(int frame)
+{
+  S3L_Vec4 forward;
+
+  for (uint8_t i = 0; i < GRID_SIZE * GRID_SIZE; ++i)
+    S3L_setTransform3D(
+      (i % GRID_SIZE) * S3L_FRACTIONS_PER_UNIT * 2,0,
+      (i / GRID_SIZE) * S3L_FRACTIONS_PER_UNIT * 2,
+      0,(frame * 4 + i * 37) % S3L_FRACTIONS_PER_UNIT,0,
+      1024,1024,1024,&(models[i].transform));
+
+  hostScene.camera.transform.rotation.y =
+    (frame * S3L_FRACTIONS_PER_UNIT / 1024) % S3L_FRACTIONS_PER_UNIT;
+
+  S3L_rotationToDirections(hostScene.camera.transform.rotation,
+    S3L_FRACTIONS_PER_UNIT,&forward,0,0);
+
+  hostScene.camera.transform.translation.x =
+    (GRID_SIZE - 1) * S3L_FRACTIONS_PER_UNIT - forward.x * 12;
+  hostScene.camera.transform.translation.z =
+    (GRID_SIZE - 1) * S3L_FRACTIONS_PER_UNIT - forward.z * 12;
+}
+
+static void quadScene(uint8_t count)
+{
+  for (uint8_t i = 0; i < count; ++i)
+  {
+    S3L_initModel3D(quadVertices,4,quadTriangles,2,&models[i]);
+    models[i].attributes = quadAttributes;
+    models[i].attributeCount = 1;
+    models[i].config.backfaceCulling = 0;
+    modelMaterials[i] = quadModelMaterials;
+  }
+
+  initScene(count);
+}
+
+/* a long tunnel the camera moves through, a few huge triangles that are
+   mostly crossing the near plane */
+
+#define TUNNEL_LENGTH 64
+
+static void hugeTrianglesSetup(void)
+{
+  quadScene(4);
+
+  for (uint8_t i = 0; i < 4; ++i) // floor, ceiling, left and right wall
+    S3L_setTransform3D(
+      i < 2 ? 0 : (i == 2 ? -1 : 1) * S3L_FRACTIONS_PER_UNIT,
+      i < 2 ? i * S3L_FRACTIONS_PER_UNIT * 2 : S3L_FRACTIONS_PER_UNIT,
+      0,
+      0,0,i < 2 ? 0 : S3L_FRACTIONS_PER_UNIT / 4,
+      2 * S3L_FRACTIONS_PER_UNIT,S3L_FRACTIONS_PER_UNIT,
+      TUNNEL_LENGTH * S3L_FRACTIONS_PER_UNIT,&(models[i].transform));
+
+  hostScene.camera.transform.translation.y = S3L_FRACTIONS_PER_UNIT;
+}
+
+static void hugeTrianglesFrame(int frame)
+{
+  // back and forth along the tunnel, swaying
+  int32_t z = (frame * CAR_SPEED) %
+    ((TUNNEL_LENGTH - 4) * S3L_FRACTIONS_PER_UNIT * 2);
+
+  if (z > (TUNNEL_LENGTH - 4) * S3L_FRACTIONS_PER_UNIT)
+    z = (TUNNEL_LENGTH - 4) * S3L_FRACTIONS_PER_UNIT * 2 - z;
+
+  hostScene.camera.transform.translation.z =
+    z - ((TUNNEL_LENGTH - 4) * S3L_FRACTIONS_PER_UNIT) / 2;
+
+  hostScene.camera.transform.rotation.y =
+    S3L_sin(frame * 2) / 8;
+  hostScene.camera.transform.rotation.x =
+    S3L_sin(frame * 3) / 16;
+}
+
+// screen covering quads drawn back to front, each layer passes the z-test
+
+#define OVERDRAW_LAYERS 16
+
+static void overdrawSetup(void)
+{
+  quadScene(OVERDRAW_LAYERS);
+
+  for (uint8_t i = 0; i < OVERDRAW_LAYERS; ++i)
+    S3L_setTransform3D(0,0,
+      4 * S3L_FRACTIONS_PER_UNIT - (i * S3L_FRACTIONS_PER_UNIT) / 5,
+      S3L_FRACTIONS_PER_UNIT / 4,0,0,
+      16 * S3L_FRACTIONS_PER_UNIT,S3L_FRACTIONS_PER_UNIT,
+      16 * S3L_FRACTIONS_PER_UNIT,&(models[i].transform));
+}
+
+static void overdrawFrame(int frame)
+{
+  hostScene.camera.transform.translation.x = S3L_sin(frame * 2) / 2;
+  hostScene.camera.transform.translation.y = S3L_cos(frame * 3) / 2;
+}
+
+const HostScene hostScenes[HOST_SCENE_COUNT] =
+{
+  { "city_drive",      cityDriveSetup,      cityDriveFrame },
+  { "city_overview",   cityOverviewSetup,   cityOverviewFrame },
+  { "many_models",     manyModelsSetup,     manyModelsFrame },
+  { "huge_triangles",  hugeTrianglesSetup,  hugeTrianglesFrame },
+  { "overdraw",        overdrawSetup,       overdrawFrame }
+};
+
+void hostScenesInit(void)
+{
+  S3L_Unit points[sizeof(scriptedPath)];
+
+  S3L_hostInit();
+  cityMaterialsInit();
+  cityModelInit();
+  carModelInit();
+  S3L_SetMaterials(cityMaterials,modelMaterials);
+
+#if S3L_LIGHTING
+  computeNormals(&cityModel,cityNormals,cityNormalIndices);
+  computeNormals(&carModel,carNormals,carNormalIndices);
+#endif
+
+  // map square halves to the middle of the roads
+  for (uint16_t i = 0; i < sizeof(scriptedPath); i += 2)
+  {
+    points[i] = scriptedPath[i] * S3L_FRACTIONS_PER_UNIT / 2;
+    points[i + 1] = -scriptedPath[i + 1] * S3L_FRACTIONS_PER_UNIT / 2;
+  }
+
+  setPath(points,sizeof(scriptedPath) / 2);
+}
+
+void hostSceneFrame(const HostScene *scene, int frame)
+{
+  scene->frame(frame);
+  S3L_hostClear(S3L_color(0,0,9,15));
+}
@@ -0,0 +1,42 @@
+#ifndef HOST_SCENES_H_
+#define HOST_SCENES_H_
+
+/*
+  Scripted scenes of the host build (see host_scenes.c), used by host_bench.c
+  and host_golden.c. Rendering a frame of a scene:
+
+    hostScenes[i].setup(); // once
+    hostSceneFrame(&hostScenes[i],frame);
+    S3L_newFrame();
+    S3L_drawScene(hostScene);
+    S3L_resolveVisibilityBuffer(hostScene);
+*/
+
+#include "small3dlib.h"
+
+#define HOST_SCENE_COUNT 5
+
+typedef struct
+{
+  const char *name;
+  void (*setup)(void);       ///< sets up hostScene
+  void (*frame)(int frame);  ///< places the camera and models for a frame
+} HostScene;
+
+extern const HostScene hostScenes[HOST_SCENE_COUNT];
+
+/** The S3L scene of the current HostScene. */
+extern S3L_Scene hostScene;
+
+/** Initializes the framebuffer (S3L_hostInit), the models and materials and
+  the scripted car path. */
+void hostScenesInit(void);
+
+/** Makes the car drive along a recorded path, a text file of "x z" positions
+  in S3L_Units, one per line. Returns 1 on success, 0 on error. */
+int hostLoadPath(const char *fileName);
+
+/** Sets up given frame of a scene and clears the framebuffer. */
+void hostSceneFrame(const HostScene *scene, int frame);
+
+#endif
@@ -4,35 +4,11 @@
 
 #include <stdint.h>
 
-#ifdef S3L_RESOLUTION_X
-  #ifdef S3L_RESOLUTION_Y
-    #define S3L_MAX_PIXELS (S3L_RESOLUTION_X * S3L_RESOLUTION_Y)
-  #endif
-#endif
-
-#ifndef S3L_RESOLUTION_X
-  #ifndef S3L_MAX_PIXELS
-    #error Dynamic resolution set (S3L_RESOLUTION_X not defined), but\
-           S3L_MAX_PIXELS not defined!
-  #endif
-
-  uint16_t S3L_resolutionX = 512; /**< If a static resolution is not set with
-                                       S3L_RESOLUTION_X, this variable can be
-                                       used to change X resolution at runtime,
-                                       in which case S3L_MAX_PIXELS has to be
-                                       defined (to allocate zBuffer etc.)! */
-  #define S3L_RESOLUTION_X S3L_resolutionX
-#endif
-
-#ifndef S3L_RESOLUTION_Y
-  #ifndef S3L_MAX_PIXELS
-    #error Dynamic resolution set (S3L_RESOLUTION_Y not defined), but\
-           S3L_MAX_PIXELS not defined!
-  #endif
-
-  uint16_t S3L_resolutionY = 512; /**< Same as S3L_resolutionX, but for Y
-                                       resolution. */
-  #define S3L_RESOLUTION_Y S3L_resolutionY
+#if S3L_DYNAMIC_RESOLUTION
+  /* With S3L_DYNAMIC_RESOLUTION (S3L_config.h), S3L_RESOLUTION_X and
+     S3L_RESOLUTION_Y are these variables, set by S3L_setResolution. */
+  uint16_t S3L_resolutionX = S3L_MAX_RESOLUTION_X;
+  uint16_t S3L_resolutionY = S3L_MAX_RESOLUTION_Y;
 #endif
 
 
@@ -99,7 +75,19 @@
   #define S3L_PC_APPROX_LENGTH 32
 #endif
 
+#ifndef S3L_PC_MIN_APPROX_LENGTH
+  /** For S3L_PERSPECTIVE_CORRECTION == 2, if this is smaller than
+  S3L_PC_APPROX_LENGTH, the length of the row segments is chosen per triangle
+  (as a power of two fraction of S3L_PC_APPROX_LENGTH, but not smaller than
+  this) according to how much the depth changes over the triangle: triangles
+  facing the camera get long segments, triangles seen at steep angles (which
+  show the biggest error) get short ones. */
+
+  #define S3L_PC_MIN_APPROX_LENGTH S3L_PC_APPROX_LENGTH
+#endif
+
 #if S3L_PERSPECTIVE_CORRECTION
+#undef S3L_COMPUTE_DEPTH
 #define S3L_COMPUTE_DEPTH 1  // PC inevitably computes depth, so enable it
 #endif
 
@@ -165,6 +153,38 @@
   #define S3L_SORT 0
 #endif
 
+#ifndef S3L_VERTEX_CACHE_SIZE
+  /** Size of a cache of transformed vertices, which saves transforming the
+  same vertex for each triangle sharing it. It's direct mapped by the vertex
+  index (so the size has to be a power of two), which is cheap to look up, and
+  pays off with meshes ordered for locality (see S3L_mesh.h:
+  S3L_optimizeTriangleOrder and S3L_optimizeVertexOrder). 0 turns it off. */
+
+  #define S3L_VERTEX_CACHE_SIZE 0
+#endif
+
+#ifndef S3L_VISIBILITY_BUFFER
+  /** Whether to use a visibility buffer (deferred shading). If on, the
+  rasterizer doesn't call the pixel function at all, it only records the
+  triangle and two barycentric coordinates of the visible fragment of each
+  pixel (8 bytes per pixel, including the resolve's pixel order). The pixel
+  function is then called exactly once for each covered pixel by
+  S3L_resolveVisibilityBuffer, which also sets up each visible triangle only
+  once, so the shading cost doesn't depend on depth complexity (overdraw).
+  Visibility is still solved by the z-buffer and/or sorting, the last fragment
+  written wins. */
+
+  #define S3L_VISIBILITY_BUFFER 0
+#endif
+
+#ifndef S3L_VISIBILITY_TRIANGLES
+  /** Maximum number of triangles that can be rasterized into the visibility
+  buffer in one frame (at most 65535, 12 bytes each), further ones are
+  dropped (see S3L_Stats). */
+
+  #define S3L_VISIBILITY_TRIANGLES 1024
+#endif
+
 #ifndef S3L_MAX_TRIANGES_DRAWN
   /** Maximum number of triangles that can be drawn in sorted modes. This
   affects the size of the cache used for triangle sorting. */
@@ -183,13 +203,6 @@
 #define S3L_NEAR 1 // Can't be <= 0.
 #endif
 
-#ifndef S3L_NORMAL_COMPUTE_MAXIMUM_AVERAGE
-  /** Affects the S3L_computeModelNormals function. See its description for
-  details. */
-
-  #define S3L_NORMAL_COMPUTE_MAXIMUM_AVERAGE 6
-#endif
-
 #ifndef S3L_FAST_LERP_QUALITY
   /** Quality (scaling) of SOME (stepped) linear interpolations. 0 will most
   likely be a tiny bit faster, but artifacts can occur for bigger tris, while
@@ -231,14 +244,128 @@ _S3L_TriangleToSort S3L_sortArray[S3L_MAX_TRIANGES_DRAWN];
 uint16_t S3L_sortArrayLength;
 #endif
 
+#if S3L_STATS
+S3L_Stats S3L_stats;
+
+  #define S3L_STATS_ADD(counter,value) S3L_stats.counter += (value)
+#else
+  #define S3L_STATS_ADD(counter,value) ((void) 0)
+#endif
+
+#if S3L_OVERDRAW
+S3L_Overdraw S3L_overdraw;
+
+  // saturating increment
+  #define S3L_OVERDRAW_ADD(counter,index)\
+    (S3L_overdraw.counter[index] += S3L_overdraw.counter[index] != 255)
+#else
+  #define S3L_OVERDRAW_ADD(counter,index) ((void) 0)
+#endif
+
+#if S3L_PROFILE
+S3L_Profile S3L_profile;
+
+static void _S3L_profileEnd(uint8_t zone, uint32_t start, uint8_t event)
+{
+  uint32_t duration = S3L_PROFILE_CLOCK() - start;
+
+  S3L_profile.time[zone] += duration;
+  S3L_profile.count[zone]++;
+
+  if (event)
+  {
+    if (S3L_profile.eventCount < S3L_PROFILE_EVENTS)
+    {
+      S3L_ProfileEvent *e = &(S3L_profile.events[S3L_profile.eventCount]);
+
+      e->zone = zone;
+      e->start = start - S3L_profile.frameStart;
+      e->duration = duration;
+      S3L_profile.eventCount++;
+    }
+    else
+      S3L_profile.eventsDropped++;
+  }
+}
+
+  /* A zone is a block of code between S3L_PROFILE_BEGIN(name) and
+     S3L_PROFILE_END(name,zone), events are recorded for zones entered once
+     per frame. */
+  #define S3L_PROFILE_BEGIN(name) uint32_t name = S3L_PROFILE_CLOCK()
+  #define S3L_PROFILE_END(name,zone) _S3L_profileEnd(zone,name,0)
+  #define S3L_PROFILE_END_EVENT(name,zone) _S3L_profileEnd(zone,name,1)
+#else
+  #define S3L_PROFILE_BEGIN(name) ((void) 0)
+  #define S3L_PROFILE_END(name,zone) ((void) 0)
+  #define S3L_PROFILE_END_EVENT(name,zone) ((void) 0)
+#endif
+
+// zones entered per triangle (projection, rasterization) from S3L_PROFILE 2:
+#if S3L_PROFILE >= 2
+  #define S3L_PROFILE_TRIANGLE_BEGIN(name) S3L_PROFILE_BEGIN(name)
+  #define S3L_PROFILE_TRIANGLE_END(name,zone) S3L_PROFILE_END(name,zone)
+#else
+  #define S3L_PROFILE_TRIANGLE_BEGIN(name) ((void) 0)
+  #define S3L_PROFILE_TRIANGLE_END(name,zone) ((void) 0)
+#endif
+
+#if S3L_PROFILE >= 3
+  #define S3L_PROFILE_SHADING(call)\
+    { S3L_PROFILE_BEGIN(_shading); call; \
+      S3L_PROFILE_END(_shading,S3L_ZONE_SHADING); }
+#else
+  #define S3L_PROFILE_SHADING(call) call
+#endif
+
+
+
+#if S3L_VISIBILITY_BUFFER
+#if S3L_VISIBILITY_TRIANGLES > 65535
+  #error S3L_VISIBILITY_TRIANGLES must be at most 65535!
+#endif
+
+typedef struct
+{
+  uint16_t triangle;      ///< index to _S3L_visibleTriangles
+  int16_t barycentric[2]; /* The third one is computed as
+                             S3L_FRACTIONS_PER_UNIT minus these two. */
+} _S3L_VisibilityBufferEntry;
+
+#define S3L_VISIBILITY_BUFFER_EMPTY 0xffff
+
+_S3L_VisibilityBufferEntry S3L_visibilityBuffer[S3L_MAX_PIXELS];
+
+typedef struct
+{
+  uint32_t triangleID;
+  uint32_t pixels; /* during the resolve the number of the triangle's pixels,
+                      then their end in _S3L_visibilityOrder */
+  S3L_ScreenCoord size[2]; ///< screen space size, e.g. for MIP selection
+} _S3L_VisibleTriangle;
+
+/* Triangles rasterized into the visibility buffer this frame, in the order of
+   rasterization. */
+static _S3L_VisibleTriangle _S3L_visibleTriangles[S3L_VISIBILITY_TRIANGLES];
+static uint16_t _S3L_visibleTriangleCount = 0;
 
+#if S3L_MAX_PIXELS <= 65536
+typedef uint16_t _S3L_PixelIndex;
+#else
+typedef uint32_t _S3L_PixelIndex;
+#endif
+
+/* Covered pixels grouped by triangle, filled by the resolve. */
+static _S3L_PixelIndex _S3L_visibilityOrder[S3L_MAX_PIXELS];
+#endif
 
 //static functions ------------------------------------------------------------------
 
+#if S3L_Z_BUFFER
 static inline int8_t S3L_zTest(
   S3L_ScreenCoord x,
   S3L_ScreenCoord y,
   S3L_Unit depth);
+#endif
 
 /** Determines the winding of a triangle, returns 1 (CW, clockwise), -1 (CCW,
   counterclockwise) or 0 (points lie on a single line). */
@@ -387,7 +514,7 @@ static inline void S3L_initPixelInfo(S3L_PixelInfo *p)
 
 #if S3L_STENCIL_BUFFER
   #define S3L_STENCIL_BUFFER_SIZE\
-    ((S3L_RESOLUTION_X * S3L_RESOLUTION_Y - 1) / 8 + 1)
+    ((S3L_MAX_PIXELS - 1) / 8 + 1)
 
 uint8_t S3L_stencilBuffer[S3L_STENCIL_BUFFER_SIZE];
 
@@ -414,83 +541,76 @@ static inline int8_t S3L_stencilTest(
 #define S3L_COMPUTE_LERP_DEPTH\
   (S3L_COMPUTE_DEPTH && (S3L_PERSPECTIVE_CORRECTION == 0))
 
-#define S3L_SIN_TABLE_LENGTH 128
+/* Attributes are stepped along with barycentrics in affine mode, otherwise
+   they are computed from the (corrected) barycentrics per pixel. */
+#define S3L_LERP_ATTRIBUTES\
+  (S3L_MAX_ATTRIBUTES > 0 && !S3L_VISIBILITY_BUFFER && !S3L_FLAT &&\
+  (S3L_PERSPECTIVE_CORRECTION == 0))
+
+#define S3L_BARYCENTRIC_ATTRIBUTES\
+  (S3L_MAX_ATTRIBUTES > 0 && !S3L_VISIBILITY_BUFFER && !S3L_LERP_ATTRIBUTES)
 
+/* With PC == 2 attributes are corrected at the ends of row segments and
+   stepped linearly in between, just like barycentrics. */
+#define S3L_PC_ATTRIBUTES\
+  (S3L_BARYCENTRIC_ATTRIBUTES && !S3L_FLAT &&\
+  (S3L_PERSPECTIVE_CORRECTION == 2))
 
+#if S3L_MAX_ATTRIBUTES > 0
+S3L_Unit S3L_triangleAttributes[3][S3L_MAX_ATTRIBUTES];
+uint8_t S3L_triangleAttributeCount = 0;
+#endif
+
+#define S3L_SIN_TABLE_LENGTH 128
 
-static const S3L_Unit S3L_sinTable[S3L_SIN_TABLE_LENGTH] =
-{
-  /* 511 was chosen here as a highest number that doesn't overflow during
-     compilation for S3L_FRACTIONS_PER_UNIT == 1024 */
-
-  (0*S3L_FRACTIONS_PER_UNIT)/511, (6*S3L_FRACTIONS_PER_UNIT)/511, 
-  (12*S3L_FRACTIONS_PER_UNIT)/511, (18*S3L_FRACTIONS_PER_UNIT)/511, 
-  (25*S3L_FRACTIONS_PER_UNIT)/511, (31*S3L_FRACTIONS_PER_UNIT)/511, 
-  (37*S3L_FRACTIONS_PER_UNIT)/511, (43*S3L_FRACTIONS_PER_UNIT)/511, 
-  (50*S3L_FRACTIONS_PER_UNIT)/511, (56*S3L_FRACTIONS_PER_UNIT)/511, 
-  (62*S3L_FRACTIONS_PER_UNIT)/511, (68*S3L_FRACTIONS_PER_UNIT)/511, 
-  (74*S3L_FRACTIONS_PER_UNIT)/511, (81*S3L_FRACTIONS_PER_UNIT)/511, 
-  (87*S3L_FRACTIONS_PER_UNIT)/511, (93*S3L_FRACTIONS_PER_UNIT)/511, 
-  (99*S3L_FRACTIONS_PER_UNIT)/511, (105*S3L_FRACTIONS_PER_UNIT)/511, 
-  (111*S3L_FRACTIONS_PER_UNIT)/511, (118*S3L_FRACTIONS_PER_UNIT)/511, 
-  (124*S3L_FRACTIONS_PER_UNIT)/511, (130*S3L_FRACTIONS_PER_UNIT)/511, 
-  (136*S3L_FRACTIONS_PER_UNIT)/511, (142*S3L_FRACTIONS_PER_UNIT)/511, 
-  (148*S3L_FRACTIONS_PER_UNIT)/511, (154*S3L_FRACTIONS_PER_UNIT)/511, 
-  (160*S3L_FRACTIONS_PER_UNIT)/511, (166*S3L_FRACTIONS_PER_UNIT)/511, 
-  (172*S3L_FRACTIONS_PER_UNIT)/511, (178*S3L_FRACTIONS_PER_UNIT)/511, 
-  (183*S3L_FRACTIONS_PER_UNIT)/511, (189*S3L_FRACTIONS_PER_UNIT)/511, 
-  (195*S3L_FRACTIONS_PER_UNIT)/511, (201*S3L_FRACTIONS_PER_UNIT)/511, 
-  (207*S3L_FRACTIONS_PER_UNIT)/511, (212*S3L_FRACTIONS_PER_UNIT)/511, 
-  (218*S3L_FRACTIONS_PER_UNIT)/511, (224*S3L_FRACTIONS_PER_UNIT)/511, 
-  (229*S3L_FRACTIONS_PER_UNIT)/511, (235*S3L_FRACTIONS_PER_UNIT)/511, 
-  (240*S3L_FRACTIONS_PER_UNIT)/511, (246*S3L_FRACTIONS_PER_UNIT)/511, 
-  (251*S3L_FRACTIONS_PER_UNIT)/511, (257*S3L_FRACTIONS_PER_UNIT)/511, 
-  (262*S3L_FRACTIONS_PER_UNIT)/511, (268*S3L_FRACTIONS_PER_UNIT)/511, 
-  (273*S3L_FRACTIONS_PER_UNIT)/511, (278*S3L_FRACTIONS_PER_UNIT)/511, 
-  (283*S3L_FRACTIONS_PER_UNIT)/511, (289*S3L_FRACTIONS_PER_UNIT)/511, 
-  (294*S3L_FRACTIONS_PER_UNIT)/511, (299*S3L_FRACTIONS_PER_UNIT)/511, 
-  (304*S3L_FRACTIONS_PER_UNIT)/511, (309*S3L_FRACTIONS_PER_UNIT)/511, 
-  (314*S3L_FRACTIONS_PER_UNIT)/511, (319*S3L_FRACTIONS_PER_UNIT)/511, 
-  (324*S3L_FRACTIONS_PER_UNIT)/511, (328*S3L_FRACTIONS_PER_UNIT)/511, 
-  (333*S3L_FRACTIONS_PER_UNIT)/511, (338*S3L_FRACTIONS_PER_UNIT)/511, 
-  (343*S3L_FRACTIONS_PER_UNIT)/511, (347*S3L_FRACTIONS_PER_UNIT)/511, 
-  (352*S3L_FRACTIONS_PER_UNIT)/511, (356*S3L_FRACTIONS_PER_UNIT)/511, 
-  (361*S3L_FRACTIONS_PER_UNIT)/511, (365*S3L_FRACTIONS_PER_UNIT)/511, 
-  (370*S3L_FRACTIONS_PER_UNIT)/511, (374*S3L_FRACTIONS_PER_UNIT)/511, 
-  (378*S3L_FRACTIONS_PER_UNIT)/511, (382*S3L_FRACTIONS_PER_UNIT)/511, 
-  (386*S3L_FRACTIONS_PER_UNIT)/511, (391*S3L_FRACTIONS_PER_UNIT)/511, 
-  (395*S3L_FRACTIONS_PER_UNIT)/511, (398*S3L_FRACTIONS_PER_UNIT)/511, 
-  (402*S3L_FRACTIONS_PER_UNIT)/511, (406*S3L_FRACTIONS_PER_UNIT)/511, 
-  (410*S3L_FRACTIONS_PER_UNIT)/511, (414*S3L_FRACTIONS_PER_UNIT)/511, 
-  (417*S3L_FRACTIONS_PER_UNIT)/511, (421*S3L_FRACTIONS_PER_UNIT)/511, 
-  (424*S3L_FRACTIONS_PER_UNIT)/511, (428*S3L_FRACTIONS_PER_UNIT)/511, 
-  (431*S3L_FRACTIONS_PER_UNIT)/511, (435*S3L_FRACTIONS_PER_UNIT)/511, 
-  (438*S3L_FRACTIONS_PER_UNIT)/511, (441*S3L_FRACTIONS_PER_UNIT)/511, 
-  (444*S3L_FRACTIONS_PER_UNIT)/511, (447*S3L_FRACTIONS_PER_UNIT)/511, 
-  (450*S3L_FRACTIONS_PER_UNIT)/511, (453*S3L_FRACTIONS_PER_UNIT)/511, 
-  (456*S3L_FRACTIONS_PER_UNIT)/511, (459*S3L_FRACTIONS_PER_UNIT)/511, 
-  (461*S3L_FRACTIONS_PER_UNIT)/511, (464*S3L_FRACTIONS_PER_UNIT)/511, 
-  (467*S3L_FRACTIONS_PER_UNIT)/511, (469*S3L_FRACTIONS_PER_UNIT)/511, 
-  (472*S3L_FRACTIONS_PER_UNIT)/511, (474*S3L_FRACTIONS_PER_UNIT)/511, 
-  (476*S3L_FRACTIONS_PER_UNIT)/511, (478*S3L_FRACTIONS_PER_UNIT)/511, 
-  (481*S3L_FRACTIONS_PER_UNIT)/511, (483*S3L_FRACTIONS_PER_UNIT)/511, 
-  (485*S3L_FRACTIONS_PER_UNIT)/511, (487*S3L_FRACTIONS_PER_UNIT)/511, 
-  (488*S3L_FRACTIONS_PER_UNIT)/511, (490*S3L_FRACTIONS_PER_UNIT)/511, 
-  (492*S3L_FRACTIONS_PER_UNIT)/511, (494*S3L_FRACTIONS_PER_UNIT)/511, 
-  (495*S3L_FRACTIONS_PER_UNIT)/511, (497*S3L_FRACTIONS_PER_UNIT)/511, 
-  (498*S3L_FRACTIONS_PER_UNIT)/511, (499*S3L_FRACTIONS_PER_UNIT)/511, 
-  (501*S3L_FRACTIONS_PER_UNIT)/511, (502*S3L_FRACTIONS_PER_UNIT)/511, 
-  (503*S3L_FRACTIONS_PER_UNIT)/511, (504*S3L_FRACTIONS_PER_UNIT)/511, 
-  (505*S3L_FRACTIONS_PER_UNIT)/511, (506*S3L_FRACTIONS_PER_UNIT)/511, 
-  (507*S3L_FRACTIONS_PER_UNIT)/511, (507*S3L_FRACTIONS_PER_UNIT)/511, 
-  (508*S3L_FRACTIONS_PER_UNIT)/511, (509*S3L_FRACTIONS_PER_UNIT)/511, 
-  (509*S3L_FRACTIONS_PER_UNIT)/511, (510*S3L_FRACTIONS_PER_UNIT)/511, 
-  (510*S3L_FRACTIONS_PER_UNIT)/511, (510*S3L_FRACTIONS_PER_UNIT)/511, 
-  (510*S3L_FRACTIONS_PER_UNIT)/511, (510*S3L_FRACTIONS_PER_UNIT)/511
+/* Quarter of the sine wave, sin(i / (4 * S3L_SIN_TABLE_LENGTH) turns) * 2^15
+   for i = 0 ... S3L_SIN_TABLE_LENGTH, independent of S3L_FRACTIONS_PER_UNIT
+   and finer than it, S3L_sin interpolates between the entries. */
+static const uint16_t S3L_sinTable[S3L_SIN_TABLE_LENGTH + 1] =
+{
+  0, 402, 804, 1206, 1608, 2009, 2411, 2811,
+  3212, 3612, 4011, 4410, 4808, 5205, 5602, 5998,
+  6393, 6787, 7180, 7571, 7962, 8351, 8740, 9127,
+  9512, 9896, 10279, 10660, 11039, 11417, 11793, 12167,
+  12540, 12910, 13279, 13646, 14010, 14373, 14733, 15091,
+  15447, 15800, 16151, 16500, 16846, 17190, 17531, 17869,
+  18205, 18538, 18868, 19195, 19520, 19841, 20160, 20475,
+  20788, 21097, 21403, 21706, 22006, 22302, 22595, 22884,
+  23170, 23453, 23732, 24008, 24279, 24548, 24812, 25073,
+  25330, 25583, 25833, 26078, 26320, 26557, 26791, 27020,
+  27246, 27467, 27684, 27897, 28106, 28311, 28511, 28707,
+  28899, 29086, 29269, 29448, 29622, 29792, 29957, 30118,
+  30274, 30425, 30572, 30715, 30853, 30986, 31114, 31238,
+  31357, 31471, 31581, 31686, 31786, 31881, 31972, 32058,
+  32138, 32214, 32286, 32352, 32413, 32470, 32522, 32568,
+  32610, 32647, 32679, 32706, 32729, 32746, 32758, 32766,
+  32768
 };
+
 #define S3L_SIN_TABLE_UNIT_STEP\
   (S3L_FRACTIONS_PER_UNIT / (S3L_SIN_TABLE_LENGTH * 4))
 
+/* floor(16 * sqrt(i)), seeds S3L_sqrt. */
+static const uint8_t _S3L_sqrtTable[256] =
+{
+  0, 16, 22, 27, 32, 35, 39, 42, 45, 48, 50, 53, 55, 57, 59, 61,
+  64, 65, 67, 69, 71, 73, 75, 76, 78, 80, 81, 83, 84, 86, 87, 89,
+  90, 91, 93, 94, 96, 97, 98, 99, 101, 102, 103, 104, 106, 107, 108, 109,
+  110, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126,
+  128, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142,
+  143, 144, 144, 145, 146, 147, 148, 149, 150, 150, 151, 152, 153, 154, 155, 155,
+  156, 157, 158, 159, 160, 160, 161, 162, 163, 163, 164, 165, 166, 167, 167, 168,
+  169, 170, 170, 171, 172, 173, 173, 174, 175, 176, 176, 177, 178, 178, 179, 180,
+  181, 181, 182, 183, 183, 184, 185, 185, 186, 187, 187, 188, 189, 189, 190, 191,
+  192, 192, 193, 193, 194, 195, 195, 196, 197, 197, 198, 199, 199, 200, 201, 201,
+  202, 203, 203, 204, 204, 205, 206, 206, 207, 208, 208, 209, 209, 210, 211, 211,
+  212, 212, 213, 214, 214, 215, 215, 216, 217, 217, 218, 218, 219, 219, 220, 221,
+  221, 222, 222, 223, 224, 224, 225, 225, 226, 226, 227, 227, 228, 229, 229, 230,
+  230, 231, 231, 232, 232, 233, 234, 234, 235, 235, 236, 236, 237, 237, 238, 238,
+  239, 240, 240, 241, 241, 242, 242, 243, 243, 244, 244, 245, 245, 246, 246, 247,
+  247, 248, 248, 249, 249, 250, 250, 251, 251, 252, 252, 253, 253, 254, 254, 255
+};
+
 
 
 
@@ -533,13 +653,110 @@ static inline void S3L_mapProjectionPlaneToScreen(
     (point.y * S3L_HALF_RESOLUTION_X) / S3L_FRACTIONS_PER_UNIT;
 }
 
+#if S3L_RECIPROCAL_DIVISION && !defined(S3L_DIVIDE_FUNCTION)
+/* floor(2^15 / m) for m the upper end of the i-th 1/128 of [1/2,1), seeds
+   _S3L_reciprocal from below. */
+static const uint16_t _S3L_reciprocalTable[128] =
+{
+  65027, 64527, 64035, 63550, 63072, 62601, 62137, 61680,
+  61230, 60787, 60349, 59918, 59493, 59074, 58661, 58254,
+  57852, 57456, 57065, 56679, 56299, 55924, 55553, 55188,
+  54827, 54471, 54120, 53773, 53430, 53092, 52758, 52428,
+  52103, 51781, 51463, 51150, 50840, 50533, 50231, 49932,
+  49636, 49344, 49056, 48770, 48489, 48210, 47934, 47662,
+  47393, 47127, 46863, 46603, 46345, 46091, 45839, 45590,
+  45343, 45100, 44858, 44620, 44384, 44150, 43919, 43690,
+  43464, 43240, 43018, 42799, 42581, 42366, 42153, 41943,
+  41734, 41527, 41323, 41120, 40920, 40721, 40524, 40329,
+  40136, 39945, 39756, 39568, 39383, 39199, 39016, 38836,
+  38657, 38479, 38304, 38130, 37957, 37786, 37617, 37449,
+  37282, 37117, 36954, 36792, 36631, 36472, 36314, 36157,
+  36002, 35848, 35696, 35544, 35394, 35246, 35098, 34952,
+  34807, 34663, 34521, 34379, 34239, 34100, 33961, 33825,
+  33689, 33554, 33420, 33288, 33156, 33026, 32896, 32768
+};
+
+/** Returns 2^32 / d for d > 0, rounded down and possibly a bit lower (by at
+  most about 2^-14 of it), without dividing. */
+static inline uint32_t _S3L_reciprocal(uint32_t d)
+{
+  uint32_t top = d;
+  uint8_t bits = 1;
+
+  if (top >> 16) { top >>= 16; bits += 16; }
+  if (top >> 8) { top >>= 8; bits += 8; }
+  if (top >> 4) { top >>= 4; bits += 4; }
+  if (top >> 2) { top >>= 2; bits += 2; }
+  if (top >> 1) bits++;
+
+  // m = d / 2^bits in [1/2,1) as 0.32 fixed point, y ~ 1 / m as 1.31
+  uint32_t m = d << (32 - bits);
+  uint32_t y = ((uint32_t) _S3L_reciprocalTable[(m >> 24) & 0x7f]) << 16;
+
+  // Newton step y += y * (1 - m * y), stays below 1 / m
+  uint64_t e = (((uint64_t) 1) << 63) - ((uint64_t) m) * y;
+  y += (((uint64_t) y) * ((uint32_t) (e >> 31))) >> 32;
+
+  return y >> (bits - 1);
+}
+
+/** Returns n / d (rounded towards zero like the division) given
+  r = _S3L_reciprocal(|d|): the estimate from r is refined with the
+  remainder and corrected by single steps (none for most quotients, up to 8
+  for quotients near 2^31). Zero d is treated as 1. */
+static inline S3L_Unit _S3L_divideByReciprocal(S3L_Unit n, S3L_Unit d,
+  uint32_t r)
+{
+  uint32_t a = n < 0 ? -1 * ((uint32_t) n) : (uint32_t) n;
+  uint32_t b = d < 0 ? -1 * ((uint32_t) d) : (uint32_t) d;
+
+  b += b == 0;
+
+  uint32_t q = (((uint64_t) a) * r) >> 32;
+  uint32_t remainder = a - q * b;
+  uint32_t q2 = (((uint64_t) remainder) * r) >> 32;
+
+  q += q2;
+  remainder -= q2 * b;
+
+  while (remainder >= b)
+  {
+    q++;
+    remainder -= b;
+  }
+
+  return (n < 0) != (d < 0) ? -1 * ((S3L_Unit) q) : (S3L_Unit) q;
+}
+
+#endif
+
+/** Divides by depth: by the port's divider if it has one, otherwise in
+  software. */
+static inline S3L_Unit _S3L_divide(S3L_Unit n, S3L_Unit d)
+{
+#ifdef S3L_DIVIDE_FUNCTION
+  return S3L_DIVIDE_FUNCTION(n,d);
+#elif S3L_RECIPROCAL_DIVISION
+  return _S3L_divideByReciprocal(n,d,_S3L_reciprocal(S3L_abs(d)));
+#else
+  return n / d;
+#endif
+}
+
 /** Performs perspecive division (z-divide). Does NOT check for division by
   zero. */
 static inline void S3L_perspectiveDivide(S3L_Vec4 *vector,
   S3L_Unit focalLength)
 {
-  vector->x = (vector->x * focalLength) / vector->z;
-  vector->y = (vector->y * focalLength) / vector->z;
+#if S3L_RECIPROCAL_DIVISION && !defined(S3L_DIVIDE_FUNCTION)
+  uint32_t r = _S3L_reciprocal(S3L_abs(vector->z)); // shared by x and y
+
+  vector->x = _S3L_divideByReciprocal(vector->x * focalLength,vector->z,r);
+  vector->y = _S3L_divideByReciprocal(vector->y * focalLength,vector->z,r);
+#else
+  vector->x = _S3L_divide(vector->x * focalLength,vector->z);
+  vector->y = _S3L_divide(vector->y * focalLength,vector->z);
+#endif
 }
 
 
@@ -559,17 +776,27 @@ static inline int8_t S3L_triangleIsVisible(
 
   if ( // outside frustum?
 #if S3L_NEAR_CROSS_STRATEGY == 0
-      p0.z <= S3L_NEAR || p1.z <= S3L_NEAR || p2.z <= S3L_NEAR ||
+      p0.z <= S3L_NEAR || p1.z <= S3L_NEAR || p2.z <= S3L_NEAR
       // ^ partially in front of NEAR?
 #else
-      clipTest(z,<=,S3L_NEAR) || // completely in front of NEAR?
+      clipTest(z,<=,S3L_NEAR) // completely in front of NEAR?
 #endif
+    )
+  {
+    S3L_STATS_ADD(culledNear,1);
+    return 0;
+  }
+
+  if (
       clipTest(x,<,0) ||
       clipTest(x,>=,S3L_RESOLUTION_X) ||
       clipTest(y,<,0) ||
       clipTest(y,>,S3L_RESOLUTION_Y)
     )
+  {
+    S3L_STATS_ADD(culledFrustum,1);
     return 0;
+  }
 
   #undef clipTest
 
@@ -580,7 +807,10 @@ static inline int8_t S3L_triangleIsVisible(
 
     if ((backfaceCulling == 1 && winding > 0) ||
         (backfaceCulling == 2 && winding < 0))
+    {
+      S3L_STATS_ADD(culledBackface,1);
       return 0;
+    }
   }
 
   return 1;
@@ -695,6 +925,81 @@ static inline void _S3L_mapProjectedVertexToScreen(S3L_Vec4 *vertex, S3L_Unit fo
   vertex->y = sY;
 }
 
+/** Gets a vertex of a model as stored, i.e. still quantized for models with
+  quantized vertices (the dequantization is in the model matrix). */
+static inline void _S3L_getModelVertex(
+  const S3L_Model3D *model,
+  S3L_Index vertexIndex,
+  S3L_Vec4 *result)
+{
+  uint32_t i = vertexIndex * 3;
+
+#if S3L_QUANTIZED_VERTICES
+  if (model->quantizedVertices != 0)
+  {
+    result->x = model->quantizedVertices[i];
+    result->y = model->quantizedVertices[i + 1];
+    result->z = model->quantizedVertices[i + 2];
+    return;
+  }
+#endif
+
+  result->x = model->vertices[i];
+  result->y = model->vertices[i + 1];
+  result->z = model->vertices[i + 2];
+}
+
+/** Returns the position of triangle's vertex (0, 1 or 2) in the model's
+  index arrays (triangles and attribute indices). */
+static inline uint32_t _S3L_triangleVertexOffset(
+  const S3L_Model3D *model,
+  S3L_Index triangleIndex,
+  uint8_t vertex)
+{
+#if S3L_TRIANGLE_STRIPS
+  if (model->triangleStrip)
+    return triangleIndex +
+      (vertex == 2 ? 2 : (vertex ^ (triangleIndex & 0x01)));
+#else
+  S3L_UNUSED(model);
+#endif
+
+  return triangleIndex * 3 + vertex;
+}
+
+#if S3L_TRIANGLE_STRIPS
+/** Says whether a strip triangle is one of those joining separate strips. */
+static inline uint8_t _S3L_stripTriangleIsDegenerate(
+  const S3L_Model3D *model,
+  S3L_Index triangleIndex)
+{
+  const S3L_Index *t = model->triangles + triangleIndex;
+
+  return t[0] == t[1] || t[1] == t[2] || t[0] == t[2];
+}
+#endif
+
+#if S3L_VERTEX_CACHE_SIZE > 0
+#if S3L_VERTEX_CACHE_SIZE & (S3L_VERTEX_CACHE_SIZE - 1)
+  #error S3L_VERTEX_CACHE_SIZE has to be a power of two.
+#endif
+
+typedef struct
+{
+  S3L_Index index;
+  S3L_Vec4 vertex;
+} _S3L_VertexCacheEntry;
+
+static _S3L_VertexCacheEntry _S3L_vertexCache[S3L_VERTEX_CACHE_SIZE];
+
+/** Has to be called whenever the transform matrix changes. */
+static void _S3L_vertexCacheClear(void)
+{
+  for (uint16_t i = 0; i < S3L_VERTEX_CACHE_SIZE; ++i)
+    _S3L_vertexCache[i].index = (S3L_Index) ~0; // never a vertex index
+}
+#endif
+
 static inline void _S3L_projectVertex(
   const S3L_Model3D *model,
   S3L_Index triangleIndex,
@@ -702,18 +1007,76 @@ static inline void _S3L_projectVertex(
   S3L_Mat4 projectionMatrix, 
   S3L_Vec4 *result)
 {
-  uint32_t vertexIndex = model->triangles[triangleIndex * 3 + vertex] * 3;
+  S3L_Index index =
+    model->triangles[_S3L_triangleVertexOffset(model,triangleIndex,vertex)];
+
+#if S3L_VERTEX_CACHE_SIZE > 0
+  _S3L_VertexCacheEntry *entry =
+    _S3L_vertexCache + (index & (S3L_VERTEX_CACHE_SIZE - 1));
+
+  if (entry->index == index)
+  {
+    *result = entry->vertex;
+    return;
+  }
+#endif
+
+  _S3L_getModelVertex(model,index,result);
 
-  result->x = model->vertices[vertexIndex];
-  result->y = model->vertices[vertexIndex + 1];
-  result->z = model->vertices[vertexIndex + 2];
   result->w = S3L_FRACTIONS_PER_UNIT; // needed for translation 
  
   S3L_vec3Xmat4(result,projectionMatrix);
 
   result->w = result->z;
   /* We'll keep the non-clamped z in w for sorting. */ 
+
+#if S3L_VERTEX_CACHE_SIZE > 0
+  entry->index = index;
+  entry->vertex = *result;
+#endif
+}
+
+#if S3L_MAX_ATTRIBUTES > 0
+#if S3L_LIGHTING == 2
+  #define _S3L_MODEL_ATTRIBUTES (S3L_MAX_ATTRIBUTES - 1) // last is the light
+#else
+  #define _S3L_MODEL_ATTRIBUTES S3L_MAX_ATTRIBUTES
+#endif
+
+static void _S3L_fetchTriangleAttributes(
+  const S3L_Model3D *model,
+  S3L_Index triangleIndex)
+{
+  uint8_t component = 0;
+
+  for (uint8_t s = 0; s < model->attributeCount; ++s)
+  {
+    const S3L_AttributeStream *stream = &(model->attributes[s]);
+
+    const S3L_Index *indices =
+      stream->indices != 0 ? stream->indices : model->triangles;
+
+    uint8_t numComponents = stream->numComponents;
+
+    if (component + numComponents > _S3L_MODEL_ATTRIBUTES)
+      numComponents = _S3L_MODEL_ATTRIBUTES - component;
+
+    for (uint8_t v = 0; v < 3; ++v)
+    {
+      const S3L_Unit *value = stream->values +
+        indices[_S3L_triangleVertexOffset(model,triangleIndex,v)] *
+        stream->numComponents;
+
+      for (uint8_t c = 0; c < numComponents; ++c)
+        S3L_triangleAttributes[v][component + c] = value[c];
+    }
+
+    component += numComponents;
+  }
+
+  S3L_triangleAttributeCount = component;
 }
+#endif
 //function body-------------------------------------------------------------------------------
 
 S3L_Unit S3L_abs(S3L_Unit value)
@@ -758,28 +1121,32 @@ S3L_Unit S3L_interpolate(S3L_Unit v1, S3L_Unit v2, S3L_Unit t, S3L_Unit tMax)
 
 S3L_Unit S3L_sin(S3L_Unit x)
 {
-  x = S3L_wrap(x / S3L_SIN_TABLE_UNIT_STEP,S3L_SIN_TABLE_LENGTH * 4);
-  int8_t positive = 1;
+  x %= S3L_FRACTIONS_PER_UNIT;
 
-  if (x < S3L_SIN_TABLE_LENGTH)
-  {
-  }
-  else if (x < S3L_SIN_TABLE_LENGTH * 2)
-  {
-    x = S3L_SIN_TABLE_LENGTH * 2 - x - 1;
-  }
-  else if (x < S3L_SIN_TABLE_LENGTH * 3)
-  {
-    x = x - S3L_SIN_TABLE_LENGTH * 2;
-    positive = 0;
-  }
-  else
-  {
-    x = S3L_SIN_TABLE_LENGTH - (x - S3L_SIN_TABLE_LENGTH * 3) - 1;
-    positive = 0;
-  }
+  if (x < 0)
+    x += S3L_FRACTIONS_PER_UNIT;
+
+  int8_t positive = x < S3L_FRACTIONS_PER_UNIT / 2;
+
+  if (!positive)
+    x -= S3L_FRACTIONS_PER_UNIT / 2;
+
+  if (x > S3L_FRACTIONS_PER_UNIT / 4) // second quarter mirrors the first
+    x = S3L_FRACTIONS_PER_UNIT / 2 - x;
+
+  // position in the table in 1/256ths of the entries
+  uint32_t position = (((uint32_t) x) * (S3L_SIN_TABLE_LENGTH * 4 * 256)) /
+    S3L_FRACTIONS_PER_UNIT;
+
+  uint32_t index = position >> 8;
+  uint32_t value = S3L_sinTable[index];
+
+  if (position & 0xff) // not at an entry, interpolate
+    value += ((S3L_sinTable[index + 1] - value) * (position & 0xff)) >> 8;
+
+  S3L_Unit result = (value * S3L_FRACTIONS_PER_UNIT + (1 << 14)) >> 15;
 
-  return positive ? S3L_sinTable[x] : -1 * S3L_sinTable[x];
+  return positive ? result : -1 * result;
 }
 
 S3L_Unit S3L_asin(S3L_Unit x)
@@ -794,27 +1161,18 @@ S3L_Unit S3L_asin(S3L_Unit x)
     x *= -1;
   }
 
-  int16_t low = 0;
-  int16_t high = S3L_SIN_TABLE_LENGTH -1;
-  int16_t middle;
+  /* asin(x) = pi / 2 - sqrt(1 - x) * p(x) with a cubic p (Abramowitz and
+     Stegun 4.4.45), here in quarter turns with the coefficients of
+     p(x) / (pi / 2) in 1/4096ths. */
 
-  while (low <= high) // binary search
-  {
-    middle = (low + high) / 2;
-
-    S3L_Unit v = S3L_sinTable[middle];
-
-    if (v > x)
-      high = middle - 1;
-    else if (v < x)
-      low = middle + 1;
-    else
-      break;
-  }
+  S3L_Unit root = S3L_sqrt((S3L_FRACTIONS_PER_UNIT - x) *
+    S3L_FRACTIONS_PER_UNIT);
 
-  middle *= S3L_SIN_TABLE_UNIT_STEP;
+  S3L_Unit p = (-49 * x) / S3L_FRACTIONS_PER_UNIT + 194;
+  p = (p * x) / S3L_FRACTIONS_PER_UNIT - 553;
+  p = (p * x) / S3L_FRACTIONS_PER_UNIT + 4096;
 
-  return sign * middle;
+  return sign * (S3L_FRACTIONS_PER_UNIT / 4 - (root * p + 8192) / 16384);
 }
 
 S3L_Unit S3L_cos(S3L_Unit x)
@@ -832,24 +1190,32 @@ S3L_Unit S3L_sqrt(S3L_Unit value)
     value *= -1;
   }
 
-  uint32_t result = 0;
   uint32_t a = value;
-  uint32_t b = 1u << 30;
 
-  while (b > a)
-    b >>= 2;
+  if (a < 256)
+    return (_S3L_sqrtTable[a] >> 4) * sign;
 
-  while (b != 0)
-  {
-    if (a >= result + b)
-    {
-      a -= result + b;
-      result = result +  2 * b;
-    }
+  // seed from the top 7 or 8 bits (shifted by an even number of bits)
+  uint32_t top = a;
+  uint8_t bits = 1;
 
-    b >>= 2;
-    result >>= 1;
-  }
+  if (top >> 16) { top >>= 16; bits += 16; }
+  if (top >> 8) { top >>= 8; bits += 8; }
+  if (top >> 4) { top >>= 4; bits += 4; }
+  if (top >> 2) { top >>= 2; bits += 2; }
+  if (top >> 1) bits++;
+
+  uint8_t shift = (bits - 7) & ~1;
+
+  uint32_t result =
+    ((_S3L_sqrtTable[a >> shift] + 1u) << (shift / 2)) >> 4;
+
+  /* An integer Newton step never gets below floor(sqrt(a)), and from the
+     seed (within a few percent) at most 2 above it. */
+  result = (result + a / result) / 2;
+
+  while (result * result > a)
+    result--;
 
   return result * sign;
 }
@@ -891,7 +1257,28 @@ S3L_Unit S3L_vec3Length(S3L_Vec4 v)
   return S3L_sqrt(v.x * v.x + v.y * v.y + v.z * v.z);  
 }
 
+/** Sets the vector to v * S3L_FRACTIONS_PER_UNIT / l (l > 0) with a single
+  division: each component is multiplied by the reciprocal of l, which is
+  at most 1 below the quotient, and corrected. The result is exactly that of
+  dividing each component. */
+static void _S3L_divideVec3(S3L_Vec4 *v, S3L_Unit l)
+{
+  uint32_t reciprocal = 0xffffffff / ((uint32_t) l);
+
+  #define divide(c)\
+    {\
+      uint32_t n = S3L_abs(c) * S3L_FRACTIONS_PER_UNIT;\
+      uint32_t q = (((uint64_t) n) * reciprocal) >> 32;\
+      q += (q + 1) * l <= n;\
+      c = c < 0 ? -1 * ((S3L_Unit) q) : (S3L_Unit) q;\
+    }
 
+  divide(v->x)
+  divide(v->y)
+  divide(v->z)
+
+  #undef divide
+}
 
 void S3L_normalizeVec3Fast(S3L_Vec4 *v)
 {
@@ -900,9 +1287,7 @@ void S3L_normalizeVec3Fast(S3L_Vec4 *v)
   if (l == 0)
     return;
 
-  v->x = (v->x * S3L_FRACTIONS_PER_UNIT) / l;
-  v->y = (v->y * S3L_FRACTIONS_PER_UNIT) / l;
-  v->z = (v->z * S3L_FRACTIONS_PER_UNIT) / l;
+  _S3L_divideVec3(v,l);
 }
 
 void S3L_normalizeVec3(S3L_Vec4 *v)
@@ -944,9 +1329,7 @@ void S3L_normalizeVec3(S3L_Vec4 *v)
   if (l == 0)
     return;
 
-  v->x = (v->x * S3L_FRACTIONS_PER_UNIT) / l;
-  v->y = (v->y * S3L_FRACTIONS_PER_UNIT) / l;
-  v->z = (v->z * S3L_FRACTIONS_PER_UNIT) / l;
+  _S3L_divideVec3(v,l);
 }
 
 void S3L_initMat4(S3L_Mat4 m)
@@ -1169,7 +1552,10 @@ S3L_Unit S3L_zBufferRead(S3L_ScreenCoord x, S3L_ScreenCoord y)
 
 void S3L_zBufferClear(void)
 {
-#if S3L_Z_BUFFER
+#if S3L_Z_BUFFER == 1
+  S3L_CLEAR_FUNCTION((uint32_t *) S3L_zBuffer,S3L_MAX_DEPTH,
+    S3L_RESOLUTION_X * S3L_RESOLUTION_Y);
+#elif S3L_Z_BUFFER
   for (uint32_t i = 0; i < S3L_RESOLUTION_X * S3L_RESOLUTION_Y; ++i)
     S3L_zBuffer[i] = S3L_MAX_DEPTH;
 #endif
@@ -1385,6 +1771,92 @@ void S3L_initDrawConfig(S3L_DrawConfig *config)
   config->visible = 1;
 }
 
+/** Makes the matrix transforming model's vertices (as stored) to world
+  space, i.e. the world (or custom) matrix with dequantization. */
+static void _S3L_makeModelMatrix(const S3L_Model3D *model, S3L_Mat4 m)
+{
+  if (model->customTransformMatrix == 0)
+    S3L_makeWorldMatrix(model->transform,m);
+  else
+  {
+    for (int8_t j = 0; j < 4; ++j)
+      for (int8_t i = 0; i < 4; ++i)
+         m[i][j] = (*model->customTransformMatrix)[i][j];
+  }
+
+#if S3L_QUANTIZED_VERTICES
+  if (model->quantizedVertices != 0)
+  {
+    S3L_Mat4 q, t;
+
+    S3L_makeScaleMatrix(
+      model->quantizationScale.x,
+      model->quantizationScale.y,
+      model->quantizationScale.z,
+      q);
+
+    S3L_makeTranslationMat(
+      model->quantizationOffset.x,
+      model->quantizationOffset.y,
+      model->quantizationOffset.z,
+      t);
+
+    S3L_mat4Xmat4(q,t);
+    S3L_mat4Xmat4(q,m);
+
+    for (int8_t j = 0; j < 4; ++j)
+      for (int8_t i = 0; i < 4; ++i)
+         m[i][j] = q[i][j];
+  }
+#endif
+}
+
+#if S3L_QUANTIZED_VERTICES
+void S3L_quantizeVertices(
+  const S3L_Unit *vertices,
+  S3L_Index vertexCount,
+  int16_t *result,
+  S3L_Vec4 *scale,
+  S3L_Vec4 *offset)
+{
+  S3L_Unit *s = &(scale->x), *o = &(offset->x);
+
+  for (uint8_t c = 0; c < 3; ++c)
+  {
+    S3L_Unit minimum = vertices[c], maximum = vertices[c];
+
+    for (S3L_Index i = 1; i < vertexCount; ++i)
+    {
+      minimum = S3L_min(minimum,vertices[i * 3 + c]);
+      maximum = S3L_max(maximum,vertices[i * 3 + c]);
+    }
+
+    o[c] = minimum + (maximum - minimum) / 2;
+
+    /* The finest step for which the half range fits into int16_t, but not
+       finer than one S3L_Unit (S3L_FRACTIONS_PER_UNIT): the input can't have
+       more precision and smaller scales would lose precision in the folded
+       matrix. */
+    s[c] = S3L_max(S3L_FRACTIONS_PER_UNIT,
+      (((int64_t) (maximum - o[c])) * S3L_FRACTIONS_PER_UNIT + 32766) / 32767);
+
+    for (S3L_Index i = 0; i < vertexCount; ++i)
+    {
+      int64_t d = ((int64_t) (vertices[i * 3 + c] - o[c])) *
+        S3L_FRACTIONS_PER_UNIT;
+
+      // round to nearest
+      d = d >= 0 ? (d + s[c] / 2) / s[c] : -((-d + s[c] / 2) / s[c]);
+
+      result[i * 3 + c] = S3L_clamp(d,-32767,32767);
+    }
+  }
+
+  scale->w = S3L_FRACTIONS_PER_UNIT;
+  offset->w = 0;
+}
+#endif
+
 void S3L_initModel3D(
   const S3L_Unit *vertices,
   S3L_Index vertexCount,
@@ -1398,9 +1870,30 @@ void S3L_initModel3D(
   model->triangleCount = triangleCount;
   model->customTransformMatrix = 0;  
 
-  S3L_initTransform3D(&(model->transform));
-  S3L_initDrawConfig(&(model->config));
-}
+#if S3L_MAX_ATTRIBUTES > 0
+  model->attributes = 0;
+  model->attributeCount = 0;
+#endif
+
+#if S3L_QUANTIZED_VERTICES
+  model->quantizedVertices = 0;
+  S3L_setVec4(&(model->quantizationScale),S3L_FRACTIONS_PER_UNIT,
+    S3L_FRACTIONS_PER_UNIT,S3L_FRACTIONS_PER_UNIT,S3L_FRACTIONS_PER_UNIT);
+  S3L_initVec4(&(model->quantizationOffset));
+#endif
+
+#if S3L_TRIANGLE_STRIPS
+  model->triangleStrip = 0;
+#endif
+
+#if S3L_LIGHTING
+  model->normals = 0;
+  model->normalIndices = 0;
+#endif
+
+  S3L_initTransform3D(&(model->transform));
+  S3L_initDrawConfig(&(model->config));
+}
 
 void S3L_initScene(
   S3L_Model3D *models,
@@ -1410,6 +1903,12 @@ void S3L_initScene(
   scene->models = models;
   scene->modelCount = modelCount;
   S3L_initCamera(&(scene->camera));
+
+#if S3L_LIGHTING
+  scene->lights = 0;
+  scene->lightCount = 0;
+  scene->ambientLight = S3L_FRACTIONS_PER_UNIT;
+#endif
 }
 
 void project3DPointToScreen(
@@ -1449,20 +1948,36 @@ void project3DPointToScreen(
 
 void S3L_triangleNormal(S3L_Vec4 t0, S3L_Vec4 t1, S3L_Vec4 t2, S3L_Vec4 *n)
 {
-  #define ANTI_OVERFLOW 32
+  S3L_vec3Sub(&t1,t0);
+  S3L_vec3Sub(&t2,t0);
 
-  t1.x = (t1.x - t0.x) / ANTI_OVERFLOW;
-  t1.y = (t1.y - t0.y) / ANTI_OVERFLOW;
-  t1.z = (t1.z - t0.z) / ANTI_OVERFLOW;
+  /* Only scale the edges down as much as needed for the cross product not to
+     overflow, small triangles would lose precision otherwise. */
 
-  t2.x = (t2.x - t0.x) / ANTI_OVERFLOW;
-  t2.y = (t2.y - t0.y) / ANTI_OVERFLOW;
-  t2.z = (t2.z - t0.z) / ANTI_OVERFLOW;
+  #define big(v) ((v).x > 0x3fff || (v).x < -0x3fff ||\
+    (v).y > 0x3fff || (v).y < -0x3fff || (v).z > 0x3fff || (v).z < -0x3fff)
 
-  #undef ANTI_OVERFLOW
+  while (big(t1) || big(t2))
+  {
+    t1.x /= 2;
+    t1.y /= 2;
+    t1.z /= 2;
+    t2.x /= 2;
+    t2.y /= 2;
+    t2.z /= 2;
+  }
 
   S3L_crossProduct(t1,t2,n);
 
+  while (big(*n))
+  {
+    n->x /= 2;
+    n->y /= 2;
+    n->z /= 2;
+  }
+
+  #undef big
+
   S3L_normalizeVec3(n);
 }
 
@@ -1515,87 +2030,114 @@ void S3L_getIndexedTriangleValues(
   }
 }
 
+/** Converts a vertex got by _S3L_getModelVertex to model space. */
+static inline void _S3L_dequantizeVertex(const S3L_Model3D *model,
+  S3L_Vec4 *v)
+{
+#if S3L_QUANTIZED_VERTICES
+  if (model->quantizedVertices != 0)
+  {
+    v->x = model->quantizationOffset.x +
+      (v->x * model->quantizationScale.x) / S3L_FRACTIONS_PER_UNIT;
+    v->y = model->quantizationOffset.y +
+      (v->y * model->quantizationScale.y) / S3L_FRACTIONS_PER_UNIT;
+    v->z = model->quantizationOffset.z +
+      (v->z * model->quantizationScale.z) / S3L_FRACTIONS_PER_UNIT;
+  }
+#else
+  S3L_UNUSED(model);
+  S3L_UNUSED(v);
+#endif
+}
+
+uint8_t S3L_getModelTriangle(
+  const S3L_Model3D *model,
+  S3L_Index triangleIndex,
+  S3L_Index result[3])
+{
+  for (uint8_t i = 0; i < 3; ++i)
+    result[i] =
+      model->triangles[_S3L_triangleVertexOffset(model,triangleIndex,i)];
+
+#if S3L_TRIANGLE_STRIPS
+  if (model->triangleStrip &&
+    _S3L_stripTriangleIsDegenerate(model,triangleIndex))
+    return 0;
+#endif
+
+  return 1;
+}
+
+void S3L_getModelVertex(
+  const S3L_Model3D *model,
+  S3L_Index vertexIndex,
+  S3L_Vec4 *result)
+{
+  _S3L_getModelVertex(model,vertexIndex,result);
+  _S3L_dequantizeVertex(model,result);
+  result->w = S3L_FRACTIONS_PER_UNIT;
+}
+
 void S3L_computeModelNormals(S3L_Model3D model, S3L_Unit *dst,
   int8_t transformNormals)
 {
-  S3L_Index vPos = 0;
-
   S3L_Vec4 n;
 
   n.w = 0;
 
-  S3L_Vec4 ns[S3L_NORMAL_COMPUTE_MAXIMUM_AVERAGE];
-  S3L_Index normalCount;
+  for (uint32_t i = 0; i < model.vertexCount * 3; ++i)
+    dst[i] = 0;
 
-  for (uint32_t i = 0; i < model.vertexCount; ++i)
+  /* Instead of searching triangles of each vertex, add each triangle's normal
+     to its vertices' normals, which is linear in vertices + triangles. */
+
+  for (S3L_Index i = 0; i < model.triangleCount; ++i)
   {
-    normalCount = 0;
+    S3L_Index t[3];
+    S3L_Vec4 t0, t1, t2;
 
-    for (uint32_t j = 0; j < model.triangleCount * 3; j += 3)
-    {
-      if (
-        (model.triangles[j] == i) ||
-        (model.triangles[j + 1] == i) ||
-        (model.triangles[j + 2] == i))
-      {    
-        S3L_Vec4 t0, t1, t2;
-        uint32_t vIndex;
-
-        #define getVertex(n)\
-          vIndex = model.triangles[j + n] * 3;\
-          t##n.x = model.vertices[vIndex];\
-          vIndex++;\
-          t##n.y = model.vertices[vIndex];\
-          vIndex++;\
-          t##n.z = model.vertices[vIndex];
-
-        getVertex(0)
-        getVertex(1)
-        getVertex(2)
-
-        #undef getVertex
-        
-        S3L_triangleNormal(t0,t1,t2,&(ns[normalCount]));    
+    if (!S3L_getModelTriangle(&model,i,t))
+      continue;
 
-        normalCount++;
+    S3L_getModelVertex(&model,t[0],&t0);
+    S3L_getModelVertex(&model,t[1],&t1);
+    S3L_getModelVertex(&model,t[2],&t2);
 
-        if (normalCount >= S3L_NORMAL_COMPUTE_MAXIMUM_AVERAGE)
-          break;
-      }
-    }
-      
-    n.x = S3L_FRACTIONS_PER_UNIT;
-    n.y = 0;
-    n.z = 0;
+    S3L_triangleNormal(t0,t1,t2,&n);
 
-    if (normalCount != 0)
+    for (uint8_t j = 0; j < 3; ++j)
     {
-      // compute average
+      S3L_Unit *d = dst + t[j] * 3;
+
+      d[0] += n.x;
+      d[1] += n.y;
+      d[2] += n.z;
+    }
+  }
 
-      n.x = 0;
+  for (uint32_t i = 0; i < model.vertexCount * 3; i += 3)
+  {
+    S3L_setVec4(&n,dst[i],dst[i + 1],dst[i + 2],0);
 
-      for (uint8_t i = 0; i < normalCount; ++i)
+    if (n.x == 0 && n.y == 0 && n.z == 0)
+      n.x = S3L_FRACTIONS_PER_UNIT; // vertex without triangles
+    else
+    {
+      // keep the squared length from overflowing
+      while (S3L_abs(n.x) > 0x3fff || S3L_abs(n.y) > 0x3fff ||
+        S3L_abs(n.z) > 0x3fff)
       {
-        n.x += ns[i].x;
-        n.y += ns[i].y;
-        n.z += ns[i].z;
+        n.x /= 2;
+        n.y /= 2;
+        n.z /= 2;
       }
 
-      n.x /= normalCount;
-      n.y /= normalCount;
-      n.z /= normalCount;
-
-      S3L_normalizeVec3(&n);
+      S3L_normalizeVec3Fast(&n);
     }
 
-    dst[vPos] = n.x;
-    vPos++;
-
-    dst[vPos] = n.y;
-    vPos++;
-
-    dst[vPos] = n.z;
-    vPos++;
+    dst[i] = n.x;
+    dst[i + 1] = n.y;
+    dst[i + 2] = n.z;
   }
     
   S3L_Mat4 m;
@@ -1619,10 +2161,242 @@ void S3L_computeModelNormals(S3L_Model3D model, S3L_Unit *dst,
 
 
 
+#if S3L_LIGHTING
+/* Lights of the scene in the space of the model being drawn, so that lighting
+   a vertex doesn't have to transform its normal or position. */
+
+typedef struct
+{
+  uint8_t type;
+  S3L_Vec4 vector;    ///< normalized direction to the light or its position
+  S3L_Unit intensity;
+  S3L_Unit rangeStep; ///< range / S3L_FRACTIONS_PER_UNIT, in model space
+} _S3L_ModelLight;
+
+static _S3L_ModelLight _S3L_modelLights[S3L_MAX_LIGHTS];
+static uint8_t _S3L_modelLightCount = 0;
+static S3L_Unit _S3L_ambientLight = S3L_FRACTIONS_PER_UNIT;
+
+#if S3L_LIGHTING == 1
+static S3L_Unit _S3L_triangleIntensity = S3L_FRACTIONS_PER_UNIT;
+#endif
+
+/** Transforms the scene's lights to the model's space, has to be called
+  whenever the model changes. Directions are transformed by the transposed
+  world matrix and positions by its inverse, which is exact for rotation and
+  uniform scale (non-uniform scale makes the lighting approximate). */
+static void _S3L_setupModelLights(
+  const S3L_Scene *scene,
+  const S3L_Model3D *model)
+{
+  S3L_Mat4 m;
+
+  if (model->customTransformMatrix == 0)
+    S3L_makeWorldMatrix(model->transform,m);
+  else
+    S3L_copyMat4(*model->customTransformMatrix,m);
+
+  // squared scale (times S3L_FRACTIONS_PER_UNIT^2), from the first column
+  int64_t scale2 = 0;
+
+  for (uint8_t i = 0; i < 3; ++i)
+    scale2 += ((int64_t) m[i][0]) * m[i][0];
+
+  if (scale2 == 0)
+    scale2 = 1;
+
+  S3L_Unit scale = scale2 <= 0x7fffffff ? S3L_sqrt(scale2) :
+    S3L_sqrt(scale2 >> 8) * 16;
+
+  _S3L_modelLightCount = 0;
+  _S3L_ambientLight = scene->ambientLight;
+
+  for (uint8_t l = 0; l < scene->lightCount && l < S3L_MAX_LIGHTS; ++l)
+  {
+    const S3L_Light *light = scene->lights + l;
+    _S3L_ModelLight *result = _S3L_modelLights + _S3L_modelLightCount;
+
+    S3L_Unit v[3];
+
+    v[0] = light->vector.x;
+    v[1] = light->vector.y;
+    v[2] = light->vector.z;
+
+    if (light->type == S3L_LIGHT_POINT)
+      for (uint8_t i = 0; i < 3; ++i)
+        v[i] -= m[i][3];
+
+    int64_t t[3];
+
+    for (uint8_t i = 0; i < 3; ++i)
+      t[i] = ((int64_t) m[0][i]) * v[0] + ((int64_t) m[1][i]) * v[1] +
+        ((int64_t) m[2][i]) * v[2];
+
+    result->type = light->type;
+    result->intensity = light->intensity;
+
+    if (light->type == S3L_LIGHT_POINT)
+    {
+      result->vector.x = (t[0] * S3L_FRACTIONS_PER_UNIT) / scale2;
+      result->vector.y = (t[1] * S3L_FRACTIONS_PER_UNIT) / scale2;
+      result->vector.z = (t[2] * S3L_FRACTIONS_PER_UNIT) / scale2;
+      result->rangeStep = S3L_nonZero((S3L_Unit)
+        (((int64_t) light->range) / scale));
+    }
+    else
+    {
+      // to the light, i.e. against the direction it shines in
+      while (t[0] > 0x3fff || t[0] < -0x3fff ||
+        t[1] > 0x3fff || t[1] < -0x3fff ||
+        t[2] > 0x3fff || t[2] < -0x3fff)
+      {
+        t[0] /= 2;
+        t[1] /= 2;
+        t[2] /= 2;
+      }
+
+      S3L_setVec4(&(result->vector),-t[0],-t[1],-t[2],0);
+      S3L_normalizeVec3Fast(&(result->vector));
+      result->rangeStep = 0;
+    }
+
+    _S3L_modelLightCount++;
+  }
+}
+
+/** Computes the light intensity at a point (in model space) with given
+  normal. */
+static S3L_Unit _S3L_lightPoint(const S3L_Vec4 *point, const S3L_Vec4 *normal)
+{
+  S3L_Unit result = _S3L_ambientLight;
+
+  for (uint8_t l = 0; l < _S3L_modelLightCount; ++l)
+  {
+    const _S3L_ModelLight *light = _S3L_modelLights + l;
+    S3L_Unit d;
+
+    if (light->type == S3L_LIGHT_DIRECTIONAL)
+      d = S3L_dotProductVec3(*normal,light->vector);
+    else
+    {
+      S3L_Vec4 toLight = light->vector;
+
+      S3L_vec3Sub(&toLight,*point);
+
+      uint8_t shift = 0;
+
+      // scale down so that squaring doesn't overflow
+      while (toLight.x > 0x3fff || toLight.x < -0x3fff ||
+        toLight.y > 0x3fff || toLight.y < -0x3fff ||
+        toLight.z > 0x3fff || toLight.z < -0x3fff)
+      {
+        toLight.x /= 2;
+        toLight.y /= 2;
+        toLight.z /= 2;
+        shift++;
+      }
+
+      if (shift > 16) // surely out of range, would overflow below
+        continue;
+
+      S3L_Unit distance = S3L_nonZero(S3L_vec3Length(toLight));
+
+      S3L_Unit falloff = S3L_FRACTIONS_PER_UNIT -
+        (distance << shift) / light->rangeStep;
+
+      if (falloff <= 0)
+        continue;
+
+      d = ((normal->x * toLight.x + normal->y * toLight.y +
+        normal->z * toLight.z) / distance) * falloff / S3L_FRACTIONS_PER_UNIT;
+    }
+
+    if (d > 0)
+      result += (d * light->intensity) / S3L_FRACTIONS_PER_UNIT;
+  }
+
+  return S3L_clamp(result,0,S3L_FRACTIONS_PER_UNIT);
+}
+
+/** Lights a triangle of the model whose lights have been set up: the
+  intensity is written to _S3L_triangleIntensity (S3L_LIGHTING 1) or appended
+  to S3L_triangleAttributes (S3L_LIGHTING 2, after the attributes have been
+  fetched). */
+static void _S3L_lightTriangle(
+  const S3L_Model3D *model,
+  S3L_Index triangleIndex)
+{
+  S3L_Vec4 points[3];
+  S3L_Unit intensities[3];
+
+  for (uint8_t i = 0; i < 3; ++i)
+    S3L_getModelVertex(model,
+      model->triangles[_S3L_triangleVertexOffset(model,triangleIndex,i)],
+      &(points[i]));
+
+  if (model->normals != 0)
+  {
+    const S3L_Index *indices = model->normalIndices != 0 ?
+      model->normalIndices : model->triangles;
+
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+      const S3L_Unit *n = model->normals +
+        indices[_S3L_triangleVertexOffset(model,triangleIndex,i)] * 3;
+
+      S3L_Vec4 normal;
+
+      S3L_setVec4(&normal,n[0],n[1],n[2],0);
+
+      intensities[i] = _S3L_lightPoint(&(points[i]),&normal);
+    }
+  }
+  else
+  {
+    S3L_Vec4 normal, center;
+
+    S3L_triangleNormal(points[0],points[1],points[2],&normal);
+
+    // lighting normals point out of the front side, S3L_triangleNormal's back
+    normal.x *= -1;
+    normal.y *= -1;
+    normal.z *= -1;
+
+    S3L_setVec4(&center,
+      (points[0].x + points[1].x + points[2].x) / 3,
+      (points[0].y + points[1].y + points[2].y) / 3,
+      (points[0].z + points[1].z + points[2].z) / 3,
+      S3L_FRACTIONS_PER_UNIT);
+
+    intensities[0] = _S3L_lightPoint(&center,&normal);
+    intensities[1] = intensities[0];
+    intensities[2] = intensities[0];
+  }
+
+#if S3L_LIGHTING == 1
+  _S3L_triangleIntensity =
+    (intensities[0] + intensities[1] + intensities[2]) / 3;
+#else
+  for (uint8_t i = 0; i < 3; ++i)
+    S3L_triangleAttributes[i][S3L_triangleAttributeCount] = intensities[i];
+
+  S3L_triangleAttributeCount++;
+#endif
+}
+#endif
+
 #ifndef S3L_PIXEL_FUNCTION
   #error Pixel rendering function (S3L_PIXEL_FUNCTION) not specified!
 #endif
 
+#ifdef S3L_SPAN_FUNCTION
+  #if S3L_PERSPECTIVE_CORRECTION || S3L_FLAT || S3L_VISIBILITY_BUFFER ||\
+    S3L_STENCIL_BUFFER
+    #error S3L_SPAN_FUNCTION only works with affine, non-flat rendering\
+           without visibility and stencil buffer!
+  #endif
+#endif
+
 
 
 #define S3L_getFastLerpValue(state)\
@@ -1644,6 +2418,22 @@ void S3L_drawTriangle(
   p.triangleIndex = triangleIndex;
   p.triangleID = (modelIndex << 16) | triangleIndex;
 
+#if S3L_VISIBILITY_BUFFER
+  if (_S3L_visibleTriangleCount >= S3L_VISIBILITY_TRIANGLES)
+  {
+    S3L_STATS_ADD(dropped,1);
+    return;
+  }
+
+  const uint16_t visibleTriangle = _S3L_visibleTriangleCount;
+
+  _S3L_visibleTriangles[visibleTriangle].triangleID = p.triangleID;
+  _S3L_visibleTriangleCount++;
+#endif
+
+  S3L_STATS_ADD(rasterized,1);
+  S3L_PROFILE_TRIANGLE_BEGIN(rasterizationStart);
+
   S3L_Vec4 *tPointSS, *lPointSS, *rPointSS; /* points in Screen Space (in
                                                S3L_Units, normalized by
                                                S3L_FRACTIONS_PER_UNIT) */
@@ -1654,6 +2444,19 @@ void S3L_drawTriangle(
 
   // sort the vertices:
 
+#if S3L_LERP_ATTRIBUTES
+  const S3L_Unit *tAttributes, *lAttributes, *rAttributes; /* per-vertex
+                                               attribute values of the
+                                               points */
+
+  #define assignAttributes(t,l,r)\
+    tAttributes = S3L_triangleAttributes[t];\
+    lAttributes = S3L_triangleAttributes[l];\
+    rAttributes = S3L_triangleAttributes[r];
+#else
+  #define assignAttributes(t,l,r) ;
+#endif
+
   #define assignPoints(t,a,b)\
     {\
       tPointSS = &point##t;\
@@ -1664,12 +2467,14 @@ void S3L_drawTriangle(
         lPointSS = &point##a; rPointSS = &point##b;\
         barycentric0 = &(p.barycentric[b]);\
         barycentric1 = &(p.barycentric[a]);\
+        assignAttributes(t,a,b)\
       }\
       else\
       {\
         lPointSS = &point##b; rPointSS = &point##a;\
         barycentric0 = &(p.barycentric[a]);\
         barycentric1 = &(p.barycentric[b]);\
+        assignAttributes(t,b,a)\
       }\
     }
 
@@ -1689,17 +2494,74 @@ void S3L_drawTriangle(
   }
 
   #undef assignPoints
+  #undef assignAttributes
 
 #if S3L_FLAT
   *barycentric0 = S3L_FRACTIONS_PER_UNIT / 3;
   *barycentric1 = S3L_FRACTIONS_PER_UNIT / 3;
   *barycentric2 = S3L_FRACTIONS_PER_UNIT - 2 * (S3L_FRACTIONS_PER_UNIT / 3);
+
+  #if S3L_BARYCENTRIC_ATTRIBUTES
+  for (uint8_t a = 0; a < S3L_triangleAttributeCount; ++a)
+    p.attributes[a] = S3L_interpolateBarycentric(
+      S3L_triangleAttributes[0][a],
+      S3L_triangleAttributes[1][a],
+      S3L_triangleAttributes[2][a],
+      p.barycentric);
+  #endif
 #endif
 
   p.triangleSize[0] = rPointSS->x - lPointSS->x;
   p.triangleSize[1] =
     (rPointSS->y > lPointSS->y ? rPointSS->y : lPointSS->y) - tPointSS->y;
 
+#if S3L_VISIBILITY_BUFFER
+  _S3L_visibleTriangles[visibleTriangle].size[0] = p.triangleSize[0];
+  _S3L_visibleTriangles[visibleTriangle].size[1] = p.triangleSize[1];
+#endif
+
+#if S3L_LIGHTING == 1
+  p.intensity = _S3L_triangleIntensity;
+#endif
+
+#ifdef S3L_SPAN_FUNCTION
+  S3L_SpanInfo span;
+
+  span.modelIndex = modelIndex;
+  span.triangleIndex = triangleIndex;
+  span.triangleID = p.triangleID;
+
+  #if S3L_LIGHTING == 1
+  span.intensity = p.intensity;
+  #endif
+
+  #if !S3L_COMPUTE_LERP_DEPTH
+  span.depthScaled = ((tPointSS->z + lPointSS->z + rPointSS->z) / 3)
+    << S3L_FAST_LERP_QUALITY;
+  span.depthStepScaled = 0;
+  #endif
+#endif
+
+#if defined(S3L_TRIANGLE_FUNCTION) && !S3L_VISIBILITY_BUFFER
+  // with the visibility buffer this is called by the resolve
+  S3L_TriangleInfo triangleInfo;
+
+  triangleInfo.modelIndex = modelIndex;
+  triangleInfo.triangleIndex = triangleIndex;
+  triangleInfo.triangleID = p.triangleID;
+  triangleInfo.points[0] = point0;
+  triangleInfo.points[1] = point1;
+  triangleInfo.points[2] = point2;
+  triangleInfo.triangleSize[0] = p.triangleSize[0];
+  triangleInfo.triangleSize[1] = p.triangleSize[1];
+
+  #if S3L_LIGHTING == 1
+  triangleInfo.intensity = p.intensity;
+  #endif
+
+  S3L_PROFILE_SHADING(S3L_TRIANGLE_FUNCTION(&triangleInfo));
+#endif
+
   // now draw the triangle line by line:
 
   S3L_ScreenCoord splitY; // Y of the vertically middle point of the triangle
@@ -1766,6 +2628,25 @@ void S3L_drawTriangle(
   #define initDepthFLS(s,p1,p2) ;
 #endif
 
+#if S3L_LERP_ATTRIBUTES
+  uint8_t attributeCount = S3L_triangleAttributeCount;
+  S3L_FastLerpState
+    lAttributeFLS[S3L_MAX_ATTRIBUTES],
+    rAttributeFLS[S3L_MAX_ATTRIBUTES];
+
+  #define initAttributeFLS(s,p1,p2)\
+    for (uint8_t a = 0; a < attributeCount; ++a)\
+    {\
+      s##AttributeFLS[a].valueScaled =\
+        p1##Attributes[a] << S3L_FAST_LERP_QUALITY;\
+      s##AttributeFLS[a].stepScaled =\
+        ((p2##Attributes[a] << S3L_FAST_LERP_QUALITY) -\
+        s##AttributeFLS[a].valueScaled) / (s##Dy != 0 ? s##Dy : 1);\
+    }
+#else
+  #define initAttributeFLS(s,p1,p2) ;
+#endif
+
   /* init side for the algorithm, params:
      s - which side (l or r)
      p1 - point from (t, l or r)
@@ -1776,6 +2657,7 @@ void S3L_drawTriangle(
     s##Dx = p2##PointSS->x - p1##PointSS->x;\
     s##Dy = p2##PointSS->y - p1##PointSS->y;\
     initDepthFLS(s,p1,p2)\
+    initAttributeFLS(s,p1,p2)\
     s##SideFLS.stepScaled = (S3L_FRACTIONS_PER_UNIT << S3L_FAST_LERP_QUALITY)\
                       / (s##Dy != 0 ? s##Dy : 1);\
     s##SideFLS.valueScaled = 0;\
@@ -1828,15 +2710,36 @@ void S3L_drawTriangle(
     lRecip0, lRecip1, rRecip0, rRecip1;       /* Helper variables for swapping
                                                  the above after split. */
 
-  tPointRecipZ = Z_RECIP_NUMERATOR / S3L_nonZero(tPointSS->z);
-  lPointRecipZ = Z_RECIP_NUMERATOR / S3L_nonZero(lPointSS->z);
-  rPointRecipZ = Z_RECIP_NUMERATOR / S3L_nonZero(rPointSS->z);
+  tPointRecipZ = _S3L_divide(Z_RECIP_NUMERATOR,S3L_nonZero(tPointSS->z));
+  lPointRecipZ = _S3L_divide(Z_RECIP_NUMERATOR,S3L_nonZero(lPointSS->z));
+  rPointRecipZ = _S3L_divide(Z_RECIP_NUMERATOR,S3L_nonZero(rPointSS->z));
 
   lRecip0 = tPointRecipZ;
   lRecip1 = lPointRecipZ;
   rRecip0 = tPointRecipZ;
   rRecip1 = rPointRecipZ;
 
+  #if S3L_PERSPECTIVE_CORRECTION == 2
+  S3L_Unit pcLength = S3L_PC_APPROX_LENGTH; // length of row segments
+
+    #if S3L_PC_MIN_APPROX_LENGTH < S3L_PC_APPROX_LENGTH
+  {
+    S3L_Unit zMin = S3L_min(tPointSS->z,S3L_min(lPointSS->z,rPointSS->z));
+    S3L_Unit zDiff =
+      S3L_max(tPointSS->z,S3L_max(lPointSS->z,rPointSS->z)) - zMin;
+
+    /* The error of linear interpolation grows with the relative change of
+       depth, so halve the segment for each doubling of it above 1/4. */
+
+    while (pcLength > S3L_PC_MIN_APPROX_LENGTH && zDiff * 4 > zMin)
+    {
+      pcLength /= 2;
+      zDiff /= 2;
+    }
+  }
+    #endif
+  #endif
+
   #define manageSplitPerspective(b0,b1)\
     b1##Recip0 = b0##PointRecipZ;\
     b1##Recip1 = b1##PointRecipZ;\
@@ -1922,6 +2825,18 @@ void S3L_drawTriangle(
 
       b0FLS.stepScaled = rSideFLS.valueScaled / rowLength;
       b1FLS.stepScaled = -1 * lSideFLS.valueScaled / rowLength;
+
+    #if S3L_LERP_ATTRIBUTES
+      S3L_FastLerpState attributeFLS[S3L_MAX_ATTRIBUTES];
+
+      for (uint8_t a = 0; a < attributeCount; ++a)
+      {
+        attributeFLS[a].valueScaled = lAttributeFLS[a].valueScaled;
+        attributeFLS[a].stepScaled =
+          (rAttributeFLS[a].valueScaled - lAttributeFLS[a].valueScaled) /
+          rowLength;
+      }
+    #endif
   #endif
 #endif
 
@@ -1941,6 +2856,11 @@ void S3L_drawTriangle(
   #if S3L_COMPUTE_LERP_DEPTH
         depthFLS.valueScaled -= lX * depthFLS.stepScaled;
   #endif
+
+  #if S3L_LERP_ATTRIBUTES
+        for (uint8_t a = 0; a < attributeCount; ++a)
+          attributeFLS[a].valueScaled -= lX * attributeFLS[a].stepScaled;
+  #endif
 #endif
       }
 
@@ -1957,11 +2877,11 @@ void S3L_drawTriangle(
         b1PC;    // interpolates barycentric1 between row segments
 
       /* ^ These interpolate values between row segments (lines of pixels
-           of S3L_PC_APPROX_LENGTH length). After each row segment perspective
-           correction is recomputed. */
+           of pcLength length). After each row segment perspective correction
+           is recomputed. */
 
       depthPC.valueScaled = 
-        (Z_RECIP_NUMERATOR / 
+        _S3L_divide(Z_RECIP_NUMERATOR,
         S3L_nonZero(S3L_interpolate(lRecipZ,rRecipZ,i,rowLength)))
         << S3L_FAST_LERP_QUALITY;
 
@@ -1977,12 +2897,70 @@ void S3L_drawTriangle(
              * depthPC.valueScaled
            ) / (Z_RECIP_NUMERATOR / S3L_FRACTIONS_PER_UNIT);
 
-      int8_t rowCount = S3L_PC_APPROX_LENGTH;
+      /* The steps get set at the first pixel (rowCount starts at pcLength),
+         compilers just can't see it with a per triangle pcLength. */
+      depthPC.stepScaled = 0;
+      b0PC.stepScaled = 0;
+      b1PC.stepScaled = 0;
+
+  #if S3L_PC_ATTRIBUTES
+      S3L_FastLerpState attributePC[S3L_MAX_ATTRIBUTES]; /* interpolates
+                                                           attributes between
+                                                           row segments */
+
+      /* Computes the attributes at given scaled values of barycentric0 and
+         barycentric1, p.barycentric is used as a temporary here as it gets
+         rewritten for each pixel anyway. */
+      #define pcAttributesAt(b0Scaled,b1Scaled,code)\
+        *barycentric0 = (b0Scaled) >> S3L_FAST_LERP_QUALITY;\
+        *barycentric1 = (b1Scaled) >> S3L_FAST_LERP_QUALITY;\
+        *barycentric2 =\
+          S3L_FRACTIONS_PER_UNIT - *barycentric0 - *barycentric1;\
+        for (uint8_t a = 0; a < S3L_triangleAttributeCount; ++a)\
+        {\
+          S3L_Unit valueScaled = S3L_interpolateBarycentric(\
+            S3L_triangleAttributes[0][a],\
+            S3L_triangleAttributes[1][a],\
+            S3L_triangleAttributes[2][a],\
+            p.barycentric) << S3L_FAST_LERP_QUALITY;\
+          code\
+        }
+
+      pcAttributesAt(b0PC.valueScaled,b1PC.valueScaled,
+        attributePC[a].valueScaled = valueScaled;)
+  #endif
+
+      int8_t rowCount = pcLength;
 #endif
 
-#if S3L_Z_BUFFER
+      S3L_STATS_ADD(pixels,S3L_zeroClamp(rXClipped - lXClipped));
+
+#ifdef S3L_SPAN_FUNCTION
+      if (lXClipped < rXClipped)
+      {
+        span.y = p.y;
+        span.x0 = lXClipped;
+        span.x1 = rXClipped;
+
+  #if S3L_COMPUTE_LERP_DEPTH
+        span.depthScaled = depthFLS.valueScaled;
+        span.depthStepScaled = depthFLS.stepScaled;
+  #endif
+
+  #if S3L_LERP_ATTRIBUTES
+        for (uint8_t a = 0; a < attributeCount; ++a)
+        {
+          span.attributesScaled[a] = attributeFLS[a].valueScaled;
+          span.attributeStepsScaled[a] = attributeFLS[a].stepScaled;
+        }
+  #endif
+
+        S3L_PROFILE_SHADING(S3L_SPAN_FUNCTION(&span));
+      }
+#else
+  #if S3L_Z_BUFFER
       uint32_t zBufferIndex = p.y * S3L_RESOLUTION_X + lXClipped;
-#endif
+  #endif
 
       // draw the row -- inner loop:
 
@@ -1990,53 +2968,51 @@ void S3L_drawTriangle(
       {
         int8_t testsPassed = 1;
 
+        S3L_OVERDRAW_ADD(fragments,p.y * S3L_RESOLUTION_X + x);
+
 #if S3L_STENCIL_BUFFER
         if (!S3L_stencilTest(x,p.y))
+        {
           testsPassed = 0;
+          S3L_STATS_ADD(stencilRejected,1);
+        }
 #endif
         p.x = x;
 
 #if S3L_COMPUTE_DEPTH
   #if S3L_PERSPECTIVE_CORRECTION == 1
-        p.depth = Z_RECIP_NUMERATOR /
-          S3L_nonZero(S3L_interpolate(lRecipZ,rRecipZ,i,rowLength));
+        p.depth = _S3L_divide(Z_RECIP_NUMERATOR,
+          S3L_nonZero(S3L_interpolate(lRecipZ,rRecipZ,i,rowLength)));
   #elif S3L_PERSPECTIVE_CORRECTION == 2
-        if (rowCount >= S3L_PC_APPROX_LENGTH)
+        if (rowCount >= pcLength)
         {
           // init the linear interpolation to the next PC correct value
 
           rowCount = 0;
 
-          S3L_Unit nextI = i + S3L_PC_APPROX_LENGTH;
+          S3L_Unit nextI = i + pcLength;
+          S3L_Unit nextDepthScaled, nextB0, nextB1, segmentLength;
 
           if (nextI < rowLength)
           {
-            S3L_Unit nextDepthScaled =
-              (
-              Z_RECIP_NUMERATOR /
+            nextDepthScaled =
+              _S3L_divide(Z_RECIP_NUMERATOR,
               S3L_nonZero(S3L_interpolate(lRecipZ,rRecipZ,nextI,rowLength))
               ) << S3L_FAST_LERP_QUALITY;
 
-            depthPC.stepScaled =
-              (nextDepthScaled - depthPC.valueScaled) / S3L_PC_APPROX_LENGTH;
-
-            S3L_Unit nextValue = 
+            nextB0 = 
              ( 
                S3L_interpolateFrom0(rOverZ,nextI,rowLength)
                * nextDepthScaled
              ) / (Z_RECIP_NUMERATOR / S3L_FRACTIONS_PER_UNIT);
 
-            b0PC.stepScaled =
-              (nextValue - b0PC.valueScaled) / S3L_PC_APPROX_LENGTH;
-
-            nextValue = 
+            nextB1 = 
              ( 
                (lOverZ - S3L_interpolateFrom0(lOverZ,nextI,rowLength))
                * nextDepthScaled
              ) / (Z_RECIP_NUMERATOR / S3L_FRACTIONS_PER_UNIT);
 
-            b1PC.stepScaled =
-              (nextValue - b1PC.valueScaled) / S3L_PC_APPROX_LENGTH;
+            segmentLength = pcLength;
           }
           else
           {
@@ -2046,29 +3022,33 @@ void S3L_drawTriangle(
                actually never reach the extrapolated screen position. So we
                have to clamp to the actual end of the triangle here. */
 
-            S3L_Unit maxI = S3L_nonZero(rowLength - i);
-
-            S3L_Unit nextDepthScaled =
-              (
-              Z_RECIP_NUMERATOR /
+            nextDepthScaled =
+              _S3L_divide(Z_RECIP_NUMERATOR,
               S3L_nonZero(rRecipZ)
               ) << S3L_FAST_LERP_QUALITY;
 
-            depthPC.stepScaled =
-              (nextDepthScaled - depthPC.valueScaled) / maxI;
-
-            S3L_Unit nextValue = 
+            nextB0 = 
              ( 
                rOverZ
                * nextDepthScaled
              ) / (Z_RECIP_NUMERATOR / S3L_FRACTIONS_PER_UNIT);
 
-            b0PC.stepScaled =
-              (nextValue - b0PC.valueScaled) / maxI;
+            nextB1 = 0;
 
-            b1PC.stepScaled =
-              -1 * b1PC.valueScaled / maxI;
+            segmentLength = S3L_nonZero(rowLength - i);
           }
+
+          depthPC.stepScaled =
+            (nextDepthScaled - depthPC.valueScaled) / segmentLength;
+
+          b0PC.stepScaled = (nextB0 - b0PC.valueScaled) / segmentLength;
+          b1PC.stepScaled = (nextB1 - b1PC.valueScaled) / segmentLength;
+
+    #if S3L_PC_ATTRIBUTES
+          pcAttributesAt(nextB0,nextB1,
+            attributePC[a].stepScaled =
+              (valueScaled - attributePC[a].valueScaled) / segmentLength;)
+    #endif
         }
 
         p.depth = S3L_getFastLerpValue(depthPC);
@@ -2086,11 +3066,16 @@ void S3L_drawTriangle(
         zBufferIndex++;
 
         if (!S3L_zTest(p.x,p.y,p.depth))
-          testsPassed = 0;        
+        {
+          testsPassed = 0;
+          S3L_STATS_ADD(zRejected,1);
+        }
 #endif
 
         if (testsPassed)
         {
+          S3L_OVERDRAW_ADD(passed,p.y * S3L_RESOLUTION_X + x);
+
 #if !S3L_FLAT
   #if S3L_PERSPECTIVE_CORRECTION == 0
           *barycentric0 = S3L_getFastLerpValue(b0FLS);
@@ -2114,8 +3099,34 @@ void S3L_drawTriangle(
 
           *barycentric2 =
             S3L_FRACTIONS_PER_UNIT - *barycentric0 - *barycentric1;
+
+  #if S3L_LERP_ATTRIBUTES
+          for (uint8_t a = 0; a < attributeCount; ++a)
+            p.attributes[a] = S3L_getFastLerpValue(attributeFLS[a]);
+  #elif S3L_PC_ATTRIBUTES
+          for (uint8_t a = 0; a < S3L_triangleAttributeCount; ++a)
+            p.attributes[a] = S3L_getFastLerpValue(attributePC[a]);
+  #elif S3L_BARYCENTRIC_ATTRIBUTES
+          for (uint8_t a = 0; a < S3L_triangleAttributeCount; ++a)
+            p.attributes[a] = S3L_interpolateBarycentric(
+              S3L_triangleAttributes[0][a],
+              S3L_triangleAttributes[1][a],
+              S3L_triangleAttributes[2][a],
+              p.barycentric);
+  #endif
+#endif
+#if S3L_VISIBILITY_BUFFER
+          _S3L_VisibilityBufferEntry *entry =
+            &(S3L_visibilityBuffer[p.y * S3L_RESOLUTION_X + p.x]);
+
+          entry->triangle = visibleTriangle;
+          entry->barycentric[0] = p.barycentric[0];
+          entry->barycentric[1] = p.barycentric[1];
+#else
+          S3L_STATS_ADD(pixelsDrawn,1);
+          S3L_OVERDRAW_ADD(shaded,p.y * S3L_RESOLUTION_X + x);
+          S3L_PROFILE_SHADING(S3L_PIXEL_FUNCTION(&p));
 #endif
-          S3L_PIXEL_FUNCTION(&p);
         } // tests passed
 
 #if !S3L_FLAT
@@ -2127,13 +3138,24 @@ void S3L_drawTriangle(
           S3L_stepFastLerp(depthPC);
           S3L_stepFastLerp(b0PC);
           S3L_stepFastLerp(b1PC);
+
+      #if S3L_PC_ATTRIBUTES
+          for (uint8_t a = 0; a < S3L_triangleAttributeCount; ++a)
+            S3L_stepFastLerp(attributePC[a]);
+      #endif
     #endif
   #else
           S3L_stepFastLerp(b0FLS);
           S3L_stepFastLerp(b1FLS);
+
+    #if S3L_LERP_ATTRIBUTES
+          for (uint8_t a = 0; a < attributeCount; ++a)
+            S3L_stepFastLerp(attributeFLS[a]);
+    #endif
   #endif
 #endif
       } // inner loop
+#endif // S3L_SPAN_FUNCTION
     } // y clipping
 
 #if !S3L_FLAT
@@ -2144,6 +3166,14 @@ void S3L_drawTriangle(
     S3L_stepFastLerp(lDepthFLS);
     S3L_stepFastLerp(rDepthFLS);
   #endif
+
+  #if S3L_LERP_ATTRIBUTES
+    for (uint8_t a = 0; a < attributeCount; ++a)
+    {
+      S3L_stepFastLerp(lAttributeFLS[a]);
+      S3L_stepFastLerp(rAttributeFLS[a]);
+    }
+  #endif
 #endif
 
     ++currentY;
@@ -2152,14 +3182,295 @@ void S3L_drawTriangle(
   #undef manageSplit
   #undef initPC
   #undef initSide
+  #undef initDepthFLS
+  #undef initAttributeFLS
+  #undef pcAttributesAt
   #undef stepSide
   #undef Z_RECIP_NUMERATOR 
+
+  S3L_PROFILE_TRIANGLE_END(rasterizationStart,S3L_ZONE_RASTERIZATION);
+}
+
+#if S3L_DYNAMIC_RESOLUTION
+uint8_t S3L_setResolution(uint16_t x, uint16_t y)
+{
+  if (x == 0 || y == 0 || x > S3L_MAX_RESOLUTION_X ||
+    y > S3L_MAX_RESOLUTION_Y)
+    return 0;
+
+  S3L_resolutionX = x;
+  S3L_resolutionY = y;
+
+  return 1;
+}
+
+void S3L_initResolutionController(S3L_ResolutionController *c,
+  uint32_t budget)
+{
+  c->budget = budget;
+  c->average = 0;
+  c->scale = S3L_RESOLUTION_STEPS;
+  c->minScale = S3L_RESOLUTION_STEPS / 2;
+  c->settle = 0;
+
+  S3L_setResolution(S3L_MAX_RESOLUTION_X,S3L_MAX_RESOLUTION_Y);
+}
+
+uint8_t S3L_updateResolution(S3L_ResolutionController *c,
+  uint32_t frameTime)
+{
+  if (c->settle == 0) // may still be (partly) the previous resolution
+  {
+    c->settle = 1;
+    return 0;
+  }
+
+  c->average = c->settle == 1 ? frameTime :
+    c->average - c->average / 4 + frameTime / 4;
+
+  c->settle = 2;
+
+  /* The time is predicted to go with the pixels, i.e. the square of the
+     scale. Geometry doesn't scale, so this lowers too little (and the next
+     frames lower further) and raises too little, never too much, which
+     keeps the resolution from oscillating. */
+  uint64_t budget = ((uint64_t) c->budget) * c->scale * c->scale;
+  uint8_t scale = c->scale;
+
+  while (scale > c->minScale &&
+    ((uint64_t) c->average) * scale * scale > budget)
+    scale--;
+
+  if (scale == c->scale && scale < S3L_RESOLUTION_STEPS &&
+    ((uint64_t) c->average) * (scale + 1) * (scale + 1) * 8 < budget * 7)
+    scale++;
+
+  if (scale == c->scale)
+    return 0;
+
+  c->scale = scale;
+  c->settle = 0;
+
+  S3L_setResolution(
+    S3L_max(1,(S3L_MAX_RESOLUTION_X * scale) / S3L_RESOLUTION_STEPS),
+    S3L_max(1,(S3L_MAX_RESOLUTION_Y * scale) / S3L_RESOLUTION_STEPS));
+
+  return 1;
 }
+#endif
 
 void S3L_newFrame(void)
 {
+#if S3L_PROFILE
+  for (uint8_t i = 0; i < S3L_ZONE_COUNT; ++i)
+  {
+    S3L_profile.time[i] = 0;
+    S3L_profile.count[i] = 0;
+  }
+
+  S3L_profile.eventCount = 0;
+  S3L_profile.eventsDropped = 0;
+  S3L_profile.frameStart = S3L_PROFILE_CLOCK();
+#endif
+
+  S3L_PROFILE_BEGIN(clearStart);
+
   S3L_zBufferClear();
   S3L_stencilBufferClear();
+  S3L_visibilityBufferClear();
+
+  S3L_PROFILE_END_EVENT(clearStart,S3L_ZONE_CLEAR);
+
+#if S3L_OVERDRAW
+  for (uint32_t i = 0; i < S3L_RESOLUTION_X * S3L_RESOLUTION_Y; ++i)
+  {
+    S3L_overdraw.fragments[i] = 0;
+    S3L_overdraw.passed[i] = 0;
+    S3L_overdraw.shaded[i] = 0;
+  }
+#endif
+
+#if S3L_STATS
+  S3L_Stats empty = { 0 };
+  S3L_stats = empty;
+#endif
+}
+
+#if S3L_PROFILE
+void S3L_profileEndFrame(void)
+{
+  for (uint8_t i = 0; i < S3L_ZONE_COUNT; ++i)
+  {
+    uint32_t time = S3L_profile.time[i];
+    uint8_t bucket = 0;
+
+    while (time != 0 && bucket < S3L_PROFILE_HISTOGRAM_BUCKETS - 1)
+    {
+      time >>= 1;
+      bucket++;
+    }
+
+    S3L_profile.histogram[i][bucket]++;
+  }
+
+  S3L_profile.frames++;
+}
+
+void S3L_profileReset(void)
+{
+  for (uint8_t i = 0; i < S3L_ZONE_COUNT; ++i)
+    for (uint8_t j = 0; j < S3L_PROFILE_HISTOGRAM_BUCKETS; ++j)
+      S3L_profile.histogram[i][j] = 0;
+
+  S3L_profile.frames = 0;
+}
+#endif
+
+void S3L_visibilityBufferClear(void)
+{
+#if S3L_VISIBILITY_BUFFER
+  for (uint32_t i = 0; i < S3L_RESOLUTION_X * S3L_RESOLUTION_Y; ++i)
+    S3L_visibilityBuffer[i].triangle = S3L_VISIBILITY_BUFFER_EMPTY;
+
+  _S3L_visibleTriangleCount = 0;
+#endif
+}
+
+void S3L_resolveVisibilityBuffer(S3L_Scene scene)
+{
+#if S3L_VISIBILITY_BUFFER
+  #if S3L_MAX_ATTRIBUTES == 0 && !S3L_LIGHTING
+  S3L_UNUSED(scene);
+  #endif
+
+  S3L_PixelInfo p;
+  S3L_initPixelInfo(&p);
+
+  const uint32_t pixelCount = S3L_RESOLUTION_X * S3L_RESOLUTION_Y;
+
+  S3L_PROFILE_BEGIN(resolveStart);
+
+  /* Group the covered pixels by triangle (counting sort), so that each
+     triangle is set up only once. */
+
+  for (uint16_t t = 0; t < _S3L_visibleTriangleCount; ++t)
+    _S3L_visibleTriangles[t].pixels = 0;
+
+  for (uint32_t i = 0; i < pixelCount; ++i)
+    if (S3L_visibilityBuffer[i].triangle != S3L_VISIBILITY_BUFFER_EMPTY)
+      _S3L_visibleTriangles[S3L_visibilityBuffer[i].triangle].pixels++;
+
+  uint32_t start = 0;
+
+  for (uint16_t t = 0; t < _S3L_visibleTriangleCount; ++t)
+  {
+    uint32_t count = _S3L_visibleTriangles[t].pixels;
+    _S3L_visibleTriangles[t].pixels = start;
+    start += count;
+  }
+
+  for (uint32_t i = 0; i < pixelCount; ++i)
+    if (S3L_visibilityBuffer[i].triangle != S3L_VISIBILITY_BUFFER_EMPTY)
+      _S3L_visibilityOrder[
+        _S3L_visibleTriangles[S3L_visibilityBuffer[i].triangle].pixels++] = i;
+
+  // now .pixels is the end of each triangle's pixels
+
+  #if S3L_LIGHTING
+  uint32_t previousModel = 0xffffffff; // lights are set up per model
+  #endif
+
+  #ifdef S3L_TRIANGLE_FUNCTION
+  S3L_TriangleInfo triangleInfo;
+
+  S3L_initVec4(&(triangleInfo.points[0]));
+  S3L_initVec4(&(triangleInfo.points[1]));
+  S3L_initVec4(&(triangleInfo.points[2]));
+  #endif
+
+  uint32_t next = 0;
+
+  for (uint16_t t = 0; t < _S3L_visibleTriangleCount; ++t)
+  {
+    const _S3L_VisibleTriangle *triangle = &(_S3L_visibleTriangles[t]);
+
+    if (triangle->pixels == next)
+      continue; // completely hidden
+
+    p.triangleID = triangle->triangleID;
+    p.modelIndex = p.triangleID >> 16;
+    p.triangleIndex = p.triangleID & 0x0000ffff;
+    p.triangleSize[0] = triangle->size[0];
+    p.triangleSize[1] = triangle->size[1];
+
+  #if S3L_MAX_ATTRIBUTES > 0
+    _S3L_fetchTriangleAttributes(&(scene.models[p.modelIndex]),
+      p.triangleIndex);
+  #endif
+
+  #if S3L_LIGHTING
+    if (p.modelIndex != previousModel)
+    {
+      _S3L_setupModelLights(&scene,&(scene.models[p.modelIndex]));
+      previousModel = p.modelIndex;
+    }
+
+    _S3L_lightTriangle(&(scene.models[p.modelIndex]),p.triangleIndex);
+  #endif
+
+  #if S3L_LIGHTING == 1
+    p.intensity = _S3L_triangleIntensity;
+  #endif
+
+  #ifdef S3L_TRIANGLE_FUNCTION
+    triangleInfo.modelIndex = p.modelIndex;
+    triangleInfo.triangleIndex = p.triangleIndex;
+    triangleInfo.triangleID = p.triangleID;
+    triangleInfo.triangleSize[0] = p.triangleSize[0];
+    triangleInfo.triangleSize[1] = p.triangleSize[1];
+  #if S3L_LIGHTING == 1
+    triangleInfo.intensity = p.intensity;
+  #endif
+
+    S3L_PROFILE_SHADING(S3L_TRIANGLE_FUNCTION(&triangleInfo));
+  #endif
+
+    for (; next < triangle->pixels; ++next)
+    {
+      uint32_t index = _S3L_visibilityOrder[next];
+      const _S3L_VisibilityBufferEntry *entry = S3L_visibilityBuffer + index;
+
+      p.y = index / S3L_RESOLUTION_X;
+      p.x = index - p.y * S3L_RESOLUTION_X;
+
+      p.barycentric[0] = entry->barycentric[0];
+      p.barycentric[1] = entry->barycentric[1];
+      p.barycentric[2] =
+        S3L_FRACTIONS_PER_UNIT - p.barycentric[0] - p.barycentric[1];
+
+  #if S3L_Z_BUFFER == 1
+      p.depth = S3L_zBuffer[index];
+  #endif
+
+  #if S3L_MAX_ATTRIBUTES > 0
+      for (uint8_t a = 0; a < S3L_triangleAttributeCount; ++a)
+        p.attributes[a] = S3L_interpolateBarycentric(
+          S3L_triangleAttributes[0][a],
+          S3L_triangleAttributes[1][a],
+          S3L_triangleAttributes[2][a],
+          p.barycentric);
+  #endif
+
+      S3L_STATS_ADD(pixelsDrawn,1);
+      S3L_OVERDRAW_ADD(shaded,index);
+      S3L_PROFILE_SHADING(S3L_PIXEL_FUNCTION(&p));
+    }
+  }
+
+  S3L_PROFILE_END_EVENT(resolveStart,S3L_ZONE_RESOLVE);
+#else
+  S3L_UNUSED(scene);
+#endif
 }
 
 void S3L_stencilBufferClear(void)
@@ -2178,8 +3489,13 @@ void S3L_drawScene(S3L_Scene scene)
   const S3L_Model3D *model;
   S3L_Index modelIndex, triangleIndex;
 
+  S3L_PROFILE_BEGIN(sceneStart);
+  S3L_PROFILE_BEGIN(matricesStart);
+
   S3L_makeCameraMatrix(scene.camera.transform,matCamera);
 
+  S3L_PROFILE_END(matricesStart,S3L_ZONE_MATRICES);
+
 #if S3L_SORT != 0
   uint16_t previousModel = 0;
   S3L_sortArrayLength = 0;
@@ -2192,24 +3508,33 @@ void S3L_drawScene(S3L_Scene scene)
 
 #if S3L_SORT != 0
     if (S3L_sortArrayLength >= S3L_MAX_TRIANGES_DRAWN)
+    {
+  #if S3L_STATS
+      for (S3L_Index m = modelIndex; m < scene.modelCount; ++m)
+        if (scene.models[m].config.visible)
+          S3L_stats.dropped += scene.models[m].triangleCount;
+  #endif
       break;
+    }
 
     previousModel = modelIndex;
 #endif
 
-    if (scene.models[modelIndex].customTransformMatrix == 0)
-      S3L_makeWorldMatrix(scene.models[modelIndex].transform,matFinal);
-    else
-    {
-      S3L_Mat4 *m = scene.models[modelIndex].customTransformMatrix;
-
-      for (int8_t j = 0; j < 4; ++j)
-        for (int8_t i = 0; i < 4; ++i)
-           matFinal[i][j] = (*m)[i][j];
-    }
+    S3L_PROFILE_BEGIN(modelStart);
 
+    _S3L_makeModelMatrix(&(scene.models[modelIndex]),matFinal);
     S3L_mat4Xmat4(matFinal,matCamera);
 
+#if S3L_LIGHTING
+    _S3L_setupModelLights(&scene,&(scene.models[modelIndex]));
+#endif
+
+    S3L_PROFILE_END(modelStart,S3L_ZONE_MATRICES);
+
+#if S3L_VERTEX_CACHE_SIZE > 0
+    _S3L_vertexCacheClear();
+#endif
+
     S3L_Index triangleCount = scene.models[modelIndex].triangleCount;
 
     triangleIndex = 0;
@@ -2218,29 +3543,61 @@ void S3L_drawScene(S3L_Scene scene)
     
     while (triangleIndex < triangleCount)
     {
-      /* Some kind of cache could be used in theory to not project perviously
-         already projected vertices, but after some testing this was abandoned,
-         no gain was seen. */
+      /* Previously projected vertices can be reused with the vertex cache
+         (S3L_VERTEX_CACHE_SIZE), which only pays off if the triangles are
+         ordered for it. */
+
+#if S3L_TRIANGLE_STRIPS
+      if (model->triangleStrip &&
+        _S3L_stripTriangleIsDegenerate(model,triangleIndex))
+      {
+        triangleIndex++;
+        continue;
+      }
+#endif
+
+      S3L_PROFILE_TRIANGLE_BEGIN(projectionStart);
 
       uint8_t split = _S3L_projectTriangle(model,triangleIndex,matFinal,
         scene.camera.focalLength,transformed);
 
+      S3L_STATS_ADD(triangles,1);
+
       if (S3L_triangleIsVisible(transformed[0],transformed[1],transformed[2],
          model->config.backfaceCulling))
       {
 #if S3L_SORT == 0
+  #if !S3L_VISIBILITY_BUFFER // else done by the resolve for visible ones
+    #if S3L_MAX_ATTRIBUTES > 0
+        _S3L_fetchTriangleAttributes(model,triangleIndex);
+    #endif
+
+    #if S3L_LIGHTING
+        _S3L_lightTriangle(model,triangleIndex);
+    #endif
+  #endif
+
+        S3L_PROFILE_TRIANGLE_END(projectionStart,S3L_ZONE_PROJECTION);
+
         // without sorting draw right away
         S3L_drawTriangle(transformed[0],transformed[1],transformed[2],modelIndex,
           triangleIndex);
 
         if (split) // draw potential subtriangle
+        {
+          S3L_STATS_ADD(split,1);
           S3L_drawTriangle(transformed[3],transformed[4],transformed[5],
-          modelIndex, triangleIndex);
+            modelIndex, triangleIndex);
+        }
 #else
         S3L_UNUSED(split);
+        S3L_PROFILE_TRIANGLE_END(projectionStart,S3L_ZONE_PROJECTION);
 
         if (S3L_sortArrayLength >= S3L_MAX_TRIANGES_DRAWN)
+        {
+          S3L_STATS_ADD(dropped,triangleCount - triangleIndex);
           break;
+        }
 
         // with sorting add to a sort list
         S3L_sortArray[S3L_sortArrayLength].modelIndex = modelIndex;
@@ -2258,6 +3615,8 @@ void S3L_drawScene(S3L_Scene scene)
         S3L_sortArrayLength++;
 #endif
       }
+      else
+        S3L_PROFILE_TRIANGLE_END(projectionStart,S3L_ZONE_PROJECTION);
 
       triangleIndex++;
     }
@@ -2275,6 +3634,12 @@ void S3L_drawScene(S3L_Scene scene)
   especially for smaller arrays (better than bubble sort, in-place, stable,
   simple, ...). */
 
+  S3L_PROFILE_BEGIN(sortProfileStart);
+
+  #if S3L_STATS
+  uint32_t sortStart = S3L_STATS_CLOCK();
+  #endif
+
   for (int16_t i = 1; i < S3L_sortArrayLength; ++i)
   {
     _S3L_TriangleToSort tmp = S3L_sortArray[i];
@@ -2292,6 +3657,12 @@ void S3L_drawScene(S3L_Scene scene)
 
   #undef cmp
 
+  #if S3L_STATS
+  S3L_stats.sortTime += S3L_STATS_CLOCK() - sortStart;
+  #endif
+
+  S3L_PROFILE_END_EVENT(sortProfileStart,S3L_ZONE_SORT);
+
   for (S3L_Index i = 0; i < S3L_sortArrayLength; ++i) // draw sorted trianglesS3L_PixelInfo
   {
     modelIndex = S3L_sortArray[i].modelIndex;
@@ -2301,10 +3672,22 @@ void S3L_drawScene(S3L_Scene scene)
 
     if (modelIndex != previousModel)
     {
+      S3L_PROFILE_BEGIN(modelStart);
+
       // only recompute the matrix when the model has changed
-      S3L_makeWorldMatrix(model->transform,matFinal);
+      _S3L_makeModelMatrix(model,matFinal);
       S3L_mat4Xmat4(matFinal,matCamera);
       previousModel = modelIndex;
+
+  #if S3L_VERTEX_CACHE_SIZE > 0
+      _S3L_vertexCacheClear();
+  #endif
+
+  #if S3L_LIGHTING
+      _S3L_setupModelLights(&scene,model);
+  #endif
+
+      S3L_PROFILE_END(modelStart,S3L_ZONE_MATRICES);
     }
 
     /* Here we project the points again, which is redundant and slow as they've
@@ -2312,15 +3695,34 @@ void S3L_drawScene(S3L_Scene scene)
        require a lot of memory, which for small resolutions could be even
        worse than z-bufer. So this seems to be the best way memory-wise. */
 
+    S3L_PROFILE_TRIANGLE_BEGIN(projectionStart);
+
     uint8_t split = _S3L_projectTriangle(model,triangleIndex,matFinal,
       scene.camera.focalLength,transformed);
 
+#if !S3L_VISIBILITY_BUFFER // else done by the resolve for visible ones
+  #if S3L_MAX_ATTRIBUTES > 0
+    _S3L_fetchTriangleAttributes(model,triangleIndex);
+  #endif
+
+  #if S3L_LIGHTING
+    _S3L_lightTriangle(model,triangleIndex);
+  #endif
+#endif
+
+    S3L_PROFILE_TRIANGLE_END(projectionStart,S3L_ZONE_PROJECTION);
+
     S3L_drawTriangle(transformed[0],transformed[1],transformed[2],modelIndex,
       triangleIndex);
         
     if (split)
+    {
+      S3L_STATS_ADD(split,1);
       S3L_drawTriangle(transformed[3],transformed[4],transformed[5],
-      modelIndex, triangleIndex);
+        modelIndex, triangleIndex);
+    }
   }
 #endif
+
+  S3L_PROFILE_END_EVENT(sceneStart,S3L_ZONE_SCENE);
 }
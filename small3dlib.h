@@ -17,8 +17,21 @@ extern "C" {
 
   Before including the library, define S3L_PIXEL_FUNCTION to the name of the
   function you'll be using to draw single pixels (this function will be called
-  by the library to render the frames). Also either init S3L_resolutionX and
-  S3L_resolutionY or define S3L_RESOLUTION_X and S3L_RESOLUTION_Y.
+  by the library to render the frames). Also define S3L_RESOLUTION_X and
+  S3L_RESOLUTION_Y, or S3L_DYNAMIC_RESOLUTION and set the resolution at
+  runtime with S3L_setResolution.
+
+  Optionally also define S3L_TRIANGLE_FUNCTION to the name of a function that
+  will be called once for each triangle before any of its pixels are drawn.
+  This is the place to do per-triangle work (fetching texture coordinates,
+  computing attribute gradients, selecting materials etc.) instead of
+  checking for a triangle change in the pixel function.
+
+  For the fastest affine rendering, S3L_SPAN_FUNCTION can be defined to the
+  name of a function that draws whole horizontal spans of triangles, it then
+  replaces the per-pixel loop and the pixel function (which is still needed
+  for the visibility buffer resolve). The span function has to do the depth
+  test itself, using S3L_zBuffer.
 
   You'll also need to decide what rendering strategy and other settings you
   want to use, depending on your specific usecase. You may want to use a
@@ -26,7 +39,8 @@ extern "C" {
   none of these. See the description of the options in this file.
 
   The rendering itself is done with S3L_drawScene, usually preceded by
-  S3L_newFrame (for clearing zBuffer etc.).
+  S3L_newFrame (for clearing zBuffer etc.) and, with S3L_VISIBILITY_BUFFER,
+  followed by S3L_resolveVisibilityBuffer (which does the actual shading).
 
   The library is meant to be used in not so huge programs that use single
   translation unit and so includes both declarations and implementation at once.
@@ -147,6 +161,12 @@ extern "C" {
 #include "S3L_config.h"
 #include "S3L_port.h"
 extern void S3L_PIXEL_FUNCTION(S3L_PixelInfo *pixel); // forward decl
+#ifdef S3L_TRIANGLE_FUNCTION
+extern void S3L_TRIANGLE_FUNCTION(const S3L_TriangleInfo *triangle);
+#endif
+#ifdef S3L_SPAN_FUNCTION
+extern void S3L_SPAN_FUNCTION(const S3L_SpanInfo *span);
+#endif
 extern S3L_Unit S3L_abs(S3L_Unit value);
 extern S3L_Unit S3L_min(S3L_Unit v1, S3L_Unit v2);
 extern S3L_Unit S3L_max(S3L_Unit v1, S3L_Unit v2);
@@ -162,18 +182,44 @@ extern S3L_Unit S3L_interpolate(
   S3L_Unit v2,
   S3L_Unit t,
   S3L_Unit tMax);
+
+/** Sine of an angle in S3L_FRACTIONS_PER_UNITs per full turn, interpolated
+  from a table finer than S3L_Unit, so the error is at most 0.51 units (the
+  rounding) for S3L_FRACTIONS_PER_UNIT 512. */
 extern S3L_Unit S3L_sin(S3L_Unit x);
+
+/** Inverse of S3L_sin for -S3L_FRACTIONS_PER_UNIT to S3L_FRACTIONS_PER_UNIT
+  (clamped), computed with S3L_sqrt and a cubic polynomial, the error is at
+  most 0.7 units of angle. */
 extern S3L_Unit S3L_asin(S3L_Unit x);
+
 extern S3L_Unit S3L_cos(S3L_Unit x);
+
+/** Exact integer square root (rounded down), with one Newton step from a
+  table seed. For negative values returns -S3L_sqrt(-value). */
 extern S3L_Unit S3L_sqrt(S3L_Unit value);
+
 extern void S3L_initVec4(S3L_Vec4 *v);
 extern void S3L_setVec4(S3L_Vec4 *v, S3L_Unit x, S3L_Unit y,S3L_Unit z, S3L_Unit w);
 extern void S3L_vec3Add(S3L_Vec4 *result, S3L_Vec4 added);
 extern void S3L_vec3Sub(S3L_Vec4 *result, S3L_Vec4 substracted);
 extern S3L_Unit S3L_vec2Length(S3L_Vec4 v);
 extern S3L_Unit S3L_vec3Length(S3L_Vec4 v);
+
+/** Like S3L_normalizeVec3, but doesn't perform any checks on the input vector,
+  which is faster, but can be very innacurate or overflowing. You are supposed
+  to provide a "nice" vector (not too big or small). For vectors with
+  components below 2^14 the error is at most 150 units per component (for
+  S3L_FRACTIONS_PER_UNIT 512), 2.6 on average (see s3l_mathbench). */
 extern void S3L_normalizeVec3Fast(S3L_Vec4 *v);
+
+/** Normalizes Vec3. Note that this function tries to normalize correctly
+  rather than quickly! If you need to normalize quickly, do it yourself in a
+  way that best fits your case. For vectors with components below 2^14 the
+  error is at most 24.4 units per component (for S3L_FRACTIONS_PER_UNIT 512),
+  2.0 on average (see s3l_mathbench). */
 extern void S3L_normalizeVec3(S3L_Vec4 *v);
+
 #define S3L_logVec4(v)\
   printf("Vec4: %d %d %d %d\n",((v).x),((v).y),((v).z),((v).w))
 /** Initializes a 4x4 matrix to identity. */
@@ -185,13 +231,7 @@ extern void S3L_copyMat4(S3L_Mat4 src, S3L_Mat4 dst); //matrix update
     (m)[0][1],(m)[1][1],(m)[2][1],(m)[3][1],\
     (m)[0][2],(m)[1][2],(m)[2][2],(m)[3][2],\
     (m)[0][3],(m)[1][3],(m)[2][3],(m)[3][3])
-/** Like S3L_normalizeVec3, but doesn't perform any checks on the input vector,
-  which is faster, but can be very innacurate or overflowing. You are supposed
-  to provide a "nice" vector (not too big or small). */
 extern S3L_Unit S3L_dotProductVec3(S3L_Vec4 a, S3L_Vec4 b);
-/** Normalizes Vec3. Note that this function tries to normalize correctly
-  rather than quickly! If you need to normalize quickly, do it yourself in a
-  way that best fits your case. */
 extern void S3L_crossProduct(S3L_Vec4 a, S3L_Vec4 b, S3L_Vec4 *result);
 /** Computes a reflection direction (typically used e.g. for specular component
   in Phong illumination). The input vectors must be normalized. The result will
@@ -231,6 +271,66 @@ extern S3L_Unit S3L_interpolateBarycentric(
 
 
 
+#if S3L_Z_BUFFER == 1
+extern S3L_Unit S3L_zBuffer[];
+#elif S3L_Z_BUFFER == 2
+extern uint8_t S3L_zBuffer[];
+#endif
+
+#if S3L_STATS
+/** Statistics of the current frame, reset by S3L_newFrame. */
+extern S3L_Stats S3L_stats;
+#endif
+
+/** Returns the current time in any units (e.g. cycles or microseconds), the
+  default S3L_PROFILE_CLOCK, which can also be used as S3L_STATS_CLOCK. It's
+  implemented by the port (the RP2040 timer, in microseconds) or by the
+  host backend (S3L_host.h). */
+extern uint32_t S3L_profileClock(void);
+
+#if S3L_OVERDRAW
+/** Per pixel counters of the current frame (reset by S3L_newFrame). */
+extern S3L_Overdraw S3L_overdraw;
+#endif
+
+#if S3L_DYNAMIC_RESOLUTION
+extern uint16_t S3L_resolutionX;
+extern uint16_t S3L_resolutionY;
+
+/** Sets the resolution of the next frames (call it before S3L_newFrame),
+  which has to fit in S3L_MAX_RESOLUTION_X x S3L_MAX_RESOLUTION_Y. Rows of
+  the buffers, including the framebuffer of the pixel and span functions,
+  are then S3L_RESOLUTION_X pixels long. Returns 1, or 0 if the resolution
+  doesn't fit (it then stays unchanged). */
+extern uint8_t S3L_setResolution(uint16_t x, uint16_t y);
+
+/** Inits the controller to keep frames under budget, at the maximum
+  resolution. */
+extern void S3L_initResolutionController(S3L_ResolutionController *c,
+  uint32_t budget);
+
+/** Feeds the controller the time of a frame (rendering only, or the whole
+  frame, in the units of the budget) and sets the resolution of the next
+  ones: lower as soon as the average time exceeds the budget, higher when
+  the higher one is expected to take less than 7/8 of it. Returns 1 if the
+  resolution changed. */
+extern uint8_t S3L_updateResolution(S3L_ResolutionController *c,
+  uint32_t frameTime);
+#endif
+
+#if S3L_PROFILE
+/** Profile of the current frame (reset by S3L_newFrame) and histograms of
+  the previous frames. */
+extern S3L_Profile S3L_profile;
+
+/** Adds the current frame's zone times to the histograms, call it after
+  the frame is drawn. */
+extern void S3L_profileEndFrame(void);
+
+/** Clears the histograms. */
+extern void S3L_profileReset(void);
+#endif
+
 /** Writes a value (not necessarily depth! depends on the format of z-buffer)
   to z-buffer (if enabled). Does NOT check boundaries! */
 extern void S3L_zBufferWrite(S3L_ScreenCoord x, S3L_ScreenCoord y, S3L_Unit value);
@@ -290,6 +390,20 @@ extern void S3L_initModel3D(
   const S3L_Index *triangles,
   S3L_Index triangleCount,
   S3L_Model3D *model);
+
+#if S3L_QUANTIZED_VERTICES
+/** Quantizes model vertices to int16_t for S3L_Model3D.quantizedVertices,
+  computing the scale and offset to set to the model. This is lossless if the
+  vertices span less than 65535 S3L_Units in each axis. Meant for offline or
+  init use. */
+extern void S3L_quantizeVertices(
+  const S3L_Unit *vertices,
+  S3L_Index vertexCount,
+  int16_t *result,
+  S3L_Vec4 *scale,
+  S3L_Vec4 *offset);
+#endif
+
 extern void S3L_initScene(
   S3L_Model3D *models,
   S3L_Index modelCount,
@@ -303,7 +417,24 @@ extern void project3DPointToScreen(
   S3L_Vec4 point,
   S3L_Camera camera,
   S3L_Vec4 *result);
-/** Computes a normalized normal of given triangle. */
+/** Gets vertex indices of model's triangle (the model may be a strip, see
+  S3L_TRIANGLE_STRIPS). Returns 0 for triangles joining strips (these have
+  repeated vertices and aren't drawn), otherwise 1. */
+extern uint8_t S3L_getModelTriangle(
+  const S3L_Model3D *model,
+  S3L_Index triangleIndex,
+  S3L_Index result[3]);
+
+/** Gets model's vertex in model space (dequantized if the model has quantized
+  vertices), w is set to S3L_FRACTIONS_PER_UNIT. */
+extern void S3L_getModelVertex(
+  const S3L_Model3D *model,
+  S3L_Index vertexIndex,
+  S3L_Vec4 *result);
+
+/** Computes a normalized normal of given triangle. It points out of the
+  triangle's back side (the side culled by the default backface culling), the
+  opposite of the normals used for lighting (S3L_Model3D.normals). */
 extern void S3L_triangleNormal(S3L_Vec4 t0, S3L_Vec4 t1, S3L_Vec4 t2,
   S3L_Vec4 *n);
 /** Helper function for retrieving per-vertex indexed values from an array,
@@ -322,23 +453,32 @@ extern void S3L_getIndexedTriangleValues(
   S3L_Vec4 *v0,
   S3L_Vec4 *v1,
   S3L_Vec4 *v2);
-/** Computes a normalized normal for every vertex of given model (this is
-  relatively slow and SHOUDN'T be done each frame). The dst array must have a
-  sufficient size preallocated! The size is: number of model vertices * 3 *
-  sizeof(S3L_Unit). Note that for advanced allowing sharp edges it is not
-  sufficient to have per-vertex normals, but must be per-triangle. This
-  function doesn't support this. 
+/** Computes a normalized normal for every vertex of given model (this
+  SHOUDN'T be done each frame). The dst array must have a sufficient size
+  preallocated! The size is: number of model vertices * 3 * sizeof(S3L_Unit).
+  Note that for advanced allowing sharp edges it is not sufficient to have
+  per-vertex normals, but must be per-triangle. This function doesn't support
+  this (S3L_computeSplitNormals in S3L_mesh.h does). 
 
   The function computes a normal for each vertex by averaging normals of
-  the triangles containing the vertex. The maximum number of these triangle
-  normals that will be averaged is set with
-  S3L_NORMAL_COMPUTE_MAXIMUM_AVERAGE. */
+  the triangles containing the vertex, in time linear in the number of
+  vertices and triangles. S3L_computeNormals in S3L_mesh.h can also weight
+  the triangles and update only some vertices. */
 extern void S3L_computeModelNormals(S3L_Model3D model, S3L_Unit *dst,
   int8_t transformNormals);
+#if S3L_MAX_ATTRIBUTES > 0
+/** Attribute values of the vertices of the triangle to be drawn by
+  S3L_drawTriangle and the number of valid components in them. */
+extern S3L_Unit S3L_triangleAttributes[3][S3L_MAX_ATTRIBUTES];
+extern uint8_t S3L_triangleAttributeCount;
+#endif
 /** Draws a triangle according to given config. The vertices are specified in
   Screen Space space (pixels). If perspective correction is enabled, each
   vertex has to have a depth (Z position in camera space) specified in the Z
-  component. */
+  component. The per-vertex attribute values (if S3L_MAX_ATTRIBUTES > 0) are
+  taken from S3L_triangleAttributes, which S3L_drawScene fills from the
+  model's attribute streams -- if you call this function directly, fill them
+  yourself. */
 extern void S3L_drawTriangle(
   S3L_Vec4 point0,
   S3L_Vec4 point1,
@@ -351,6 +491,20 @@ extern void S3L_newFrame(void);
 
 extern void S3L_stencilBufferClear(void);
 extern void S3L_drawScene(S3L_Scene scene);
+/** Clears the visibility buffer (if enabled), this is done automatically by
+  S3L_newFrame. */
+extern void S3L_visibilityBufferClear(void);
+/** With S3L_VISIBILITY_BUFFER on, this has to be called after drawing the
+  frame (S3L_drawScene). It calls the pixel function once for every covered
+  pixel, grouped by triangle (in the order the triangles were rasterized),
+  each triangle's pixels in the order of rows from top down, left to right.
+  The passed pixel info doesn't contain previousZ, depth is only available
+  with S3L_Z_BUFFER == 1. The scene has to be the one that was drawn, it is
+  needed to get the models' attributes. The triangle function (if defined) is
+  called once before the pixels of each visible triangle (and not while
+  rasterizing), the passed info only contains the indices, ID and size here
+  (the points are zero). Without the visibility buffer this does nothing. */
+extern void S3L_resolveVisibilityBuffer(S3L_Scene scene);
 /** Predefined vertices of a cube to simply insert in an array. These come with
     S3L_CUBE_TRIANGLES and S3L_CUBE_TEXCOORDS. */
 #define S3L_CUBE_VERTICES(m)\
@@ -1628,6 +1628,16 @@ const S3L_Index carUVIndices[CAR_UV_INDEX_COUNT * 3] = {
 S3L_Model3D cityModel;
 S3L_Model3D carModel;
 
+#if S3L_MAX_ATTRIBUTES > 0
+static const S3L_AttributeStream cityAttributes[] = {
+  { cityUVs, cityUVIndices, 2 }
+};
+
+static const S3L_AttributeStream carAttributes[] = {
+  { carUVs, carUVIndices, 2 }
+};
+#endif
+
 void cityModelInit(void)
 {
   S3L_initModel3D(
@@ -1636,6 +1646,11 @@ void cityModelInit(void)
     cityTriangleIndices,
     CITY_TRIANGLE_COUNT,
     &cityModel);
+
+#if S3L_MAX_ATTRIBUTES > 0
+  cityModel.attributes = cityAttributes;
+  cityModel.attributeCount = 1;
+#endif
 }
 void carModelInit(void)
 {
@@ -1645,4 +1660,62 @@ void carModelInit(void)
     carTriangleIndices,
     CAR_TRIANGLE_COUNT,
     &carModel);
+
+#if S3L_MAX_ATTRIBUTES > 0
+  carModel.attributes = carAttributes;
+  carModel.attributeCount = 1;
+#endif
+}
+
+#if S3L_TEXTURE_LAYOUT != S3L_TEXTURE_LAYOUT_ROWS
+// the texture data above is in rows, it's swizzled to RAM at init
+static uint8_t cityTextureSwizzled[CITY_TEXTURE_WIDTH * CITY_TEXTURE_HEIGHT];
+#endif
+
+#if S3L_MIP_LEVELS > 1
+static uint8_t cityTextureMips[(CITY_TEXTURE_WIDTH * CITY_TEXTURE_HEIGHT) / 3];
+#endif
+
+#if S3L_LIGHTING
+static uint16_t cityShadedPalettes[S3L_SHADE_LEVELS * 256];
+#endif
+
+S3L_Material cityMaterials[CITY_MATERIAL_COUNT];
+
+// the car is textured from the city texture too
+static const S3L_MaterialRange cityMaterialRanges[] = { { 0, 0 } };
+static const S3L_MaterialRange carMaterialRanges[] = { { 0, 0 } };
+
+const S3L_ModelMaterials cityModelMaterials = { cityMaterialRanges, 1 };
+const S3L_ModelMaterials carModelMaterials = { carMaterialRanges, 1 };
+
+void cityMaterialsInit(void)
+{
+  S3L_Material *m = &cityMaterials[0];
+
+  m->texels = cityTexture;
+  m->mips = 0;
+  m->palette = cityPalette;
+  m->logWidth = CITY_TEXTURE_LOG_WIDTH;
+  m->logHeight = CITY_TEXTURE_LOG_HEIGHT;
+  m->mipLevels = 1;
+  m->uvAttribute = 0;
+
+#if S3L_TEXTURE_LAYOUT != S3L_TEXTURE_LAYOUT_ROWS
+  S3L_swizzleTexture(cityTexture,CITY_TEXTURE_LOG_WIDTH,
+    CITY_TEXTURE_LOG_HEIGHT,cityTextureSwizzled);
+  m->texels = cityTextureSwizzled;
+#endif
+
+#if S3L_MIP_LEVELS > 1
+  S3L_buildMipChain(m->texels,CITY_TEXTURE_LOG_WIDTH,CITY_TEXTURE_LOG_HEIGHT,
+    cityPalette,S3L_MIP_LEVELS,cityTextureMips);
+  m->mips = cityTextureMips;
+  m->mipLevels = S3L_MIP_LEVELS;
+#endif
+
+#if S3L_LIGHTING
+  S3L_buildShadedPalettes(cityPalette,cityShadedPalettes);
+  m->shadedPalettes = cityShadedPalettes;
+#endif
 }
@@ -4,8 +4,12 @@
 extern "C" {
 #endif
 #include "S3L_types.h"
+#include "S3L_texture.h"
 #define CITY_TEXTURE_WIDTH 128
 #define CITY_TEXTURE_HEIGHT 128
+#define CITY_TEXTURE_LOG_WIDTH 7
+#define CITY_TEXTURE_LOG_HEIGHT 7
+#define CITY_MATERIAL_COUNT 1
 #define CITY_VERTEX_COUNT 155
 
 #define CITY_TRIANGLE_COUNT 197
@@ -28,9 +32,13 @@ extern const S3L_Unit carUVs[CAR_UV_COUNT * 2] ;
 extern const S3L_Index carUVIndices[CAR_UV_INDEX_COUNT * 3] ;
 extern S3L_Model3D cityModel;
 extern S3L_Model3D carModel;
+extern S3L_Material cityMaterials[CITY_MATERIAL_COUNT];
+extern const S3L_ModelMaterials cityModelMaterials;
+extern const S3L_ModelMaterials carModelMaterials;
 
 extern void cityModelInit(void);
 extern void carModelInit(void);
+extern void cityMaterialsInit(void);
 #ifdef __cplusplus
 }
 #endif
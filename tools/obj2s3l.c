@@ -0,0 +1,1275 @@
+/*
+  Offline asset converter: Wavefront OBJ/MTL (+ PPM images) to the library's
+  fixed point format, either as C arrays (like texture_model.c) or as the
+  binary asset format of S3L_asset.h.
+
+  usage: obj2s3l [options] input.obj
+    -o FILE   output file (.c/.h pair with -c, binary asset otherwise)
+    -c NAME   emit C arrays with given name prefix instead of binary
+    -s SCALE  scale of positions (1.0 = one OBJ unit is S3L_FRACTIONS_PER_UNIT)
+    -m LEVELS number of MIP levels to store with textures (default 1)
+    -n        don't flip V (OBJ has V going up, textures are stored top down)
+    -q        store quantized int16_t vertices (needs S3L_QUANTIZED_VERTICES)
+    -t        store triangles as a strip if it's smaller (needs
+              S3L_TRIANGLE_STRIPS)
+    -l ANGLE  store normals for S3L_LIGHTING, edges sharper than ANGLE degrees
+              are kept hard (with -t normals are always smooth, one per
+              vertex)
+
+  All objects in the file make one model. Polygons are triangulated as fans,
+  triangles are sorted by material (each material makes one material range)
+  and reordered for vertex cache locality inside each range. Positions and
+  UVs are indexed separately, exactly as in the OBJ, so UV seams don't
+  duplicate vertices. All textures share one palette of up to 256 colors
+  (median cut if the images have more colors). Textures must be PPM (P3 or
+  P6) with power of two sizes; they're stored in S3L_TEXTURE_LAYOUT.
+
+  This is a host tool, it uses the C standard library freely.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "S3L_types.h"
+#include "S3L_texture.h"
+#include "S3L_asset.h"
+#include "S3L_mesh.h"
+#include "small3dlib.h"
+
+#define MAX_MATERIALS 64
+#define MAX_NAME 256
+#define VERTEX_CACHE_SIZE 16 // simulated for the triangle reordering
+
+typedef struct
+{
+  char name[MAX_NAME];
+  char image[2 * MAX_NAME];
+  int texture;               // index to textures, -1 = none
+} Material;
+
+typedef struct
+{
+  char fileName[2 * MAX_NAME];
+  uint8_t logW, logH;
+  uint8_t *rgb;              // 3 bytes per pixel, rows
+  uint8_t *texels;           // palette indices in S3L_TEXTURE_LAYOUT + MIPs
+  uint32_t texelCount;       // including MIPs
+} Texture;
+
+typedef struct
+{
+  uint32_t position[3];
+  uint32_t uv[3];
+  int material;
+} Triangle;
+
+static double *positions, *uvs;
+static uint32_t positionCount, uvCount, positionCapacity, uvCapacity;
+
+static Triangle *triangles;
+static uint32_t triangleCount, triangleCapacity;
+
+static Material materials[MAX_MATERIALS];
+static int materialCount;
+
+static Texture textures[MAX_MATERIALS];
+static int textureCount;
+
+static uint16_t palette[256];
+static int paletteSize;
+
+static double scale = 1.0;
+static int flipV = 1;
+static int quantizeVertices = 0;
+static int makeStrip = 0;
+static double normalAngle = -1; // < 0: no normals
+static uint8_t mipLevels = 1;
+
+static void fail(const char *message, const char *detail)
+{
+  fprintf(stderr,"obj2s3l: %s%s%s\n",message,detail ? ": " : "",
+    detail ? detail : "");
+  exit(1);
+}
+
+static void *grow(void *array, uint32_t *capacity, uint32_t needed,
+  size_t itemSize)
+{
+  if (needed <= *capacity)
+    return array;
+
+  *capacity = needed * 2;
+
+  array = realloc(array,*capacity * itemSize);
+
+  if (!array)
+    fail("out of memory",0);
+
+  return array;
+}
+
+static void directoryOf(const char *path, char *result)
+{
+  const char *slash = strrchr(path,'/');
+  size_t length = slash ? (size_t) (slash - path + 1) : 0;
+
+  memcpy(result,path,length);
+  result[length] = 0;
+}
+
+//------------------------------------------------------------------------------
+// PPM images
+
+static int ppmNumber(FILE *f)
+{
+  int c = fgetc(f);
+
+  while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+  {
+    if (c == '#')
+      while (c != '\n' && c != EOF)
+        c = fgetc(f);
+
+    c = fgetc(f);
+  }
+
+  int result = 0;
+
+  if (c < '0' || c > '9')
+    return -1;
+
+  while (c >= '0' && c <= '9')
+  {
+    result = result * 10 + c - '0';
+    c = fgetc(f);
+  }
+
+  return result;
+}
+
+static uint8_t logOf(int size, const char *fileName)
+{
+  uint8_t result = 0;
+
+  while ((1 << result) < size)
+    result++;
+
+  if ((1 << result) != size)
+    fail("texture size not a power of two",fileName);
+
+  if (size > S3L_FRACTIONS_PER_UNIT) // UVs can't address more texels
+    fail("texture bigger than S3L_FRACTIONS_PER_UNIT",fileName);
+
+  return result;
+}
+
+static void loadPPM(Texture *t)
+{
+  FILE *f = fopen(t->fileName,"rb");
+
+  if (!f)
+    fail("can't open image",t->fileName);
+
+  int binary;
+
+  if (fgetc(f) != 'P')
+    fail("not a PPM image",t->fileName);
+
+  switch (fgetc(f))
+  {
+    case '6': binary = 1; break;
+    case '3': binary = 0; break;
+    default: fail("unsupported PPM type (P3/P6 only)",t->fileName);
+  }
+
+  int w = ppmNumber(f), h = ppmNumber(f), maxValue = ppmNumber(f);
+
+  if (w <= 0 || h <= 0 || maxValue <= 0 || maxValue > 255)
+    fail("bad PPM header",t->fileName);
+
+  t->logW = logOf(w,t->fileName);
+  t->logH = logOf(h,t->fileName);
+  t->rgb = malloc(w * h * 3);
+
+  for (int i = 0; i < w * h * 3; ++i)
+  {
+    int v = binary ? fgetc(f) : ppmNumber(f);
+
+    if (v < 0)
+      fail("truncated PPM",t->fileName);
+
+    t->rgb[i] = (v * 255) / maxValue;
+  }
+
+  fclose(f);
+}
+
+//------------------------------------------------------------------------------
+// OBJ/MTL
+
+static int findMaterial(const char *name)
+{
+  for (int i = 0; i < materialCount; ++i)
+    if (strcmp(materials[i].name,name) == 0)
+      return i;
+
+  return -1;
+}
+
+static void loadMTL(const char *fileName)
+{
+  FILE *f = fopen(fileName,"r");
+
+  if (!f)
+    fail("can't open material library",fileName);
+
+  char line[1024], directory[MAX_NAME], name[MAX_NAME];
+  Material *current = 0;
+
+  directoryOf(fileName,directory);
+
+  while (fgets(line,sizeof(line),f))
+  {
+    if (sscanf(line," newmtl %255s",name) == 1)
+    {
+      if (materialCount >= MAX_MATERIALS)
+        fail("too many materials",fileName);
+
+      current = materials + materialCount;
+      materialCount++;
+
+      strcpy(current->name,name);
+      current->image[0] = 0;
+      current->texture = -1;
+    }
+    else if (current && sscanf(line," map_Kd %255s",name) == 1)
+      snprintf(current->image,sizeof(current->image),"%s%s",directory,name);
+  }
+
+  fclose(f);
+}
+
+/* Converts an OBJ index (1 based or negative relative) to 0 based. */
+static uint32_t objIndex(long index, uint32_t count)
+{
+  long result = index > 0 ? index - 1 : (long) count + index;
+
+  if (result < 0 || result >= (long) count)
+    fail("index out of range in a face",0);
+
+  return result;
+}
+
+static void loadOBJ(const char *fileName)
+{
+  FILE *f = fopen(fileName,"r");
+
+  if (!f)
+    fail("can't open",fileName);
+
+  char line[4096], directory[MAX_NAME], name[MAX_NAME], path[2 * MAX_NAME];
+  int material = -1;
+
+  directoryOf(fileName,directory);
+
+  while (fgets(line,sizeof(line),f))
+  {
+    double x, y, z;
+
+    if (sscanf(line," v %lf %lf %lf",&x,&y,&z) == 3)
+    {
+      positions = grow(positions,&positionCapacity,(positionCount + 1) * 3,
+        sizeof(double));
+
+      positions[positionCount * 3] = x;
+      positions[positionCount * 3 + 1] = y;
+      positions[positionCount * 3 + 2] = z;
+      positionCount++;
+    }
+    else if (sscanf(line," vt %lf %lf",&x,&y) == 2)
+    {
+      uvs = grow(uvs,&uvCapacity,(uvCount + 1) * 2,sizeof(double));
+
+      uvs[uvCount * 2] = x;
+      uvs[uvCount * 2 + 1] = flipV ? 1.0 - y : y;
+      uvCount++;
+    }
+    else if (sscanf(line," mtllib %255s",name) == 1)
+    {
+      snprintf(path,sizeof(path),"%s%s",directory,name);
+      loadMTL(path);
+    }
+    else if (sscanf(line," usemtl %255s",name) == 1)
+    {
+      material = findMaterial(name);
+
+      if (material < 0)
+        fail("unknown material",name);
+    }
+    else if (line[0] == 'f' && line[1] == ' ')
+    {
+      uint32_t p[3], t[3], corner = 0;
+      char *c = line + 2;
+
+      while (1) // read corners "p/t/n", triangulate as a fan
+      {
+        char *end;
+        long pi = strtol(c,&end,10), ti = 0;
+
+        if (end == c)
+          break;
+
+        c = end;
+
+        if (*c == '/')
+        {
+          c++;
+          ti = strtol(c,&end,10);
+          c = end;
+
+          while (*c != 0 && *c != ' ' && *c != '\t' && *c != '\n' &&
+            *c != '\r')
+            c++; // skip normal
+        }
+
+        if (ti == 0)
+          fail("face without UVs",fileName);
+
+        uint32_t slot = corner < 2 ? corner : 2;
+
+        p[slot] = objIndex(pi,positionCount);
+        t[slot] = objIndex(ti,uvCount);
+
+        if (corner >= 2)
+        {
+          triangles = grow(triangles,&triangleCapacity,triangleCount + 1,
+            sizeof(Triangle));
+
+          Triangle *tri = triangles + triangleCount;
+          triangleCount++;
+
+          for (int i = 0; i < 3; ++i)
+          {
+            tri->position[i] = p[i];
+            tri->uv[i] = t[i];
+          }
+
+          tri->material = material < 0 ? 0 : material;
+
+          p[1] = p[2]; // next triangle of the fan
+          t[1] = t[2];
+        }
+
+        corner++;
+      }
+    }
+  }
+
+  fclose(f);
+
+  if (materialCount == 0)
+    fail("no materials (textures are needed)",fileName);
+
+  if (triangleCount == 0)
+    fail("no faces",fileName);
+}
+
+//------------------------------------------------------------------------------
+// palette
+
+typedef struct
+{
+  uint16_t color;            // 12 bit, 4 bits per channel: r g b
+  uint32_t count;
+} PaletteEntry;
+
+static uint8_t channelOf(uint16_t color, int channel)
+{
+  return (color >> (8 - 4 * channel)) & 0x0f;
+}
+
+static int sortChannel;
+
+static int compareEntries(const void *a, const void *b)
+{
+  return channelOf(((const PaletteEntry *) a)->color,sortChannel) -
+    channelOf(((const PaletteEntry *) b)->color,sortChannel);
+}
+
+/* Median cut over the histogram of 12 bit colors. */
+static void buildPalette(void)
+{
+  static uint32_t histogram[4096];
+  static PaletteEntry entries[4096];
+  int entryCount = 0;
+
+  for (int t = 0; t < textureCount; ++t)
+    for (uint32_t i = 0; i < (1u << (textures[t].logW + textures[t].logH));
+      ++i)
+    {
+      const uint8_t *p = textures[t].rgb + i * 3;
+      histogram[((p[0] >> 4) << 8) | ((p[1] >> 4) << 4) | (p[2] >> 4)]++;
+    }
+
+  for (int i = 0; i < 4096; ++i)
+    if (histogram[i])
+    {
+      entries[entryCount].color = i;
+      entries[entryCount].count = histogram[i];
+      entryCount++;
+    }
+
+  int boxStart[256], boxEnd[256], boxCount = 1;
+
+  boxStart[0] = 0;
+  boxEnd[0] = entryCount;
+
+  while (boxCount < 256)
+  {
+    int best = -1, bestRange = 0, bestChannel = 0;
+
+    for (int b = 0; b < boxCount; ++b)
+      for (int c = 0; c < 3; ++c)
+      {
+        int lo = 15, hi = 0;
+
+        for (int i = boxStart[b]; i < boxEnd[b]; ++i)
+        {
+          int v = channelOf(entries[i].color,c);
+          lo = v < lo ? v : lo;
+          hi = v > hi ? v : hi;
+        }
+
+        if (hi - lo > bestRange)
+        {
+          best = b;
+          bestRange = hi - lo;
+          bestChannel = c;
+        }
+      }
+
+    if (best < 0)
+      break; // all boxes are single colors
+
+    sortChannel = bestChannel;
+    qsort(entries + boxStart[best],boxEnd[best] - boxStart[best],
+      sizeof(PaletteEntry),compareEntries);
+
+    // split at the median pixel count
+    uint64_t total = 0, sum = 0;
+
+    for (int i = boxStart[best]; i < boxEnd[best]; ++i)
+      total += entries[i].count;
+
+    int split = boxStart[best] + 1;
+
+    while (split < boxEnd[best] - 1 && (sum + entries[split - 1].count) * 2 <
+      total)
+    {
+      sum += entries[split - 1].count;
+      split++;
+    }
+
+    boxStart[boxCount] = split;
+    boxEnd[boxCount] = boxEnd[best];
+    boxEnd[best] = split;
+    boxCount++;
+  }
+
+  paletteSize = boxCount;
+
+  for (int b = 0; b < 256; ++b)
+  {
+    double sum[3] = {0, 0, 0};
+    uint64_t count = 0;
+
+    if (b < boxCount)
+      for (int i = boxStart[b]; i < boxEnd[b]; ++i)
+      {
+        for (int c = 0; c < 3; ++c)
+          sum[c] += channelOf(entries[i].color,c) * (double) entries[i].count;
+
+        count += entries[i].count;
+      }
+
+    uint8_t rgb[3] = {0, 0, 0};
+
+    if (count)
+      for (int c = 0; c < 3; ++c)
+        rgb[c] = (uint8_t) (sum[c] / count + 0.5);
+
+    palette[b] = S3L_color(rgb[0],rgb[1],rgb[2],0x0f);
+  }
+}
+
+static uint8_t closestColor(uint8_t r, uint8_t g, uint8_t b)
+{
+  int best = 0, bestDistance = 1 << 30;
+
+  for (int i = 0; i < paletteSize; ++i)
+  {
+    int dr = S3L_colorR(palette[i]) - r,
+        dg = S3L_colorG(palette[i]) - g,
+        db = S3L_colorB(palette[i]) - b;
+
+    int distance = dr * dr + dg * dg + db * db;
+
+    if (distance < bestDistance)
+    {
+      best = i;
+      bestDistance = distance;
+    }
+  }
+
+  return best;
+}
+
+static void buildTextures(void)
+{
+  for (int t = 0; t < textureCount; ++t)
+  {
+    Texture *tex = textures + t;
+    uint32_t size = 1u << (tex->logW + tex->logH);
+    uint8_t *rows = malloc(size);
+
+    for (uint32_t i = 0; i < size; ++i)
+      rows[i] = closestColor(tex->rgb[i * 3] >> 4,tex->rgb[i * 3 + 1] >> 4,
+        tex->rgb[i * 3 + 2] >> 4);
+
+    tex->texelCount = size + S3L_mipChainSize(tex->logW,tex->logH,mipLevels);
+    tex->texels = malloc(tex->texelCount);
+
+    S3L_swizzleTexture(rows,tex->logW,tex->logH,tex->texels);
+    S3L_buildMipChain(tex->texels,tex->logW,tex->logH,palette,mipLevels,
+      tex->texels + size);
+
+    free(rows);
+  }
+}
+
+static void loadTextures(void)
+{
+  for (int m = 0; m < materialCount; ++m)
+  {
+    if (materials[m].image[0] == 0)
+      fail("material without a texture (map_Kd)",materials[m].name);
+
+    for (int t = 0; t < textureCount; ++t)
+      if (strcmp(textures[t].fileName,materials[m].image) == 0)
+        materials[m].texture = t;
+
+    if (materials[m].texture < 0)
+    {
+      Texture *t = textures + textureCount;
+
+      strcpy(t->fileName,materials[m].image);
+      loadPPM(t);
+      materials[m].texture = textureCount;
+      textureCount++;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// geometry
+
+static S3L_Unit *outVertices, *outUVs;
+static S3L_Index *outTriangles, *outUVIndices;
+static uint32_t outVertexCount, outUVCount;
+static S3L_MaterialRange outRanges[MAX_MATERIALS];
+static int outRangeCount;
+static int16_t *outQuantized;
+static S3L_Unit outQuantization[6]; // scale x, y, z, offset x, y, z
+static uint32_t outIndexCount;      // triangle (and UV) indices
+static int outStrip;
+static S3L_Unit *outNormals;
+static S3L_Index *outNormalIndices; // 0 for per vertex normals
+static uint32_t outNormalCount;
+
+static int compareMaterials(const void *a, const void *b)
+{
+  const Triangle *t1 = a, *t2 = b;
+
+  if (t1->material != t2->material)
+    return t1->material - t2->material;
+
+  return t1 < t2 ? -1 : 1; // keep the order otherwise (qsort isn't stable)
+}
+
+/* Greedy reordering of triangles from..to for a FIFO vertex cache: always
+   take the triangle with the most vertices in the (simulated) cache. */
+static void reorderForCache(uint32_t from, uint32_t to)
+{
+  uint32_t cache[VERTEX_CACHE_SIZE];
+  int cacheFill = 0;
+
+  for (uint32_t i = from; i < to; ++i)
+  {
+    uint32_t best = i;
+    int bestHits = -1;
+
+    for (uint32_t j = i; j < to && bestHits < 3; ++j)
+    {
+      int hits = 0;
+
+      for (int k = 0; k < 3; ++k)
+        for (int c = 0; c < cacheFill; ++c)
+          if (cache[c] == triangles[j].position[k])
+          {
+            hits++;
+            break;
+          }
+
+      if (hits > bestHits)
+      {
+        best = j;
+        bestHits = hits;
+      }
+    }
+
+    Triangle tmp = triangles[i];
+    triangles[i] = triangles[best];
+    triangles[best] = tmp;
+
+    for (int k = 0; k < 3; ++k)
+    {
+      int cached = 0;
+
+      for (int c = 0; c < cacheFill; ++c)
+        if (cache[c] == triangles[i].position[k])
+          cached = 1;
+
+      if (!cached)
+      {
+        if (cacheFill < VERTEX_CACHE_SIZE)
+          cacheFill++;
+
+        memmove(cache + 1,cache,(cacheFill - 1) * sizeof(uint32_t));
+        cache[0] = triangles[i].position[k];
+      }
+    }
+  }
+}
+
+static S3L_Unit quantize(double value)
+{
+  return (S3L_Unit) floor(value * S3L_FRACTIONS_PER_UNIT + 0.5);
+}
+
+/* Sorts and reorders triangles, numbers vertices and UVs in the order of
+   first use (dropping unused and duplicate ones) and quantizes them. */
+static void buildGeometry(void)
+{
+  qsort(triangles,triangleCount,sizeof(Triangle),compareMaterials);
+
+  for (uint32_t i = 0; i < triangleCount; ++i)
+    if (i == 0 || triangles[i].material != triangles[i - 1].material)
+    {
+      outRanges[outRangeCount].firstTriangle = i;
+      outRanges[outRangeCount].material = triangles[i].material;
+      outRangeCount++;
+    }
+
+  for (int r = 0; r < outRangeCount; ++r)
+    reorderForCache(outRanges[r].firstTriangle,r + 1 < outRangeCount ?
+      outRanges[r + 1].firstTriangle : triangleCount);
+
+  uint32_t *positionMap = malloc(positionCount * sizeof(uint32_t));
+  uint32_t *uvMap = malloc(uvCount * sizeof(uint32_t));
+
+  memset(positionMap,0xff,positionCount * sizeof(uint32_t));
+  memset(uvMap,0xff,uvCount * sizeof(uint32_t));
+
+  outVertices = malloc(positionCount * 3 * sizeof(S3L_Unit));
+  outUVs = malloc(uvCount * 2 * sizeof(S3L_Unit));
+  outTriangles = malloc(triangleCount * 3 * sizeof(S3L_Index));
+  outUVIndices = malloc(triangleCount * 3 * sizeof(S3L_Index));
+
+  for (uint32_t i = 0; i < triangleCount; ++i)
+    for (int k = 0; k < 3; ++k)
+    {
+      uint32_t p = triangles[i].position[k], t = triangles[i].uv[k];
+
+      if (positionMap[p] == 0xffffffff)
+      {
+        for (int c = 0; c < 3; ++c)
+          outVertices[outVertexCount * 3 + c] =
+            quantize(positions[p * 3 + c] * scale);
+
+        positionMap[p] = outVertexCount;
+        outVertexCount++;
+      }
+
+      if (uvMap[t] == 0xffffffff)
+      {
+        S3L_Unit u = quantize(uvs[t * 2]), v = quantize(uvs[t * 2 + 1]);
+
+        uvMap[t] = outUVCount;
+
+        for (uint32_t j = 0; j < outUVCount; ++j) // merge equal UVs
+          if (outUVs[j * 2] == u && outUVs[j * 2 + 1] == v)
+          {
+            uvMap[t] = j;
+            break;
+          }
+
+        if (uvMap[t] == outUVCount)
+        {
+          outUVs[outUVCount * 2] = u;
+          outUVs[outUVCount * 2 + 1] = v;
+          outUVCount++;
+        }
+      }
+
+      outTriangles[i * 3 + k] = positionMap[p];
+      outUVIndices[i * 3 + k] = uvMap[t];
+    }
+
+  if (outVertexCount > (S3L_Index) ~0 || outUVCount > (S3L_Index) ~0 ||
+    triangleCount > (S3L_Index) ~0)
+    fail("too many vertices/UVs/triangles for S3L_Index",0);
+
+  outIndexCount = triangleCount * 3;
+
+  free(positionMap);
+  free(uvMap);
+}
+
+/* Same as S3L_quantizeVertices: offset in the middle of the bounds and the
+   finest scale (but not under one S3L_Unit) that fits into int16_t. */
+static void buildQuantized(void)
+{
+  outQuantized = malloc(outVertexCount * 3 * sizeof(int16_t));
+
+  for (int c = 0; c < 3; ++c)
+  {
+    S3L_Unit lo = outVertices[c], hi = outVertices[c];
+
+    for (uint32_t i = 1; i < outVertexCount; ++i)
+    {
+      S3L_Unit v = outVertices[i * 3 + c];
+      lo = v < lo ? v : lo;
+      hi = v > hi ? v : hi;
+    }
+
+    S3L_Unit offset = lo + (hi - lo) / 2;
+    int64_t scale = (((int64_t) (hi - offset)) * S3L_FRACTIONS_PER_UNIT +
+      32766) / 32767;
+
+    if (scale < S3L_FRACTIONS_PER_UNIT)
+      scale = S3L_FRACTIONS_PER_UNIT;
+
+    outQuantization[c] = scale;
+    outQuantization[3 + c] = offset;
+
+    for (uint32_t i = 0; i < outVertexCount; ++i)
+      outQuantized[i * 3 + c] = (int16_t) floor(
+        ((double) (outVertices[i * 3 + c] - offset)) * S3L_FRACTIONS_PER_UNIT /
+        scale + 0.5);
+  }
+}
+
+/* Computes normals of the triangles (before making a strip): split at hard
+   edges into an indexed stream, or smooth per vertex for strips, whose
+   normal indices would need the strip layout. */
+static void buildNormals(void)
+{
+  S3L_Model3D model;
+  S3L_VertexAdjacency adjacency;
+
+  S3L_initModel3D(outVertices,outVertexCount,outTriangles,triangleCount,
+    &model);
+
+  adjacency.start = malloc((outVertexCount + 1) * sizeof(uint32_t));
+  adjacency.triangles = malloc(triangleCount * 3 * sizeof(S3L_Index));
+
+  S3L_buildVertexAdjacency(&model,&adjacency);
+
+  if (makeStrip)
+  {
+    outNormals = malloc(outVertexCount * 3 * sizeof(S3L_Unit));
+    outNormalCount = outVertexCount;
+
+    S3L_computeNormals(&model,&adjacency,S3L_NORMALS_ANGLE,0,outVertexCount,
+      outNormals);
+  }
+  else
+  {
+    outNormals = malloc(triangleCount * 9 * sizeof(S3L_Unit));
+    outNormalIndices = malloc(triangleCount * 3 * sizeof(S3L_Index));
+
+    outNormalCount = S3L_computeSplitNormals(&model,&adjacency,
+      S3L_NORMALS_ANGLE,quantize(cos(normalAngle * 3.14159265358979 / 180)),
+      outNormals,outNormalIndices);
+  }
+
+  free(adjacency.start);
+  free(adjacency.triangles);
+}
+
+/* Converts the triangles and UV indices to a strip if it takes fewer
+   indices, material ranges are then rewritten to strip triangles. */
+static void buildStrip(void)
+{
+  if (triangleCount == 0)
+    return; // an empty strip has no triangle count + 2 indices
+
+  uint32_t size = S3L_TRIANGLE_STRIP_MAX_SIZE(triangleCount);
+
+  S3L_Index *strip = malloc(size * sizeof(S3L_Index));
+  S3L_Index *uvStrip = malloc(size * sizeof(S3L_Index));
+  void *work = malloc(S3L_TRIANGLE_STRIP_WORK_SIZE(outVertexCount,
+    triangleCount));
+
+  S3L_MaterialRange ranges[MAX_MATERIALS];
+
+  memcpy(ranges,outRanges,sizeof(ranges));
+
+  uint32_t length = S3L_makeTriangleStrip(outTriangles,outUVIndices,
+    triangleCount,outVertexCount,ranges,outRangeCount,strip,uvStrip,work);
+
+  printf("strip: %u indices instead of %u\n",length,outIndexCount);
+
+  if (length >= 3 && length < outIndexCount && length - 2 <= (S3L_Index) ~0)
+  {
+    free(outTriangles);
+    free(outUVIndices);
+    outTriangles = strip;
+    outUVIndices = uvStrip;
+    outIndexCount = length;
+    triangleCount = length - 2; // from now on the strip's triangles
+    memcpy(outRanges,ranges,sizeof(ranges));
+    outStrip = 1;
+  }
+  else
+  {
+    free(strip);
+    free(uvStrip);
+  }
+
+  free(work);
+}
+
+//------------------------------------------------------------------------------
+// output
+
+static FILE *openOutput(const char *fileName, const char *mode)
+{
+  FILE *f = fopen(fileName,mode);
+
+  if (!f)
+    fail("can't write",fileName);
+
+  return f;
+}
+
+static void writeUnits(FILE *f, const char *type, const char *name,
+  const char *count, const void *data, uint32_t n, int perLine)
+{
+  fprintf(f,"const %s %s[%s] = {\n",type,name,count);
+
+  for (uint32_t i = 0; i < n; ++i)
+  {
+    long v = strcmp(type,"S3L_Index") == 0 ? (long) ((const S3L_Index *) data)[i] :
+      (strcmp(type,"int16_t") == 0 ? (long) ((const int16_t *) data)[i] :
+      (long) ((const S3L_Unit *) data)[i]);
+
+    fprintf(f,"%s%6ld%s",i % perLine == 0 ? "  " : "",v,
+      i + 1 < n ? "," : " ");
+
+    if (i % perLine == (uint32_t) perLine - 1 || i + 1 == n)
+      fprintf(f,"        // %u\n",i - i % perLine);
+  }
+
+  fprintf(f,"}; // %s\n\n",name);
+}
+
+static void writeC(const char *fileName, const char *name)
+{
+  char upper[MAX_NAME], path[MAX_NAME + 8], headerName[MAX_NAME + 8];
+  size_t i;
+
+  for (i = 0; name[i] && i < MAX_NAME - 1; ++i)
+    upper[i] = (name[i] >= 'a' && name[i] <= 'z') ? name[i] - 32 : name[i];
+
+  upper[i] = 0;
+
+  snprintf(path,sizeof(path),"%s.h",fileName);
+
+  const char *slash = strrchr(path,'/');
+  snprintf(headerName,sizeof(headerName),"%s",slash ? slash + 1 : path);
+
+  FILE *f = openOutput(path,"w");
+
+  fprintf(f,"// generated by obj2s3l, don't edit\n\n");
+  fprintf(f,"#ifndef _%s_MODEL_H__\n#define _%s_MODEL_H__\n",upper,upper);
+  fprintf(f,"#ifdef __cplusplus\nextern \"C\" {\n#endif\n");
+  fprintf(f,"#include \"S3L_types.h\"\n#include \"S3L_texture.h\"\n\n");
+  fprintf(f,"#define %s_VERTEX_COUNT %u\n",upper,outVertexCount);
+  fprintf(f,"#define %s_TRIANGLE_COUNT %u\n",upper,triangleCount);
+  fprintf(f,"#define %s_INDEX_COUNT %u%s\n",upper,outIndexCount,
+    outStrip ? " // triangle strip" : "");
+  fprintf(f,"#define %s_UV_COUNT %u\n",upper,outUVCount);
+
+  if (outNormals)
+    fprintf(f,"#define %s_NORMAL_COUNT %u\n",upper,outNormalCount);
+
+  fprintf(f,"#define %s_MATERIAL_COUNT %d\n",upper,materialCount);
+  fprintf(f,"#define %s_MATERIAL_RANGE_COUNT %d\n\n",upper,outRangeCount);
+  fprintf(f,"extern const uint16_t %sPalette[256];\n",name);
+
+  for (int t = 0; t < textureCount; ++t)
+    fprintf(f,"extern const uint8_t %sTexture%d[%u];\n",name,t,
+      textures[t].texelCount);
+
+  fprintf(f,"extern const %s %s%sVertices[%s_VERTEX_COUNT * 3];\n",
+    quantizeVertices ? "int16_t" : "S3L_Unit",name,
+    quantizeVertices ? "Quantized" : "",upper);
+  fprintf(f,"extern const S3L_Index %sTriangleIndices[%s_INDEX_COUNT];\n",
+    name,upper);
+  fprintf(f,"extern const S3L_Unit %sUVs[%s_UV_COUNT * 2];\n",name,upper);
+  fprintf(f,"extern const S3L_Index %sUVIndices[%s_INDEX_COUNT];\n",
+    name,upper);
+
+  if (outNormals)
+    fprintf(f,"extern const S3L_Unit %sNormals[%s_NORMAL_COUNT * 3];\n",name,
+      upper);
+
+  if (outNormalIndices)
+    fprintf(f,"extern const S3L_Index %sNormalIndices[%s_INDEX_COUNT];\n",
+      name,upper);
+
+  fprintf(f,"extern const S3L_Material %sMaterials[%s_MATERIAL_COUNT];\n",
+    name,upper);
+  fprintf(f,"extern const S3L_ModelMaterials %sModelMaterials;\n",name);
+  fprintf(f,"extern S3L_Model3D %sModel;\n\n",name);
+  fprintf(f,"extern void %sModelInit(void);\n",name);
+  fprintf(f,"#ifdef __cplusplus\n}\n#endif\n#endif\n");
+  fclose(f);
+
+  snprintf(path,sizeof(path),"%s.c",fileName);
+  f = openOutput(path,"w");
+
+  fprintf(f,"// generated by obj2s3l, don't edit\n\n");
+  fprintf(f,"#include <stdint.h>\n#include \"%s\"\n#include \"small3dlib.h\"\n\n",
+    headerName);
+
+  fprintf(f,"#if S3L_TEXTURE_LAYOUT != %d || S3L_FRACTIONS_PER_UNIT != %d%s%s\n",
+    S3L_TEXTURE_LAYOUT,S3L_FRACTIONS_PER_UNIT,
+    quantizeVertices ? " || !S3L_QUANTIZED_VERTICES" : "",
+    outStrip ? " || !S3L_TRIANGLE_STRIPS" : "");
+  fprintf(f,"  #error %s was converted for a different configuration\n#endif\n\n",
+    name);
+
+  fprintf(f,"const uint16_t %sPalette[256] = {\n",name);
+
+  for (int c = 0; c < 256; ++c)
+    fprintf(f,"0x%x%s",palette[c],c % 8 == 7 ? ",\n" : ",");
+
+  fprintf(f,"}; // %sPalette\n\n",name);
+
+  for (int t = 0; t < textureCount; ++t)
+  {
+    fprintf(f,"// %s, %dx%d, %d MIP levels\n",textures[t].fileName,
+      1 << textures[t].logW,1 << textures[t].logH,mipLevels);
+    fprintf(f,"const uint8_t %sTexture%d[%u] = {\n",name,t,
+      textures[t].texelCount);
+
+    for (uint32_t j = 0; j < textures[t].texelCount; ++j)
+      fprintf(f,"0x%02x%s",textures[t].texels[j],j % 16 == 15 ? ",\n" : ",");
+
+    fprintf(f,"}; // %sTexture%d\n\n",name,t);
+  }
+
+  char arrayName[MAX_NAME + 32], count[MAX_NAME + 32];
+
+  snprintf(arrayName,sizeof(arrayName),"%s%sVertices",name,
+    quantizeVertices ? "Quantized" : "");
+  snprintf(count,sizeof(count),"%s_VERTEX_COUNT * 3",upper);
+  writeUnits(f,quantizeVertices ? "int16_t" : "S3L_Unit",arrayName,count,
+    quantizeVertices ? (const void *) outQuantized : outVertices,
+    outVertexCount * 3,3);
+
+  snprintf(arrayName,sizeof(arrayName),"%sTriangleIndices",name);
+  snprintf(count,sizeof(count),"%s_INDEX_COUNT",upper);
+  writeUnits(f,"S3L_Index",arrayName,count,outTriangles,outIndexCount,3);
+
+  snprintf(arrayName,sizeof(arrayName),"%sUVs",name);
+  snprintf(count,sizeof(count),"%s_UV_COUNT * 2",upper);
+  writeUnits(f,"S3L_Unit",arrayName,count,outUVs,outUVCount * 2,2);
+
+  snprintf(arrayName,sizeof(arrayName),"%sUVIndices",name);
+  snprintf(count,sizeof(count),"%s_INDEX_COUNT",upper);
+  writeUnits(f,"S3L_Index",arrayName,count,outUVIndices,outIndexCount,3);
+
+  if (outNormals)
+  {
+    snprintf(arrayName,sizeof(arrayName),"%sNormals",name);
+    snprintf(count,sizeof(count),"%s_NORMAL_COUNT * 3",upper);
+    writeUnits(f,"S3L_Unit",arrayName,count,outNormals,outNormalCount * 3,3);
+  }
+
+  if (outNormalIndices)
+  {
+    snprintf(arrayName,sizeof(arrayName),"%sNormalIndices",name);
+    snprintf(count,sizeof(count),"%s_INDEX_COUNT",upper);
+    writeUnits(f,"S3L_Index",arrayName,count,outNormalIndices,outIndexCount,
+      3);
+  }
+
+  fprintf(f,"const S3L_Material %sMaterials[%s_MATERIAL_COUNT] = {\n",name,
+    upper);
+
+  for (int m = 0; m < materialCount; ++m)
+  {
+    const Texture *t = textures + materials[m].texture;
+
+    char mips[MAX_NAME + 32] = "0";
+
+    if (mipLevels > 1) // the MIP chain follows level 0
+      snprintf(mips,sizeof(mips),"%sTexture%d + %u",name,materials[m].texture,
+        1u << (t->logW + t->logH));
+
+    fprintf(f,"  { %sTexture%d, %s, %sPalette, %d, %d, %d, 0 }, // %s\n",
+      name,materials[m].texture,mips,name,t->logW,t->logH,mipLevels,
+      materials[m].name);
+  }
+
+  fprintf(f,"};\n\n");
+
+  fprintf(f,"static const S3L_MaterialRange %sMaterialRanges[] = {\n",name);
+
+  for (int r = 0; r < outRangeCount; ++r)
+    fprintf(f,"  { %u, %u },\n",outRanges[r].firstTriangle,
+      outRanges[r].material);
+
+  fprintf(f,"};\n\n");
+  fprintf(f,"const S3L_ModelMaterials %sModelMaterials =\n"
+    "  { %sMaterialRanges, %s_MATERIAL_RANGE_COUNT };\n\n",name,name,upper);
+
+  fprintf(f,"S3L_Model3D %sModel;\n\n",name);
+  fprintf(f,"static const S3L_AttributeStream %sAttributes[] = {\n"
+    "  { %sUVs, %sUVIndices, 2 }\n};\n\n",name,name,name);
+  char vertices[MAX_NAME + 32];
+
+  snprintf(vertices,sizeof(vertices),"%sVertices",name);
+
+  fprintf(f,"void %sModelInit(void)\n{\n  S3L_initModel3D(\n    %s,\n"
+    "    %s_VERTEX_COUNT,\n    %sTriangleIndices,\n    %s_TRIANGLE_COUNT,\n"
+    "    &%sModel);\n\n  %sModel.attributes = %sAttributes;\n"
+    "  %sModel.attributeCount = 1;\n",name,quantizeVertices ? "0" : vertices,
+    upper,name,upper,name,name,name,name);
+
+  if (quantizeVertices)
+    fprintf(f,"\n  %sModel.quantizedVertices = %sQuantizedVertices;\n"
+      "  S3L_setVec4(&(%sModel.quantizationScale),%d,%d,%d,%d);\n"
+      "  S3L_setVec4(&(%sModel.quantizationOffset),%d,%d,%d,0);\n",
+      name,name,name,outQuantization[0],outQuantization[1],outQuantization[2],
+      S3L_FRACTIONS_PER_UNIT,name,outQuantization[3],outQuantization[4],
+      outQuantization[5]);
+
+  if (outStrip)
+    fprintf(f,"\n  %sModel.triangleStrip = 1;\n",name);
+
+  if (outNormals) // unlit configurations just don't use them
+  {
+    fprintf(f,"\n#if S3L_LIGHTING\n  %sModel.normals = %sNormals;\n",name,
+      name);
+
+    if (outNormalIndices)
+      fprintf(f,"  %sModel.normalIndices = %sNormalIndices;\n",name,name);
+
+    fprintf(f,"#endif\n");
+  }
+
+  fprintf(f,"}\n");
+
+  fclose(f);
+}
+
+typedef struct
+{
+  uint16_t type, item;
+  const void *data;
+  uint32_t size, info;
+} OutSection;
+
+static void writeBinary(const char *fileName)
+{
+  OutSection sections[10 + 2 * MAX_MATERIALS];
+  int sectionCount = 0;
+
+  #define addSection(t,i,d,s,inf)\
+    {\
+      OutSection *o = sections + sectionCount;\
+      sectionCount++;\
+      o->type = t; o->item = i; o->data = d; o->size = s; o->info = inf;\
+    }
+
+  uint8_t *quantized = 0;
+
+  if (quantizeVertices)
+  {
+    // scale and offset first, then the vertices
+    quantized = malloc(sizeof(outQuantization) +
+      outVertexCount * 3 * sizeof(int16_t));
+
+    memcpy(quantized,outQuantization,sizeof(outQuantization));
+    memcpy(quantized + sizeof(outQuantization),outQuantized,
+      outVertexCount * 3 * sizeof(int16_t));
+
+    addSection(S3L_ASSET_QUANTIZED_VERTICES,0,quantized,
+      sizeof(outQuantization) + outVertexCount * 3 * sizeof(int16_t),0)
+  }
+  else
+    addSection(S3L_ASSET_VERTICES,0,outVertices,
+      outVertexCount * 3 * sizeof(S3L_Unit),0)
+  addSection(outStrip ? S3L_ASSET_TRIANGLE_STRIP : S3L_ASSET_TRIANGLES,0,
+    outTriangles,outIndexCount * sizeof(S3L_Index),0)
+  addSection(S3L_ASSET_UVS,0,outUVs,outUVCount * 2 * sizeof(S3L_Unit),0)
+  addSection(S3L_ASSET_UV_INDICES,0,outUVIndices,
+    outIndexCount * sizeof(S3L_Index),0)
+
+  if (outNormals)
+    addSection(S3L_ASSET_NORMALS,0,outNormals,
+      outNormalCount * 3 * sizeof(S3L_Unit),0)
+
+  if (outNormalIndices)
+    addSection(S3L_ASSET_NORMAL_INDICES,0,outNormalIndices,
+      outIndexCount * sizeof(S3L_Index),0)
+
+  addSection(S3L_ASSET_MATERIAL_RANGES,0,outRanges,
+    outRangeCount * sizeof(S3L_MaterialRange),0)
+  addSection(S3L_ASSET_PALETTE,0,palette,sizeof(palette),0)
+
+  for (int t = 0; t < textureCount; ++t)
+    addSection(S3L_ASSET_TEXTURE,t,textures[t].texels,textures[t].texelCount,
+      S3L_ASSET_TEXTURE_INFO(textures[t].logW,textures[t].logH,mipLevels))
+
+  static S3L_AssetMaterial assetMaterials[MAX_MATERIALS];
+
+  for (int m = 0; m < materialCount; ++m)
+  {
+    assetMaterials[m].texture = materials[m].texture;
+    assetMaterials[m].palette = 0;
+    assetMaterials[m].uvAttribute = 0;
+  }
+
+  addSection(S3L_ASSET_MATERIALS,0,assetMaterials,
+    materialCount * sizeof(S3L_AssetMaterial),0)
+
+  #undef addSection
+
+  S3L_AssetHeader header;
+
+  memset(&header,0,sizeof(header));
+  header.magic = S3L_ASSET_MAGIC;
+  header.version = S3L_ASSET_VERSION;
+  header.sectionCount = sectionCount;
+  header.unitSize = sizeof(S3L_Unit);
+  header.indexSize = sizeof(S3L_Index);
+  header.textureLayout = S3L_TEXTURE_LAYOUT;
+  header.fractionsPerUnit = S3L_FRACTIONS_PER_UNIT;
+
+  S3L_AssetSection table[10 + 2 * MAX_MATERIALS];
+  uint32_t offset = sizeof(header) + sectionCount * sizeof(S3L_AssetSection);
+
+  for (int s = 0; s < sectionCount; ++s)
+  {
+    offset = (offset + S3L_ASSET_ALIGNMENT - 1) & ~(S3L_ASSET_ALIGNMENT - 1);
+
+    table[s].type = sections[s].type;
+    table[s].item = sections[s].item;
+    table[s].offset = offset;
+    table[s].size = sections[s].size;
+    table[s].info = sections[s].info;
+
+    offset += sections[s].size;
+  }
+
+  FILE *f = openOutput(fileName,"wb");
+
+  fwrite(&header,sizeof(header),1,f);
+  fwrite(table,sizeof(S3L_AssetSection),sectionCount,f);
+
+  long position = sizeof(header) + sectionCount * sizeof(S3L_AssetSection);
+
+  for (int s = 0; s < sectionCount; ++s)
+  {
+    while (position < (long) table[s].offset)
+    {
+      fputc(0,f);
+      position++;
+    }
+
+    fwrite(sections[s].data,1,sections[s].size,f);
+    position += sections[s].size;
+  }
+
+  fclose(f);
+  free(quantized);
+}
+
+int main(int argc, char **argv)
+{
+  const char *input = 0, *output = 0, *cName = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i],"-o") == 0 && i + 1 < argc)
+      output = argv[++i];
+    else if (strcmp(argv[i],"-c") == 0 && i + 1 < argc)
+      cName = argv[++i];
+    else if (strcmp(argv[i],"-s") == 0 && i + 1 < argc)
+      scale = atof(argv[++i]);
+    else if (strcmp(argv[i],"-m") == 0 && i + 1 < argc)
+      mipLevels = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-n") == 0)
+      flipV = 0;
+    else if (strcmp(argv[i],"-q") == 0)
+      quantizeVertices = 1;
+    else if (strcmp(argv[i],"-t") == 0)
+      makeStrip = 1;
+    else if (strcmp(argv[i],"-l") == 0 && i + 1 < argc)
+      normalAngle = atof(argv[++i]);
+    else if (argv[i][0] != '-' && !input)
+      input = argv[i];
+    else
+      fail("bad arguments, see the top of obj2s3l.c for usage",argv[i]);
+  }
+
+  if (!input || !output)
+    fail("usage: obj2s3l [-c NAME] [-s SCALE] [-m LEVELS] [-n] [-q] [-t] "
+      "[-l ANGLE] -o OUTPUT input.obj",0);
+
+  if (mipLevels < 1)
+    mipLevels = 1;
+
+  loadOBJ(input);
+  loadTextures();
+  buildPalette();
+  buildTextures();
+  buildGeometry();
+
+  if (quantizeVertices)
+    buildQuantized();
+
+  if (normalAngle >= 0)
+    buildNormals();
+
+  if (makeStrip)
+    buildStrip();
+
+  if (cName)
+    writeC(output,cName);
+  else
+    writeBinary(output);
+
+  printf("%u vertices, %u UVs, %u triangles, %d materials, %d textures, "
+    "%d colors\n",outVertexCount,outUVCount,triangleCount,materialCount,
+    textureCount,paletteSize);
+
+  return 0;
+}